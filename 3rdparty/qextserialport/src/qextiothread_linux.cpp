@@ -0,0 +1,521 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#include "qextiothread_p.h"
+#include "qextserialport_p.h"
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <QtCore/QMutexLocker>
+#ifdef QESP_IO_URING
+#  include "qextiouring_p.h"
+#endif
+
+#ifdef QESP_IO_URING
+// what a completion is for, in the low bits of its user_data; the rest is
+// the port (or 0 for the thread's own wake-up read)
+enum {
+    TagPoll = 0,
+    TagRead = 1,
+    TagWake = 2,
+    TagCancel = 3,
+    TagMask = 3
+};
+
+static inline quint64 tagged(QextSerialPortPrivate *d, int tag)
+{
+    return quint64(quintptr(d)) | quint64(tag);
+}
+#endif
+
+QextIoThread::QextIoThread()
+    : quit(false), currentBackend(Epoll)
+#ifdef QESP_IO_URING
+      , uring(0), fixedBuffers(false), wakePosted(false), wakeValue(0)
+#endif
+{
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd != -1 && wakeFd != -1) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = 0;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    }
+#ifdef QESP_IO_URING
+    // QESP_IO_BACKEND=epoll keeps the epoll backend, e.g. to compare them
+    if (wakeFd != -1 && qgetenv("QESP_IO_BACKEND") != "epoll" && createUring())
+        currentBackend = IoUring;
+#endif
+}
+
+QextIoThread::~QextIoThread()
+{
+    if (isRunning()) {
+        mutex.lock();
+        quit = true;
+        mutex.unlock();
+        wakeUp();
+        wait();
+    }
+#ifdef QESP_IO_URING
+    delete uring;
+#endif
+    if (wakeFd != -1)
+        ::close(wakeFd);
+    if (epollFd != -1)
+        ::close(epollFd);
+}
+
+QextIoThread *QextIoThread::instance()
+{
+    static QextIoThread thread;
+    return &thread;
+}
+
+QextIoThread::Backend QextIoThread::backend() const
+{
+    QMutexLocker locker(&mutex);
+    return currentBackend;
+}
+
+/*
+    Switches to \a backend. Only possible while no port is attached; returns
+    false otherwise, or if the backend is not available.
+*/
+bool QextIoThread::setBackend(Backend backend)
+{
+    QMutexLocker locker(&mutex);
+    if (backend == currentBackend)
+        return true;
+    if (!ports.isEmpty())
+        return false;
+#ifdef QESP_IO_URING
+    if (backend == IoUring && !createUring())
+        return false;
+#else
+    if (backend == IoUring)
+        return false;
+#endif
+
+    if (isRunning()) {
+        quit = true;
+        locker.unlock();
+        wakeUp();
+        wait();
+        locker.relock();
+        quit = false;
+    }
+#ifdef QESP_IO_URING
+    if (backend == Epoll) {
+        delete uring;
+        uring = 0;
+    }
+#endif
+    currentBackend = backend;
+    return true;
+}
+
+/*
+    Starts draining the port. Returns false if the thread is not available,
+    in which case the port should fall back to the notifier of its own thread.
+*/
+bool QextIoThread::addPort(QextSerialPortPrivate *d)
+{
+    QMutexLocker locker(&mutex);
+    if (epollFd == -1 || wakeFd == -1)
+        return false;
+
+#ifdef QESP_IO_URING
+    if (uring) {
+        d->ioUringSlot = -1;
+        d->ioUringPosted = false;
+        if (fixedBuffers && !freeSlots.isEmpty()) {
+            int slot = freeSlots.takeLast();
+            if (uring->setBuffer(slot, d->readBuffer.data(), d->readBuffer.capacity()))
+                d->ioUringSlot = slot;
+            else
+                freeSlots.append(slot);
+        }
+        ports.insert(d);
+        toPost.append(d);
+        if (isRunning())
+            wakeUp();
+        else
+            start(QThread::TimeCriticalPriority);
+        return true;
+    }
+#endif
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = d;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, d->fd, &ev) == -1)
+        return false;
+    ports.insert(d);
+
+    if (!isRunning())
+        start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+/*
+    Stops draining the port. Once this returns the thread no longer touches
+    \a d, so it can be closed and destroyed.
+*/
+void QextIoThread::removePort(QextSerialPortPrivate *d)
+{
+    QMutexLocker locker(&mutex);
+#ifdef QESP_IO_URING
+    if (uring) {
+        ports.remove(d);
+        toPost.removeAll(d);
+        // the kernel may still write into the read buffer until the posted
+        // read has completed
+        if (d->ioUringPosted) {
+            toCancel.append(d);
+            wakeUp();
+            while (d->ioUringPosted && isRunning())
+                cancelled.wait(&mutex, 100);
+        }
+        if (d->ioUringSlot != -1) {
+            uring->setBuffer(d->ioUringSlot, 0, 0);
+            freeSlots.append(d->ioUringSlot);
+            d->ioUringSlot = -1;
+        }
+        return;
+    }
+#endif
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, d->fd, 0);
+    ports.remove(d);
+}
+
+/*
+    Called by the consumer after reading from the buffer: watches the port
+    again if it was stopped because the buffer was full.
+*/
+void QextIoThread::resume(QextSerialPortPrivate *d)
+{
+    if (!d->ioStalled.testAndSetOrdered(1, 0))
+        return;
+#ifdef QESP_IO_URING
+    QMutexLocker locker(&mutex);
+    if (uring) {
+        if (ports.contains(d) && !d->ioUringPosted) {
+            toPost.append(d);
+            wakeUp();
+        }
+        return;
+    }
+#endif
+    watch(d, true);
+}
+
+/*
+    Called by the consumer when its eventfd fires, before it looks at the
+    buffer, so the next bytes produce a new wake-up.
+*/
+void QextIoThread::acknowledge(QextSerialPortPrivate *d)
+{
+    quint64 value;
+    ::read(d->ioEventFd, &value, sizeof(value));
+    d->ioNotifyPending.fetchAndStoreOrdered(0);
+}
+
+/*
+    Adds the port to or removes it from the wait set. Removing it (rather than
+    clearing its events) also keeps a hang-up from being reported meanwhile.
+*/
+void QextIoThread::watch(QextSerialPortPrivate *d, bool enable)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = d;
+    ::epoll_ctl(epollFd, enable ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, d->fd, &ev);
+}
+
+void QextIoThread::wakeUp()
+{
+    quint64 one = 1;
+    ::write(wakeFd, &one, sizeof(one));
+}
+
+/*
+    Wakes the owning thread of the port, unless a wake-up is already pending.
+*/
+void QextIoThread::notify(QextSerialPortPrivate *d)
+{
+    if (d->ioNotifyPending.testAndSetOrdered(0, 1)) {
+        quint64 one = 1;
+        ::write(d->ioEventFd, &one, sizeof(one));
+    }
+}
+
+void QextIoThread::run()
+{
+#ifdef QESP_IO_URING
+    if (uring) {
+        runIoUring();
+        return;
+    }
+#endif
+    runEpoll();
+}
+
+void QextIoThread::runEpoll()
+{
+    struct epoll_event events[MaxEvents];
+    forever {
+        int n = ::epoll_wait(epollFd, events, MaxEvents, -1);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        QMutexLocker locker(&mutex);
+        for (int i = 0; i < n; ++i) {
+            if (!events[i].data.ptr) {
+                quint64 value;
+                ::read(wakeFd, &value, sizeof(value));
+                if (quit)
+                    return;
+                continue;
+            }
+            QextSerialPortPrivate *d = static_cast<QextSerialPortPrivate *>(events[i].data.ptr);
+            // the port may have been removed after epoll_wait() returned
+            if (ports.contains(d))
+                drain(d);
+        }
+    }
+}
+
+void QextIoThread::drain(QextSerialPortPrivate *d)
+{
+    qint64 total = 0;
+    qint64 now = d->receiveTime();
+    forever {
+        int spanSize;
+        char *span = d->readBuffer.writeSpan(&spanSize);
+        if (spanSize == 0) {
+            // buffer full: stop watching until the consumer makes room. It
+            // may have done so already, before seeing the flag.
+            watch(d, false);
+            d->ioStalled.fetchAndStoreOrdered(1);
+            if (d->readBuffer.freeSpace() > 0 && d->ioStalled.testAndSetOrdered(1, 0)) {
+                watch(d, true);
+                continue;
+            }
+            break;
+        }
+
+        ssize_t bytesRead = ::read(d->fd, span, spanSize);
+        if (bytesRead > 0) {
+            d->stampReceived(now, int(bytesRead));
+            d->readBuffer.commitWrite(int(bytesRead));
+            total += bytesRead;
+            if (bytesRead < spanSize)
+                break;
+        } else if (bytesRead == -1 && errno == EINTR) {
+            continue;
+        } else {
+            if (bytesRead == 0 || errno != EAGAIN) {
+                // hang-up or error: would be reported again on every wait
+                watch(d, false);
+            }
+            break;
+        }
+    }
+
+    if (total > 0)
+        notify(d);
+}
+
+#ifdef QESP_IO_URING
+/*
+    Sets up the io_uring backend. Returns false if the kernel has no
+    io_uring. Fixed buffers are optional (Linux 5.19).
+*/
+bool QextIoThread::createUring()
+{
+    if (uring)
+        return true;
+    uring = new QextIoUring(QueueEntries);
+    if (!uring->isValid()) {
+        delete uring;
+        uring = 0;
+        return false;
+    }
+    wakePosted = false;
+    fixedBuffers = uring->registerBufferSlots(MaxFixedBuffers);
+    freeSlots.clear();
+    if (fixedBuffers) {
+        for (int i = MaxFixedBuffers - 1; i >= 0; --i)
+            freeSlots.append(i);
+    }
+    return true;
+}
+
+/*
+    Queues a read of \a size bytes from \a fd into \a target, linked behind a
+    poll so it only runs once there is data (the descriptors are
+    non-blocking, so a read alone would fail at once with EAGAIN).
+*/
+void QextIoThread::postRead(int fd, void *target, int size, int slot, quint64 userData)
+{
+    // a linked pair must go in the same submission
+    if (uring->freeSqes() < 2)
+        uring->submit(0);
+
+    struct io_uring_sqe *sqe = uring->getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = (userData & ~quint64(TagMask)) | TagPoll;
+
+    sqe = uring->getSqe();
+    sqe->opcode = (slot != -1) ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = quint64(quintptr(target));
+    sqe->len = unsigned(size);
+    if (slot != -1)
+        sqe->buf_index = quint16(slot);
+    sqe->user_data = userData;
+}
+
+/*
+    Posts the next read of the port into the free part of its read buffer,
+    unless the buffer is full.
+*/
+void QextIoThread::post(QextSerialPortPrivate *d)
+{
+    int spanSize;
+    char *span = d->readBuffer.writeSpan(&spanSize);
+    if (spanSize == 0) {
+        // buffer full: wait for resume(). The consumer may have made room
+        // already, before seeing the flag.
+        d->ioStalled.fetchAndStoreOrdered(1);
+        if (d->readBuffer.freeSpace() == 0 || !d->ioStalled.testAndSetOrdered(1, 0))
+            return;
+        span = d->readBuffer.writeSpan(&spanSize);
+    }
+    postRead(d->fd, span, spanSize, d->ioUringSlot, tagged(d, TagRead));
+    d->ioUringPosted = true;
+}
+
+/*
+    A read posted by post() has completed with \a result.
+*/
+void QextIoThread::complete(QextSerialPortPrivate *d, int result)
+{
+    d->ioUringPosted = false;
+    if (!ports.contains(d)) {
+        // removePort() is waiting for this
+        cancelled.wakeAll();
+        return;
+    }
+
+    if (result > 0) {
+        d->stampReceived(d->receiveTime(), result);
+        d->readBuffer.commitWrite(result);
+        notify(d);
+        post(d);
+    } else if (result == -EAGAIN || result == -EINTR || result == -ECANCELED) {
+        post(d);
+    }
+    // else hang-up or error: would be reported again on every read
+}
+
+/*
+    The io_uring loop: every port has one read posted at a time, and all the
+    reads that became due are submitted, and the completions waited for, in
+    a single system call per round, however many ports there are.
+*/
+void QextIoThread::runIoUring()
+{
+    forever {
+        {
+            QMutexLocker locker(&mutex);
+            if (quit)
+                return;
+            if (!wakePosted) {
+                postRead(wakeFd, &wakeValue, sizeof(wakeValue), -1, tagged(0, TagWake));
+                wakePosted = true;
+            }
+            foreach (QextSerialPortPrivate *d, toCancel) {
+                const quint64 targets[2] = { tagged(d, TagPoll), tagged(d, TagRead) };
+                for (int i = 0; i < 2; ++i) {
+                    if (uring->freeSqes() == 0)
+                        uring->submit(0);
+                    struct io_uring_sqe *sqe = uring->getSqe();
+                    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    sqe->addr = targets[i];
+                    sqe->user_data = tagged(0, TagCancel);
+                }
+            }
+            toCancel.clear();
+            foreach (QextSerialPortPrivate *d, toPost) {
+                if (!d->ioUringPosted)
+                    post(d);
+            }
+            toPost.clear();
+        }
+
+        if (uring->submit(1) == -1 && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            QESP_WARNING()<<"QextIoThread: io_uring_enter failed:"<<errno;
+            return;
+        }
+
+        QMutexLocker locker(&mutex);
+        struct io_uring_cqe cqe;
+        while (uring->nextCqe(&cqe)) {
+            QextSerialPortPrivate *d = reinterpret_cast<QextSerialPortPrivate *>(
+                        quintptr(cqe.user_data & ~quint64(TagMask)));
+            switch (int(cqe.user_data & TagMask)) {
+            case TagRead:
+                complete(d, cqe.res);
+                break;
+            case TagWake:
+                wakePosted = false;
+                break;
+            default:
+                // polls complete before their reads, and cancels are
+                // answered by the completion of what they cancelled
+                break;
+            }
+        }
+    }
+}
+#endif
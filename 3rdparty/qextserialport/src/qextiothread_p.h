@@ -0,0 +1,138 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#ifndef _QEXTIOTHREAD_P_H_
+#define _QEXTIOTHREAD_P_H_
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QESP API.  It exists for the convenience
+// of other QESP classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QThread>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QList>
+#include <QtCore/QWaitCondition>
+
+class QextSerialPortPrivate;
+class QextIoUring;
+
+// The thread behind QextSerialPort::IoThread.
+//
+// A single thread waits with epoll on the descriptors of all ports opened in
+// that mode and drains them into each port's read buffer (the producer side
+// of its QextRingBuffer). The owning thread is woken through the port's
+// eventfd, at most once until it has acknowledged the previous wake-up.
+//
+// When a read buffer fills up the port is removed from the wait set until the
+// consumer makes room, leaving the rest of the data in the driver.
+//
+// Built with QESP_IO_URING (CONFIG += qextserialport-io_uring) the thread
+// uses io_uring instead where the kernel has it: each port has one read
+// posted, straight into its read buffer (registered as a fixed buffer), and
+// all reposts and completions of a round cost one system call. The
+// environment variable QESP_IO_BACKEND=epoll keeps the epoll loop.
+class QextIoThread : public QThread
+{
+public:
+    enum Backend {
+        Epoll,
+        IoUring
+    };
+
+    static QextIoThread *instance();
+
+    Backend backend() const;
+    bool setBackend(Backend backend);
+
+    bool addPort(QextSerialPortPrivate *d);
+    void removePort(QextSerialPortPrivate *d);
+    void resume(QextSerialPortPrivate *d);
+    static void acknowledge(QextSerialPortPrivate *d);
+
+protected:
+    void run();
+
+private:
+    QextIoThread();
+    ~QextIoThread();
+    Q_DISABLE_COPY(QextIoThread)
+
+    void runEpoll();
+    void drain(QextSerialPortPrivate *d);
+    void watch(QextSerialPortPrivate *d, bool enable);
+    void wakeUp();
+    static void notify(QextSerialPortPrivate *d);
+
+    enum { MaxEvents = 64 };
+
+    int epollFd;
+    int wakeFd;
+    bool quit;
+    Backend currentBackend;
+    // held while a batch of events is handled, so a port can not go away
+    // in the middle of it
+    mutable QMutex mutex;
+    QSet<QextSerialPortPrivate *> ports;
+
+#ifdef QESP_IO_URING
+    bool createUring();
+    void runIoUring();
+    void postRead(int fd, void *target, int size, int slot, quint64 userData);
+    void post(QextSerialPortPrivate *d);
+    void complete(QextSerialPortPrivate *d, int result);
+
+    enum {
+        QueueEntries = 256,
+        MaxFixedBuffers = 256
+    };
+
+    QextIoUring *uring;
+    bool fixedBuffers;
+    bool wakePosted;        // a read of wakeFd is in flight
+    quint64 wakeValue;      // its target
+    // handed to the thread by the other threads, under the mutex
+    QList<QextSerialPortPrivate *> toPost;
+    QList<QextSerialPortPrivate *> toCancel;
+    QWaitCondition cancelled;
+    QList<int> freeSlots;   // unused fixed buffer slots
+#endif
+};
+
+#endif //_QEXTIOTHREAD_P_H_
@@ -0,0 +1,191 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#include "qextiouring_p.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+static inline int sysSetup(unsigned entries, struct io_uring_params *p)
+{
+    return int(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+static inline int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return int(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, 0, 0));
+}
+
+static inline int sysRegister(int fd, unsigned opcode, const void *arg, unsigned nrArgs)
+{
+    return int(::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+QextIoUring::QextIoUring(unsigned entries)
+    : ringFd(-1), pending(0), ring(MAP_FAILED), ringSize(0), sqes(0), sqesSize(0)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = sysSetup(entries, &p);
+    if (fd == -1)
+        return;
+    // older kernels need two mappings and may drop completions: not worth it
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+        ::close(fd);
+        return;
+    }
+
+    ringSize = qMax(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                    p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe));
+    ring = ::mmap(0, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  fd, IORING_OFF_SQ_RING);
+    sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqesMap = ::mmap(0, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd, IORING_OFF_SQES);
+    if (ring == MAP_FAILED || sqesMap == MAP_FAILED) {
+        if (ring != MAP_FAILED)
+            ::munmap(ring, ringSize);
+        if (sqesMap != MAP_FAILED)
+            ::munmap(sqesMap, sqesSize);
+        ::close(fd);
+        return;
+    }
+    sqes = static_cast<struct io_uring_sqe *>(sqesMap);
+
+    char *base = static_cast<char *>(ring);
+    sqHead = reinterpret_cast<unsigned *>(base + p.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(base + p.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned *>(base + p.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned *>(base + p.sq_off.ring_mask);
+    sqEntries = p.sq_entries;
+
+    cqHead = reinterpret_cast<unsigned *>(base + p.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(base + p.cq_off.tail);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(base + p.cq_off.cqes);
+    cqMask = *reinterpret_cast<unsigned *>(base + p.cq_off.ring_mask);
+
+    ringFd = fd;
+}
+
+QextIoUring::~QextIoUring()
+{
+    if (ringFd == -1)
+        return;
+    ::munmap(sqes, sqesSize);
+    ::munmap(ring, ringSize);
+    // closing the ring cancels whatever is still in flight
+    ::close(ringFd);
+}
+
+/*
+    Returns a cleared submission entry, or 0 if the submission queue is full
+    until the next submit().
+*/
+struct io_uring_sqe *QextIoUring::getSqe()
+{
+    if (freeSqes() == 0)
+        return 0;
+    unsigned tail = *sqTail;
+    unsigned index = tail & sqMask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    // published now, but the kernel only looks at it in submit()
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++pending;
+    return sqe;
+}
+
+unsigned QextIoUring::freeSqes() const
+{
+    return sqEntries - (*sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE));
+}
+
+/*
+    Submits the queued entries and, if \a waitFor is not 0, waits until at
+    least that many completions are ready, all in one system call. Returns
+    -1 on error, with errno set.
+*/
+int QextIoUring::submit(unsigned waitFor)
+{
+    int ret = sysEnter(ringFd, pending, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0);
+    if (ret > 0)
+        pending -= unsigned(ret);
+    return ret;
+}
+
+/*
+    Takes the oldest completion into \a cqe. Returns false if there is none.
+*/
+bool QextIoUring::nextCqe(struct io_uring_cqe *cqe)
+{
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        return false;
+    *cqe = cqes[head & cqMask];
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+    Reserves \a count empty fixed buffer slots, to be filled with
+    setBuffer(). Needs Linux 5.19.
+*/
+bool QextIoUring::registerBufferSlots(unsigned count)
+{
+    struct io_uring_rsrc_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.nr = count;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    return sysRegister(ringFd, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) == 0;
+}
+
+/*
+    Makes \a size bytes at \a base fixed buffer \a slot, pinning them, so
+    reads into it skip mapping the user memory each time. A null \a base
+    empties the slot again. May be called from any thread.
+*/
+bool QextIoUring::setBuffer(unsigned slot, void *base, size_t size)
+{
+    struct iovec iov;
+    iov.iov_base = base;
+    iov.iov_len = base ? size : 0;
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.data = reinterpret_cast<quintptr>(&iov);
+    update.nr = 1;
+    return sysRegister(ringFd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) == 1;
+}
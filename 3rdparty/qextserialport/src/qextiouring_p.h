@@ -0,0 +1,98 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#ifndef _QEXTIOURING_P_H_
+#define _QEXTIOURING_P_H_
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QESP API.  It exists for the convenience
+// of other QESP classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QtGlobal>
+#include <linux/io_uring.h>
+#include <stddef.h>
+
+// A minimal io_uring, on the raw system calls so there is no dependency on
+// liburing: one submission and one completion queue, both mapped at
+// construction, and a table of fixed buffers.
+//
+// Only the thread that runs the queue may call getSqe(), submit() and
+// nextCqe(). isValid() is false if the kernel has no io_uring (before 5.1,
+// or disabled), in which case the caller uses another backend.
+class QextIoUring
+{
+public:
+    explicit QextIoUring(unsigned entries);
+    ~QextIoUring();
+
+    bool isValid() const { return ringFd != -1; }
+
+    struct io_uring_sqe *getSqe();
+    unsigned freeSqes() const;
+    int submit(unsigned waitFor);
+    bool nextCqe(struct io_uring_cqe *cqe);
+
+    bool registerBufferSlots(unsigned count);
+    bool setBuffer(unsigned slot, void *base, size_t size);
+
+private:
+    Q_DISABLE_COPY(QextIoUring)
+
+    int ringFd;
+    unsigned pending;       // queued since the last submit()
+
+    // both rings share one mapping (IORING_FEAT_SINGLE_MMAP)
+    void *ring;
+    size_t ringSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+
+    unsigned *cqHead;
+    unsigned *cqTail;
+    struct io_uring_cqe *cqes;
+    unsigned cqMask;
+};
+
+#endif //_QEXTIOURING_P_H_
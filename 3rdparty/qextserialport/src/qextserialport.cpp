@@ -33,8 +33,15 @@
 #include "qextserialport_p.h"
 #include <stdio.h>
 #include <QtCore/QDebug>
+#include <QtCore/QMutexLocker>
 #include <QtCore/QReadLocker>
 #include <QtCore/QWriteLocker>
+#include <QtCore/QVarLengthArray>
+#include <math.h>
+#include <string.h>
+#ifdef Q_OS_LINUX
+#  include "qextiothread_p.h"
+#endif
 
 /*!
     \class PortSettings
@@ -54,9 +61,20 @@
 */
 
 QextSerialPortPrivate::QextSerialPortPrivate(QextSerialPort *q)
-    :lock(QReadWriteLock::Recursive), q_ptr(q)
+    :lock(QReadWriteLock::Recursive), stampBuffer(256 * sizeof(QextReceiveStamp)), q_ptr(q)
 {
     lastErr = E_NO_ERROR;
+    actualBaudRate = 0;
+    lowLatency = false;
+    lowLatencyAccepted = false;
+    readMinimum = 0;
+    lastArrival = 0;
+    writeHighWaterMark = 0;
+    lastInterval = -1;
+    frameScanEnd = 0;
+    frameOutPos = 0;
+    frameOutLength = 0;
+    _queryMode = QextSerialPort::EventDriven;
     Settings.BaudRate = BAUD9600;
     Settings.Parity = PAR_NONE;
     Settings.FlowControl = FLOW_OFF;
@@ -66,6 +84,7 @@ QextSerialPortPrivate::QextSerialPortPrivate(QextSerialPort *q)
     settingsDirtyFlags = DFE_ALL;
 
     platformSpecificInit();
+    publishSettings();
 }
 
 QextSerialPortPrivate::~QextSerialPortPrivate()
@@ -132,6 +151,16 @@ void QextSerialPortPrivate::setBaudRate(BaudRateType baudRate, bool update)
         break;
 #ifndef Q_OS_WIN
     default:
+#  ifdef Q_OS_LINUX
+        // any other rate the driver accepts, set with termios2
+        if (baudRate > 0) {
+            Settings.BaudRate=baudRate;
+            settingsDirtyFlags |= DFE_BaudRate;
+            if (update && q_func()->isOpen())
+                updatePortSettings();
+            break;
+        }
+#  endif
         QESP_WARNING()<<"QextSerialPort does not support baudRate:"<<baudRate;
 #endif
     }
@@ -287,6 +316,48 @@ void QextSerialPortPrivate::setTimeout(long millisec, bool update)
         updatePortSettings();
 }
 
+void QextSerialPortPrivate::setLowLatency(bool enable, bool update)
+{
+    lowLatency = enable;
+    settingsDirtyFlags |= DFE_LowLatency;
+    if (update && q_func()->isOpen())
+        updatePortSettings();
+}
+
+void QextSerialPortPrivate::setReadMinimum(int bytes, bool update)
+{
+    readMinimum = qBound(0, bytes, 255);
+    settingsDirtyFlags |= DFE_TimeOut;
+    if (update && q_func()->isOpen())
+        updatePortSettings();
+}
+
+/*
+    Publishes the current settings for the getters of QextSerialPort, which
+    read them without taking the lock. Must be called with the lock held for
+    writing, after every change.
+*/
+void QextSerialPortPrivate::publishSettings()
+{
+    Q_Q(QextSerialPort);
+    QextSettingsSnapshot s;
+    s.port = port;
+    s.Settings = Settings;
+    s.queryMode = _queryMode;
+    bool open = q->isOpen();
+    s.actualBaudRate = (open && actualBaudRate > 0) ? actualBaudRate : int(Settings.BaudRate);
+    s.lowLatency = open && lowLatencyAccepted;
+    s.readMinimum = readMinimum;
+    s.receiveStamping = (receiveStamping.fetchAndAddRelaxed(0) != 0);
+    s.writeHighWaterMark = writeHighWaterMark;
+    s.framing = framing;
+#ifdef Q_OS_UNIX
+    if (open)
+        s.readMinimum = Posix_CommConfig.c_cc[VMIN];
+#endif
+    snapshot.publish(s);
+}
+
 void QextSerialPortPrivate::setPortSettings(const PortSettings &settings, bool update)
 {
     setBaudRate(settings.BaudRate, false);
@@ -298,22 +369,665 @@ void QextSerialPortPrivate::setPortSettings(const PortSettings &settings, bool u
     settingsDirtyFlags = DFE_ALL;
     if (update && q_func()->isOpen())
         updatePortSettings();
+    publishSettings();
 }
 
 
 void QextSerialPortPrivate::_q_canRead()
 {
-    qint64 maxSize = bytesAvailable_sys();
-    if (maxSize > 0) {
-        char * writePtr = readBuffer.reserve(size_t(maxSize));
-        qint64 bytesRead = readData_sys(writePtr, maxSize);
-        if (bytesRead < maxSize)
-            readBuffer.chop(maxSize - bytesRead);
+#ifdef Q_OS_LINUX
+    if (ioEventFd != -1) {
+        // the I/O thread has already moved the data into the buffer
+        QextIoThread::acknowledge(this);
+        if (!readBuffer.isEmpty()) {
+            Q_Q(QextSerialPort);
+            Q_EMIT q->readyRead();
+            if (q->canReadFrame())
+                Q_EMIT q->frameReady();
+        }
+        return;
+    }
+#endif
+    if (fillReadBuffer(false) > 0) {
         Q_Q(QextSerialPort);
         Q_EMIT q->readyRead();
+        // unless the readyRead() handlers took the frames already
+        if (q->canReadFrame())
+            Q_EMIT q->frameReady();
+    }
+}
+
+/*
+    Moves the bytes waiting in the driver into the read buffer. If \a wait is
+    true and there are none, first waits up to the timeout for some to arrive,
+    as readData_sys() does. Returns -1 if the driver could not be asked and
+    nothing was moved.
+*/
+qint64 QextSerialPortPrivate::fillReadBuffer(bool wait)
+{
+    qint64 total = 0;
+    int spanSize;
+    if (wait && readBuffer.isEmpty() && bytesAvailable_sys() == 0) {
+        char *writePtr = readBuffer.writeSpan(&spanSize);
+        qint64 bytesRead = readData_sys(writePtr, spanSize);
+        if (bytesRead <= 0)
+            return 0;
+        stampReceived(receiveTime(), int(bytesRead));
+        readBuffer.commitWrite(int(bytesRead));
+        total = bytesRead;
+    }
+
+    qint64 maxSize = bytesAvailable_sys();
+    if (maxSize < 0)
+        return total > 0 ? total : -1;
+    qint64 now = (maxSize > 0) ? receiveTime() : 0;
+    // at most two spans when the free area wraps around; whatever does not
+    // fit stays in the driver until the buffer is drained
+    while (maxSize > 0) {
+        char *writePtr = readBuffer.writeSpan(&spanSize);
+        if (spanSize == 0)
+            break;
+        qint64 bytesRead = readData_sys(writePtr, qMin(qint64(spanSize), maxSize));
+        if (bytesRead <= 0)
+            break;
+        stampReceived(now, int(bytesRead));
+        readBuffer.commitWrite(int(bytesRead));
+        total += bytesRead;
+        maxSize -= bytesRead;
+    }
+    return total;
+}
+
+/*
+    Reads whatever the driver has into the free space of the read buffer,
+    waiting up to the timeout as readData_sys() does. Unlike
+    fillReadBuffer() it does not ask how much is waiting first: a single
+    read() usually takes it all, and bytesAvailable() can then answer from
+    the buffer. Only when that read fills the span up to where the free area
+    wraps around is the driver asked for the rest. Returns -1 on error.
+
+    \a wanted is what the caller asked for.
+*/
+qint64 QextSerialPortPrivate::readAhead(qint64 wanted)
+{
+    int spanSize;
+    char *writePtr = readBuffer.writeSpan(&spanSize);
+    if (spanSize == 0)
+        return 0;
+#ifdef Q_OS_WIN
+    // ReadFile() waits for the whole span to fill, up to the timeout: ask
+    // for what is waiting, or for what the caller wants if that is more
+    qint64 waiting = bytesAvailable_sys();
+    if (waiting < 0)
+        return -1;
+    spanSize = int(qMin(qint64(spanSize), qMax(waiting, wanted)));
+#else
+    Q_UNUSED(wanted);
+#endif
+    qint64 bytesRead = readData_sys(writePtr, spanSize);
+    if (bytesRead <= 0)
+        return bytesRead;
+    stampReceived(receiveTime(), int(bytesRead));
+    readBuffer.commitWrite(int(bytesRead));
+    if (bytesRead == spanSize)
+        bytesRead += qMax(qint64(0), fillReadBuffer(false));
+    return bytesRead;
+}
+
+/*
+    The time to stamp received bytes with, or 0 if receive timestamping is
+    off. Producer side.
+*/
+qint64 QextSerialPortPrivate::receiveTime()
+{
+    return receiveStamping.fetchAndAddRelaxed(0) ? qextMonotonicUsecs() : 0;
+}
+
+/*
+    Queues the stamp of \a bytes about to be committed to the read buffer,
+    received at \a time (from receiveTime()), and updates the inter-arrival
+    jitter. Producer side, called before readBuffer.commitWrite() so that the
+    consumer never sees the bytes without their stamp. Also counts them for
+    linkStats(), stamped or not.
+*/
+void QextSerialPortPrivate::stampReceived(qint64 time, int bytes)
+{
+    countReceived(bytes);
+    if (time == 0)
+        return;
+
+    QMutexLocker locker(&statsLock);
+    stats.chunks++;
+    stats.bytes += bytes;
+    // chunks of the same wake-up arrived together
+    if (time != lastArrival) {
+        if (lastArrival != 0) {
+            qint64 interval = time - lastArrival;
+            if (lastInterval >= 0)
+                stats.jitter.record(qAbs(interval - lastInterval));
+            lastInterval = interval;
+        }
+        lastArrival = time;
+    }
+
+    int spanSize;
+    char *span = stampBuffer.writeSpan(&spanSize);
+    if (spanSize < int(sizeof(QextReceiveStamp))) {
+        // the consumer is far behind; these bytes count with the next chunk
+        stats.unstamped++;
+        return;
+    }
+    QextReceiveStamp stamp = { readBuffer.writePosition() + uint(bytes), 0, time };
+    memcpy(span, &stamp, sizeof(stamp));
+    stampBuffer.commitWrite(sizeof(stamp));
+}
+
+/*
+    Records the dwell time of every chunk whose last byte has been consumed
+    from the read buffer. Consumer side.
+*/
+void QextSerialPortPrivate::consumeStamps()
+{
+    int size;
+    const char *span = stampBuffer.readSpan(&size);
+    if (size == 0)
+        return;
+
+    qint64 now = qextMonotonicUsecs();
+    uint consumed = readBuffer.readPosition();
+    QMutexLocker locker(&statsLock);
+    while (size >= int(sizeof(QextReceiveStamp))) {
+        QextReceiveStamp stamp;
+        memcpy(&stamp, span, sizeof(stamp));
+        if (int(stamp.end - consumed) > 0)
+            break;  // still has unread bytes
+        stats.dwell.record(now - stamp.time);
+        stampBuffer.consume(sizeof(stamp));
+        span = stampBuffer.readSpan(&size);
+    }
+}
+
+/*
+    Brings link up to date with the counters and, when a sample is due, with
+    the error counters of the driver. With \a reset, starts over from zero.
+    The driver is only asked with \a poll, when the caller holds lock so
+    that the port can not be closed meanwhile; otherwise the last error
+    counters are kept.
+*/
+void QextSerialPortPrivate::sampleLink(bool reset, bool poll) const
+{
+    uint counters[QextLinkMonitor::Counters];
+    for (int i = 0; i < QextLinkMonitor::Counters; ++i)
+        counters[i] = uint(linkCounters[i].fetchAndAddRelaxed(0));
+    qint64 now = qextMonotonicUsecs();
+
+    QMutexLocker statsLocker(&statsLock);
+    if (!reset && !link.isDue(now)) {
+        link.update(counters);
+        return;
+    }
+    QextLinkStats errors;
+    bool polled = poll && q_ptr->isOpen() && errorCounters_sys(&errors);
+    if (reset) {
+        link.reset(now, counters, polled ? &errors : 0);
+    } else {
+        link.update(counters);
+        link.sample(now, polled ? &errors : 0);
+    }
+}
+
+QextLinkMonitor::QextLinkMonitor()
+    : count(0), next(0)
+{
+    memset(seen, 0, sizeof(seen));
+}
+
+void QextLinkMonitor::update(const uint *counters)
+{
+    qint64 *totals[Counters] = {
+        &current.bytesIn, &current.bytesOut, &current.readCalls, &current.writeCalls,
+        &current.framesIn, &current.framesOut,
+        &current.badFrames
+    };
+    for (int i = 0; i < Counters; ++i) {
+        // modulo 2^32, so a counter that wrapped still gives the right delta
+        *totals[i] += counters[i] - seen[i];
+        seen[i] = counters[i];
+    }
+}
+
+/*
+    Records the totals at \a now and recomputes the rates. \a errors are the
+    driver counters, or null if they could not be read (the last ones are
+    kept).
+*/
+void QextLinkMonitor::sample(qint64 now, const QextLinkStats *errors)
+{
+    if (errors) {
+        current.hasErrorCounters = true;
+        current.framingErrors = errors->framingErrors - errorBase.framingErrors;
+        current.parityErrors = errors->parityErrors - errorBase.parityErrors;
+        current.overruns = errors->overruns - errorBase.overruns;
+        current.bufferOverruns = errors->bufferOverruns - errorBase.bufferOverruns;
+        current.breaks = errors->breaks - errorBase.breaks;
+    }
+
+    Sample &latest = samples[next];
+    latest.time = now;
+    latest.totals[BytesIn] = current.bytesIn;
+    latest.totals[BytesOut] = current.bytesOut;
+    latest.totals[ReadCalls] = current.readCalls;
+    latest.totals[WriteCalls] = current.writeCalls;
+    latest.totals[FramesIn] = current.framesIn;
+    latest.totals[FramesOut] = current.framesOut;
+    latest.errors = current.errors();
+    next = (next + 1) % Samples;
+    if (count < Samples)
+        ++count;
+
+    current.shortRate = rateSince(latest, 1000000);
+    current.longRate = rateSince(latest, 10000000);
+}
+
+/*
+    Starts over from zero at \a now: \a counters and \a errors (null if the
+    driver has no error counters) become the base the totals count from.
+*/
+void QextLinkMonitor::reset(qint64 now, const uint *counters, const QextLinkStats *errors)
+{
+    current = QextLinkStats();
+    errorBase = errors ? *errors : QextLinkStats();
+    memcpy(seen, counters, sizeof(seen));
+    count = 0;
+    next = 0;
+    sample(now, errors);
+}
+
+/*
+    The rates from the newest sample at least \a window older than \a latest
+    (or the oldest there is, early on) up to \a latest.
+*/
+QextLinkRate QextLinkMonitor::rateSince(const Sample &latest, qint64 window) const
+{
+    QextLinkRate rate;
+    const Sample *from = 0;
+    for (int i = 2; i <= count; ++i) {
+        from = &samples[(next + Samples - i) % Samples];
+        if (latest.time - from->time >= window)
+            break;
+    }
+    if (!from)
+        return rate;
+
+    double seconds = double(latest.time - from->time) / 1000000.0;
+    rate.bytesIn = (latest.totals[BytesIn] - from->totals[BytesIn]) / seconds;
+    rate.bytesOut = (latest.totals[BytesOut] - from->totals[BytesOut]) / seconds;
+    rate.readCalls = (latest.totals[ReadCalls] - from->totals[ReadCalls]) / seconds;
+    rate.writeCalls = (latest.totals[WriteCalls] - from->totals[WriteCalls]) / seconds;
+    rate.framesIn = (latest.totals[FramesIn] - from->totals[FramesIn]) / seconds;
+    rate.framesOut = (latest.totals[FramesOut] - from->totals[FramesOut]) / seconds;
+    rate.errors = (latest.errors - from->errors) / seconds;
+    return rate;
+}
+
+static inline char frameDelimiter(const QextFraming &framing)
+{
+    switch (framing.mode) {
+    case QextFraming::Slip:
+        return char(0xC0);
+    case QextFraming::Cobs:
+        return '\0';
+    default:
+        return framing.delimiter;
+    }
+}
+
+/*
+    Longest encoded frame that can decode to at most framing.maxSize bytes.
+*/
+static inline int encodedLimit(const QextFraming &framing)
+{
+    switch (framing.mode) {
+    case QextFraming::Slip:
+        return 2 * framing.maxSize;
+    case QextFraming::Cobs:
+        return framing.maxSize + framing.maxSize / 254 + 1;
+    default:
+        return framing.maxSize;
+    }
+}
+
+/*
+    Undoes the SLIP escapes of \a frame in place. Returns false on an
+    escape that SLIP does not define.
+*/
+static bool slipDecode(QByteArray *frame)
+{
+    char *data = frame->data();
+    int size = frame->size();
+    int out = 0;
+    for (int i = 0; i < size; ++i) {
+        char c = data[i];
+        if (c == char(0xDB)) {
+            if (++i == size)
+                return false;
+            if (data[i] == char(0xDC))
+                c = char(0xC0);
+            else if (data[i] == char(0xDD))
+                c = char(0xDB);
+            else
+                return false;
+        }
+        data[out++] = c;
+    }
+    frame->resize(out);
+    return true;
+}
+
+/*
+    Decodes the COBS \a frame (without its final 0) in place. Returns false
+    if a code byte points past the end or is 0.
+*/
+static bool cobsDecode(QByteArray *frame)
+{
+    char *data = frame->data();
+    int size = frame->size();
+    int in = 0, out = 0;
+    while (in < size) {
+        int code = uchar(data[in++]);
+        if (code == 0 || in + code - 1 > size)
+            return false;
+        for (int i = 1; i < code; ++i)
+            data[out++] = data[in++];
+        // a code of 0xFF means 254 bytes without a 0, and the last 0 is implied
+        if (code < 0xFF && in < size)
+            data[out++] = '\0';
+    }
+    frame->resize(out);
+    return true;
+}
+
+/*
+    For the delimited modes: returns the offset of the delimiter that ends
+    the first frame in the read buffer, with in *start the offset of its
+    first byte (past the empty frames of repeated delimiters), or -1 if no
+    frame is complete. Bytes scanned without finding a delimiter are not
+    scanned again. Consumer side.
+*/
+int QextSerialPortPrivate::findFrame(const QextFraming &framing, int *start) const
+{
+    char delimiter = frameDelimiter(framing);
+    uint head = readBuffer.readPosition();
+    int scanned = qMax(0, int(frameScanEnd - head));
+    // measured before scanning: bytes that arrive meanwhile are scanned
+    // again next time
+    int available = readBuffer.size();
+    *start = 0;
+    forever {
+        int end = readBuffer.indexOf(delimiter, qMax(scanned, *start));
+        if (end == -1) {
+            frameScanEnd = head + uint(available);
+            return -1;
+        }
+        if (end > *start)
+            return end;
+        ++*start;
     }
 }
 
+/*
+    Takes the next frame out of the read buffer into \a frame, dropping (and
+    counting) the malformed ones on the way. Returns false if no complete
+    frame is there. Consumer side.
+*/
+bool QextSerialPortPrivate::takeFrame(QByteArray *frame)
+{
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(snapshot);
+    const QextFraming &framing = settings->framing;
+    forever {
+        int available = readBuffer.size();
+        switch (framing.mode) {
+        case QextFraming::NoFraming:
+            return false;
+
+        case QextFraming::FixedSize:
+            if (available < framing.size)
+                return false;
+            frame->resize(framing.size);
+            readBuffer.read(frame->data(), framing.size);
+            return true;
+
+        case QextFraming::LengthPrefixed: {
+            uchar prefix[4];
+            if (!readBuffer.peek(reinterpret_cast<char *>(prefix), 0, framing.size))
+                return false;
+            quint32 length = 0;
+            for (int i = 0; i < framing.size; ++i)
+                length |= quint32(prefix[i]) << (8 * (framing.bigEndian ? framing.size - 1 - i : i));
+            if (length > quint32(framing.maxSize)) {
+                // not a frame start after all: look for one a byte later
+                readBuffer.consume(1);
+                countBadFrame();
+                continue;
+            }
+            if (available < framing.size + int(length))
+                return false;
+            readBuffer.consume(framing.size);
+            if (length == 0)
+                continue;
+            frame->resize(int(length));
+            readBuffer.read(frame->data(), int(length));
+            return true;
+        }
+
+        default: {
+            int start;
+            int end = findFrame(framing, &start);
+            int limit = encodedLimit(framing);
+            if (end == -1) {
+                if (available - start > limit) {
+                    // no delimiter where there should have been one
+                    readBuffer.consume(available);
+                    countBadFrame();
+                    continue;
+                }
+                return false;
+            }
+            readBuffer.consume(start);
+            int size = end - start;
+            if (size > limit) {
+                readBuffer.consume(size + 1);
+                countBadFrame();
+                continue;
+            }
+            frame->resize(size);
+            readBuffer.read(frame->data(), size);
+            readBuffer.consume(1);
+            bool valid = true;
+            if (framing.mode == QextFraming::Slip)
+                valid = slipDecode(frame);
+            else if (framing.mode == QextFraming::Cobs)
+                valid = cobsDecode(frame);
+            if (!valid || frame->size() > framing.maxSize) {
+                countBadFrame();
+                continue;
+            }
+            if (frame->isEmpty())
+                continue;   // an empty COBS packet
+            return true;
+        }
+        }
+    }
+}
+
+/*
+    Counts for linkStats() the frames of the current framing whose last byte
+    is among the first \a bytes of \a buffers, which the port accepted.
+    Where the frame being written stands is kept between calls, so a frame
+    may be split across them. Empty frames are not counted, as readFrame()
+    on the other side skips them. Called with lock held.
+*/
+void QextSerialPortPrivate::countFramesSent(const QextWriteBuffer *buffers, int count, qint64 bytes)
+{
+    if (framing.mode == QextFraming::NoFraming)
+        return;
+
+    int frames = 0;
+    for (int b = 0; b < count && bytes > 0; ++b) {
+        const char *data = buffers[b].data;
+        qint64 size = qMin(buffers[b].size, bytes);
+        bytes -= size;
+
+        switch (framing.mode) {
+        case QextFraming::FixedSize:
+            frameOutPos += size;
+            frames += int(frameOutPos / framing.size);
+            frameOutPos %= framing.size;
+            break;
+
+        case QextFraming::LengthPrefixed:
+            for (qint64 i = 0; i < size;) {
+                if (frameOutPos < framing.size) {
+                    int byte = int(frameOutPos);
+                    int shift = 8 * (framing.bigEndian ? framing.size - 1 - byte : byte);
+                    frameOutLength |= quint32(uchar(data[i++])) << shift;
+                    if (++frameOutPos < framing.size)
+                        continue;
+                } else {
+                    qint64 take = qMin(size - i, framing.size + qint64(frameOutLength) - frameOutPos);
+                    i += take;
+                    frameOutPos += take;
+                }
+                if (frameOutPos == framing.size + qint64(frameOutLength)) {
+                    if (frameOutLength > 0)
+                        ++frames;
+                    frameOutPos = 0;
+                    frameOutLength = 0;
+                }
+            }
+            break;
+
+        default: {
+            // frameOutPos: bytes since the last delimiter
+            char delimiter = frameDelimiter(framing);
+            const char *end = data + size;
+            for (const char *p = data; p < end;) {
+                const char *found = static_cast<const char *>(memchr(p, delimiter, size_t(end - p)));
+                if (!found) {
+                    frameOutPos += end - p;
+                    break;
+                }
+                if (frameOutPos + (found - p) > 0)
+                    ++frames;
+                frameOutPos = 0;
+                p = found + 1;
+            }
+            break;
+        }
+        }
+    }
+
+    if (frames > 0)
+        linkCounters[QextLinkMonitor::FramesOut].fetchAndAddRelaxed(frames);
+}
+
+/*! \class QextLatencyHistogram
+
+    \brief A histogram of latencies, in microseconds.
+
+    Values below 64 us are counted exactly; above that, each power of two is
+    split in 32 buckets, so every value is known within 1/32 (about 3%) of
+    itself, as in HdrHistogram. Values of 2^31 us and more are counted in the
+    last bucket.
+*/
+
+QextLatencyHistogram::QextLatencyHistogram()
+{
+    reset();
+}
+
+/*!
+    Counts one occurrence of \a usecs. Negative values count as 0.
+*/
+void QextLatencyHistogram::record(qint64 usecs)
+{
+    if (usecs < 0)
+        usecs = 0;
+    counts[bucketOf(usecs)]++;
+    total++;
+    sum += usecs;
+    lowest = qMin(lowest, usecs);
+    highest = qMax(highest, usecs);
+}
+
+/*!
+    Adds the counts of \a other to this histogram.
+*/
+void QextLatencyHistogram::add(const QextLatencyHistogram &other)
+{
+    for (int i = 0; i < Buckets; ++i)
+        counts[i] += other.counts[i];
+    total += other.total;
+    sum += other.sum;
+    lowest = qMin(lowest, other.lowest);
+    highest = qMax(highest, other.highest);
+}
+
+void QextLatencyHistogram::reset()
+{
+    memset(counts, 0, sizeof(counts));
+    total = 0;
+    sum = 0;
+    lowest = Q_INT64_C(0x7fffffffffffffff);
+    highest = 0;
+}
+
+double QextLatencyHistogram::mean() const
+{
+    return total ? double(sum) / total : 0.0;
+}
+
+/*!
+    Returns the value below or at which \a percentile percent of the counted
+    values lie, as the highest value of its bucket.
+*/
+qint64 QextLatencyHistogram::valueAtPercentile(double percentile) const
+{
+    if (total == 0)
+        return 0;
+    qint64 rank = qint64(ceil(percentile / 100.0 * total));
+    rank = qBound(Q_INT64_C(1), rank, total);
+    qint64 seen = 0;
+    for (int i = 0; i < Buckets - 1; ++i) {
+        seen += counts[i];
+        if (seen >= rank)
+            return qMin(bucketLowerBound(i + 1) - 1, highest);
+    }
+    return highest;
+}
+
+/*!
+    Returns the lowest value counted in \a bucket; the bucket holds the
+    values up to the lower bound of the next one.
+*/
+qint64 QextLatencyHistogram::bucketLowerBound(int bucket)
+{
+    if (bucket < 2 * SubBuckets)
+        return bucket;
+    int shift = bucket / SubBuckets - 1;
+    return qint64(bucket % SubBuckets + SubBuckets) << shift;
+}
+
+int QextLatencyHistogram::bucketOf(qint64 usecs)
+{
+    if (usecs < 2 * SubBuckets)
+        return int(usecs);
+    int shift = 1;
+    while ((usecs >> shift) >= 2 * SubBuckets)
+        ++shift;
+    return qMin(shift * SubBuckets + int(usecs >> shift), int(Buckets) - 1);
+}
+
 /*! \class QextSerialPort
 
     \brief The QextSerialPort class encapsulates a serial port on both POSIX and Windows systems.
@@ -363,6 +1077,10 @@ void QextSerialPortPrivate::_q_canRead()
      asynchronously read and write
   \value EventDriven
      synchronously read and write
+  \value IoThread
+     like EventDriven, but the port is read by a dedicated thread shared by
+     all ports in this mode, so a busy owning thread does not delay reads.
+     Only available on Linux; elsewhere it behaves as EventDriven.
 */
 
 /*!
@@ -373,6 +1091,13 @@ void QextSerialPortPrivate::_q_canRead()
     \a status true when DSR signal is on, false otherwise.
  */
 
+/*!
+    \fn void QextSerialPort::frameReady()
+    This signal is emitted after readyRead() when new data has completed at
+    least one frame that the readyRead() handlers left unread; see
+    setFraming(). Not emitted in Polling mode.
+ */
+
 
 /*!
     \fn QueryMode QextSerialPort::queryMode() const
@@ -479,8 +1204,14 @@ bool QextSerialPort::open(OpenMode mode)
 {
     Q_D(QextSerialPort);
     QWriteLocker locker(&d->lock);
-    if (mode != QIODevice::NotOpen && !isOpen())
+    if (mode != QIODevice::NotOpen && !isOpen()) {
         d->open_sys(mode);
+        d->publishSettings();
+        d->frameOutPos = 0;
+        d->frameOutLength = 0;
+        if (isOpen())
+            d->sampleLink(true, true);
+    }
 
     return isOpen();
 }
@@ -500,12 +1231,18 @@ void QextSerialPort::close()
         QIODevice::close(); // mark ourselves as closed
         d->close_sys();
         d->readBuffer.clear();
+        d->stampBuffer.clear();
+        d->publishSettings();
     }
 }
 
 /*!
     Flushes all pending I/O to the serial port.  This function has no effect if the serial port
     associated with the class is not currently open.
+
+    On POSIX systems it gives up if the device neither takes nor transmits
+    anything for two seconds (a wedged device, such as one whose CTS was
+    lost), and lastError() is set to E_WRITE_FAILED.
 */
 void QextSerialPort::flush()
 {
@@ -516,22 +1253,148 @@ void QextSerialPort::flush()
 }
 
 /*! \reimp
-    Returns the number of bytes waiting in the port's receive queue.  This function will return 0 if
-    the port is not currently open, or -1 on error.
+    Returns the number of bytes written to the port that the driver has not
+    taken yet. Only in EventDriven and IoThread modes, which queue what the
+    driver can not take at once; in Polling mode writes never wait.
+
+    \sa setWriteHighWaterMark()
+*/
+qint64 QextSerialPort::bytesToWrite() const
+{
+    QReadLocker locker(&d_func()->lock);
+    if (!isOpen())
+        return 0;
+    return d_func()->bytesToWrite_sys() + QIODevice::bytesToWrite();
+}
+
+/*! \reimp
+    Blocks until data is available for reading or \a msecs milliseconds
+    have passed (-1 waits forever), without using the CPU meanwhile.
+    Returns true at once if the port has unread data already, and false on
+    timeout or error.
+
+    In EventDriven and IoThread modes the data is moved into the read buffer
+    and readyRead() is emitted before this returns. Meant for ports used
+    from a worker thread, which have no event loop to wait in.
+
+    \sa waitForBytesWritten()
+*/
+bool QextSerialPort::waitForReadyRead(int msecs)
+{
+    Q_D(QextSerialPort);
+    if (!isOpen() || !(openMode() & QIODevice::ReadOnly))
+        return false;
+    if (QIODevice::bytesAvailable() > 0)
+        return true;
+    return d->waitForReadyRead_sys(msecs);
+}
+
+/*! \reimp
+    Blocks until some of the queued data has been written, emitting
+    bytesWritten(), or \a msecs milliseconds have passed (-1 waits
+    forever). With nothing queued, as always in Polling mode, waits until
+    the driver has transmitted what it was given instead. Returns false on
+    timeout or error.
+
+    On Windows the timeout does not apply to the wait for transmission.
+
+    \sa bytesToWrite(), waitForReadyRead()
+*/
+bool QextSerialPort::waitForBytesWritten(int msecs)
+{
+    Q_D(QextSerialPort);
+    if (!isOpen() || !(openMode() & QIODevice::WriteOnly))
+        return false;
+    return d->waitForBytesWritten_sys(msecs);
+}
+
+/*!
+    Limits the bytes waiting to be written to \a bytes: once that many are
+    queued (see bytesToWrite()), write() and writev() take only what fits
+    and return short counts, or 0, instead of queueing without bound. The
+    caller can then drop stale data and retry after bytesWritten().
+
+    0, the default, sets no limit. Has no effect in Polling mode.
+*/
+void QextSerialPort::setWriteHighWaterMark(qint64 bytes)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    d->writeHighWaterMark = qMax(qint64(0), bytes);
+    d->publishSettings();
+}
+
+qint64 QextSerialPort::writeHighWaterMark() const
+{
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->writeHighWaterMark;
+}
+
+/*! \reimp
+    Returns the number of bytes that can be read without waiting, or -1 on
+    error. 0 if the port is not open.
+
+    The count is taken from the read buffer, which every read() fills ahead
+    with all the driver has, so calling this several times costs no system
+    call. Only when the buffer is empty is the driver asked: in Polling mode
+    through refresh(), in EventDriven mode by counting what the driver holds
+    without reading it, so the bytes still come with a readyRead(). Bytes
+    that arrived in the driver after the last read are therefore not counted
+    until the buffer runs out; call refresh() to count them.
+
+    \sa refresh()
 */
 qint64 QextSerialPort::bytesAvailable() const
 {
-    QWriteLocker locker(&d_func()->lock);
-    if (isOpen()) {
-        qint64 bytes = d_func()->bytesAvailable_sys();
-        if (bytes != -1) {
-            return bytes + d_func()->readBuffer.size()
-                    + QIODevice::bytesAvailable();
-        } else {
+    Q_D(const QextSerialPort);
+    if (!isOpen())
+        return 0;
+    qint64 bytes = d->readBuffer.size() + QIODevice::bytesAvailable();
+    if (bytes > 0)
+        return bytes;
+    if (queryMode() == EventDriven) {
+        QReadLocker locker(&d->lock);
+        return d->bytesAvailable_sys();
+    }
+    return const_cast<QextSerialPort *>(this)->refresh();
+}
+
+/*!
+    Moves all the bytes waiting in the driver into the read buffer and
+    returns the number of bytes that can be read without waiting, or -1 on
+    error. Unlike bytesAvailable() this always asks the driver (one
+    FIONREAD, plus the reads), for callers that need its exact count.
+
+    In EventDriven mode the bytes moved are announced with readyRead(), as
+    the event loop would have. In IoThread mode the I/O thread does the
+    reading, and this returns what it has moved so far.
+
+    \sa bytesAvailable()
+*/
+qint64 QextSerialPort::refresh()
+{
+    Q_D(QextSerialPort);
+    if (!isOpen())
+        return 0;
+    bool fill = true;
+#ifdef Q_OS_LINUX
+    fill = (d->ioEventFd == -1);
+#endif
+    if (fill) {
+        qint64 moved;
+        {
+            QWriteLocker locker(&d->lock);
+            moved = d->fillReadBuffer(false);
+        }
+        if (moved < 0)
             return -1;
+        if (moved > 0 && queryMode() == EventDriven) {
+            Q_EMIT readyRead();
+            if (canReadFrame())
+                Q_EMIT frameReady();
         }
     }
-    return 0;
+    return d->readBuffer.size() + QIODevice::bytesAvailable();
 }
 
 /*! \reimp
@@ -539,7 +1402,7 @@ qint64 QextSerialPort::bytesAvailable() const
 */
 bool QextSerialPort::canReadLine() const
 {
-    QReadLocker locker(&d_func()->lock);
+    // the read buffer is lock-free
     return QIODevice::canReadLine() || d_func()->readBuffer.canReadLine();
 }
 
@@ -563,15 +1426,26 @@ bool QextSerialPort::canReadLine() const
  * Generally event driven approach is more capable and friendly, although some
  * applications may need as low overhead as possible and then polling comes.
  *
+ * With IoThread, a single thread waits on all ports opened in this mode and
+ * moves incoming bytes into each port's read buffer as soon as they arrive;
+ * readyRead() is still emitted in the owning thread. read() never blocks and
+ * only returns what that thread has already received. The mode takes effect
+ * on the next open().
+ *
  * \a mode query mode.
  */
 void QextSerialPort::setQueryMode(QueryMode mode)
 {
     Q_D(QextSerialPort);
     QWriteLocker locker(&d->lock);
+#ifndef Q_OS_LINUX
+    if (mode == IoThread)
+        mode = EventDriven;
+#endif
     if (mode != d->_queryMode) {
         d->_queryMode = mode;
     }
+    d->publishSettings();
 }
 
 /*!
@@ -582,6 +1456,7 @@ void QextSerialPort::setPortName(const QString & name)
     Q_D(QextSerialPort);
     QWriteLocker locker(&d->lock);
     d->port = name;
+    d->publishSettings();
 }
 
 /*!
@@ -589,35 +1464,271 @@ void QextSerialPort::setPortName(const QString & name)
 */
 QString QextSerialPort::portName() const
 {
-    QReadLocker locker(&d_func()->lock);
-    return d_func()->port;
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->port;
 }
 
 QextSerialPort::QueryMode QextSerialPort::queryMode() const
 {
-    QReadLocker locker(&d_func()->lock);
-    return d_func()->_queryMode;
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->queryMode;
 }
 
 /*!
     Reads all available data from the device, and returns it as a QByteArray.
     This function has no way of reporting errors; returning an empty QByteArray()
     can mean either that no data was currently available for reading, or that an error occurred.
+
+    What is available is counted as bytesAvailable() does: the bytes read
+    ahead into the read buffer, or those in the driver if there are none.
 */
 QByteArray QextSerialPort::readAll()
 {
-    int avail = this->bytesAvailable();
+    qint64 avail = this->bytesAvailable();
     return (avail > 0) ? this->read(avail) : QByteArray();
 }
 
+/*!
+    Gives access to received data without copying it. Sets \a data to the
+    oldest unread byte in the read buffer and returns how many bytes follow it
+    contiguously, or 0 if there are none. The bytes stay in the buffer until
+    consume() is called, so a parser can decode a message in place and take
+    it only when it is complete.
+
+    The buffer is circular: a message may be split between its end and its
+    start, in which case fewer bytes are returned than bytesAvailable() and
+    the rest follows after consume(). read() into a local buffer handles that
+    case without allocating.
+
+    Except in IoThread mode, bytes waiting in the driver are first moved into
+    the buffer. If there are none in either place, this waits up to the
+    timeout, as read() does.
+
+    Only the read buffer of QextSerialPort is seen, not the one of QIODevice:
+    open the port with QIODevice::Unbuffered when using this function.
+
+    \sa consume()
+*/
+qint64 QextSerialPort::readableSpan(const char **data)
+{
+    Q_D(QextSerialPort);
+    bool fill = true;
+#ifdef Q_OS_LINUX
+    fill = (d->ioEventFd == -1);
+#endif
+    if (fill && isOpen()) {
+        QWriteLocker locker(&d->lock);
+        d->fillReadBuffer(true);
+    }
+    int size;
+    *data = d->readBuffer.readSpan(&size);
+    return size;
+}
+
+/*!
+    Discards the first \a size bytes returned by readableSpan().
+
+    \sa readableSpan()
+*/
+void QextSerialPort::consume(qint64 size)
+{
+    Q_D(QextSerialPort);
+    d->readBuffer.consume(int(qMin(size, qint64(d->readBuffer.size()))));
+    d->consumeStamps();
+#ifdef Q_OS_LINUX
+    if (d->ioEventFd != -1)
+        QextIoThread::instance()->resume(d);
+#endif
+}
+
+/*! \class QextFraming
+
+    Describes how readFrame() splits the received bytes into frames:
+
+    \list
+    \o fixedSize(): every frame has the same size.
+    \o lengthPrefixed(): a length of 1, 2 or 4 bytes, little or big endian,
+       followed by that many bytes; readFrame() returns them without the
+       length. Frames of length 0 are skipped.
+    \o delimited(): frames end with a delimiter byte, which readFrame()
+       removes. Empty frames are skipped.
+    \o slip(): SLIP (RFC 1055) frames, unescaped by readFrame().
+    \o cobs(): COBS frames ending with a 0, decoded by readFrame().
+    \endlist
+
+    Frames longer than maxSize (after decoding) are dropped, as are
+    malformed SLIP and COBS frames; QextLinkStats::badFrames counts them.
+    In the delimited modes the next frame starts after the next delimiter;
+    with a length prefix, one byte after the start of the dropped frame.
+*/
+
+QextFraming QextFraming::fixedSize(int size)
+{
+    QextFraming framing;
+    framing.mode = FixedSize;
+    framing.size = size;
+    framing.maxSize = size;
+    return framing;
+}
+
+QextFraming QextFraming::lengthPrefixed(int prefixSize, bool bigEndian)
+{
+    QextFraming framing;
+    framing.mode = LengthPrefixed;
+    framing.size = prefixSize;
+    framing.bigEndian = bigEndian;
+    return framing;
+}
+
+QextFraming QextFraming::delimited(char delimiter)
+{
+    QextFraming framing;
+    framing.mode = Delimited;
+    framing.delimiter = delimiter;
+    return framing;
+}
+
+QextFraming QextFraming::slip()
+{
+    QextFraming framing;
+    framing.mode = Slip;
+    return framing;
+}
+
+QextFraming QextFraming::cobs()
+{
+    QextFraming framing;
+    framing.mode = Cobs;
+    return framing;
+}
+
+QextFraming QextSerialPort::framing() const
+{
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->framing;
+}
+
+/*!
+    Sets how readFrame() splits the received bytes into frames; see
+    QextFraming. The default, QextFraming::NoFraming, turns frames off.
+    Takes effect at once, from the oldest unread byte.
+
+    Frames are found in the read buffer of QextSerialPort, with memchr() for
+    the delimited modes, without copying until readFrame() takes one. Like
+    readableSpan(), this needs the port opened with QIODevice::Unbuffered.
+
+    \sa frameReady()
+*/
+void QextSerialPort::setFraming(const QextFraming &framing)
+{
+    Q_D(QextSerialPort);
+    bool valid = framing.maxSize > 0;
+    if (framing.mode == QextFraming::FixedSize)
+        valid = framing.size > 0;
+    else if (framing.mode == QextFraming::LengthPrefixed)
+        valid = valid && (framing.size == 1 || framing.size == 2 || framing.size == 4);
+    if (!valid) {
+        QESP_WARNING("QextSerialPort::setFraming: invalid frame size");
+        return;
+    }
+
+    QWriteLocker locker(&d->lock);
+    d->framing = framing;
+    d->frameScanEnd = d->readBuffer.readPosition();
+    d->frameOutPos = 0;
+    d->frameOutLength = 0;
+    d->publishSettings();
+}
+
+/*!
+    Returns true if a whole frame is in the read buffer; see setFraming().
+    The frame may still turn out to be malformed, in which case readFrame()
+    drops it. Does not look at the bytes still in the driver.
+*/
+bool QextSerialPort::canReadFrame() const
+{
+    Q_D(const QextSerialPort);
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d->snapshot);
+    const QextFraming &framing = settings->framing;
+    switch (framing.mode) {
+    case QextFraming::NoFraming:
+        return false;
+    case QextFraming::FixedSize:
+        return d->readBuffer.size() >= framing.size;
+    case QextFraming::LengthPrefixed: {
+        uchar prefix[4];
+        if (!d->readBuffer.peek(reinterpret_cast<char *>(prefix), 0, framing.size))
+            return false;
+        quint32 length = 0;
+        for (int i = 0; i < framing.size; ++i)
+            length |= quint32(prefix[i]) << (8 * (framing.bigEndian ? framing.size - 1 - i : i));
+        return length > quint32(framing.maxSize)
+                || d->readBuffer.size() >= framing.size + int(length);
+    }
+    default: {
+        int start;
+        return d->findFrame(framing, &start) != -1;
+    }
+    }
+}
+
+/*!
+    Takes the next frame, decoded and without its length or delimiter, out
+    of the read buffer; see setFraming(). Returns an empty QByteArray if no
+    whole frame has arrived. Never waits.
+
+    Except in IoThread mode, bytes waiting in the driver are first moved into
+    the read buffer, so this also works in Polling mode.
+
+    \sa frameReady(), canReadFrame()
+*/
+QByteArray QextSerialPort::readFrame()
+{
+    Q_D(QextSerialPort);
+    bool fill = true;
+#ifdef Q_OS_LINUX
+    fill = (d->ioEventFd == -1);
+#endif
+    if (fill && isOpen()) {
+        QWriteLocker locker(&d->lock);
+        d->fillReadBuffer(false);
+    }
+
+    QByteArray frame;
+    uint head = d->readBuffer.readPosition();
+    bool found = d->takeFrame(&frame);
+    if (found)
+        d->countFrameIn();
+    if (d->readBuffer.readPosition() != head) {
+        d->consumeStamps();
+#ifdef Q_OS_LINUX
+        if (d->ioEventFd != -1)
+            QextIoThread::instance()->resume(d);
+#endif
+    }
+    return found ? frame : QByteArray();
+}
+
 /*!
     Returns the baud rate of the serial port.  For a list of possible return values see
     the definition of the enum BaudRateType.
 */
 BaudRateType QextSerialPort::baudRate() const
 {
-    QReadLocker locker(&d_func()->lock);
-    return d_func()->Settings.BaudRate;
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->Settings.BaudRate;
+}
+
+/*!
+    Returns the baud rate the driver actually applied, which may differ from
+    baudRate() when the hardware can only approximate it. On Linux this is
+    read back from the driver after every change; elsewhere, and while the
+    port is closed, it is the requested rate.
+*/
+int QextSerialPort::actualBaudRate() const
+{
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->actualBaudRate;
 }
 
 /*!
@@ -626,8 +1737,8 @@ BaudRateType QextSerialPort::baudRate() const
 */
 DataBitsType QextSerialPort::dataBits() const
 {
-    QReadLocker locker(&d_func()->lock);
-    return d_func()->Settings.DataBits;
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->Settings.DataBits;
 }
 
 /*!
@@ -636,8 +1747,8 @@ DataBitsType QextSerialPort::dataBits() const
 */
 ParityType QextSerialPort::parity() const
 {
-    QReadLocker locker(&d_func()->lock);
-    return d_func()->Settings.Parity;
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->Settings.Parity;
 }
 
 /*!
@@ -646,8 +1757,8 @@ ParityType QextSerialPort::parity() const
 */
 StopBitsType QextSerialPort::stopBits() const
 {
-    QReadLocker locker(&d_func()->lock);
-    return d_func()->Settings.StopBits;
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->Settings.StopBits;
 }
 
 /*!
@@ -656,8 +1767,8 @@ StopBitsType QextSerialPort::stopBits() const
 */
 FlowType QextSerialPort::flowControl() const
 {
-    QReadLocker locker(&d_func()->lock);
-    return d_func()->Settings.FlowControl;
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->Settings.FlowControl;
 }
 
 /*!
@@ -785,6 +1896,7 @@ void QextSerialPort::setFlowControl(FlowType flow)
     QWriteLocker locker(&d->lock);
     if (d->Settings.FlowControl != flow)
         d->setFlowControl(flow, true);
+    d->publishSettings();
 }
 
 /*!
@@ -803,6 +1915,7 @@ void QextSerialPort::setParity(ParityType parity)
     QWriteLocker locker(&d->lock);
     if (d->Settings.Parity != parity)
         d->setParity(parity, true);
+    d->publishSettings();
 }
 
 /*!
@@ -828,6 +1941,7 @@ void QextSerialPort::setDataBits(DataBitsType dataBits)
     QWriteLocker locker(&d->lock);
     if (d->Settings.DataBits != dataBits)
         d->setDataBits(dataBits, true);
+    d->publishSettings();
 }
 
 /*!
@@ -852,6 +1966,7 @@ void QextSerialPort::setStopBits(StopBitsType stopBits)
     QWriteLocker locker(&d->lock);
     if (d->Settings.StopBits != stopBits)
         d->setStopBits(stopBits, true);
+    d->publishSettings();
 }
 
 /*!
@@ -907,6 +2022,7 @@ void QextSerialPort::setBaudRate(BaudRateType baudRate)
     QWriteLocker locker(&d->lock);
     if (d->Settings.BaudRate != baudRate)
         d->setBaudRate(baudRate, true);
+    d->publishSettings();
 }
 
 /*!
@@ -941,6 +2057,155 @@ void QextSerialPort::setTimeout(long millisec)
     QWriteLocker locker(&d->lock);
     if (d->Settings.Timeout_Millisec != millisec)
         d->setTimeout(millisec, true);
+    d->publishSettings();
+}
+
+/*!
+    Asks the driver to pass received bytes on immediately instead of batching
+    them: sets ASYNC_LOW_LATENCY on Linux. USB-serial adapters otherwise hold
+    bytes for up to 16 ms. Costs a little more CPU time per byte.
+
+    Whether the driver accepted it is reported by isLowLatency(); ptys and
+    many other devices do not support it. On other systems nothing changes.
+
+    \sa setReadMinimum()
+*/
+void QextSerialPort::setLowLatency(bool enable)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (d->lowLatency != enable)
+        d->setLowLatency(enable, true);
+    d->publishSettings();
+}
+
+/*!
+    Returns true if the driver has accepted low latency mode; see
+    setLowLatency().
+*/
+bool QextSerialPort::isLowLatency() const
+{
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->lowLatency;
+}
+
+/*!
+    POSIX only. Makes a blocking read wait until \a bytes bytes (at most 255)
+    have arrived, so a frame of that size comes back from a single read
+    instead of in pieces (VMIN). Once the first byte has arrived, a read
+    returns early only after a gap of 100 ms in the data (VTIME); the timeout
+    set with setTimeout() applies to the first byte.
+
+    0, the default, returns as soon as any byte is available.
+*/
+void QextSerialPort::setReadMinimum(int bytes)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (d->readMinimum != bytes)
+        d->setReadMinimum(bytes, true);
+    d->publishSettings();
+}
+
+/*!
+    Returns the number of bytes a blocking read waits for; see
+    setReadMinimum(). While the port is open, this is the value read back
+    from the driver.
+*/
+int QextSerialPort::readMinimum() const
+{
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->readMinimum;
+}
+
+/*!
+    Stamps every chunk of received data with the monotonic clock when it is
+    taken from the driver, and measures how long it then waits in the read
+    buffer until read() or consume() takes its last byte (the dwell time) and
+    how much the time between consecutive chunks varies (the jitter). Both
+    are reported, in microseconds, by receiveStats().
+
+    Only data that passes through the read buffer is stamped: in Polling
+    mode, bytes that read() takes straight from the driver are not. Off by
+    default; the cost is one clock read per chunk on each side.
+
+    \sa resetReceiveStats()
+*/
+void QextSerialPort::setReceiveTimestamping(bool enable)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    d->receiveStamping.fetchAndStoreOrdered(enable ? 1 : 0);
+    d->publishSettings();
+}
+
+bool QextSerialPort::isReceiveTimestamping() const
+{
+    QextSnapshot<QextSettingsSnapshot>::Reader settings(d_func()->snapshot);
+    return settings->receiveStamping;
+}
+
+/*!
+    Returns a copy of the receive statistics gathered since the last
+    resetReceiveStats(); see setReceiveTimestamping(). Can be called from
+    any thread.
+*/
+QextReceiveStats QextSerialPort::receiveStats() const
+{
+    QMutexLocker locker(&d_func()->statsLock);
+    return d_func()->stats;
+}
+
+void QextSerialPort::resetReceiveStats()
+{
+    Q_D(QextSerialPort);
+    QMutexLocker locker(&d->statsLock);
+    d->stats = QextReceiveStats();
+    d->lastArrival = 0;
+    d->lastInterval = -1;
+}
+
+/*!
+    Returns the link statistics since the port was opened or
+    resetLinkStats() was called: bytes and frames in and out, the read and
+    write calls that moved them, the receive errors counted by the driver,
+    and the rates of all of them over the last second and the last ten
+    seconds.
+
+    QextLinkStats::readCalls counts the reads from the driver that returned
+    data and QextLinkStats::writeCalls the write() and writev() calls that
+    wrote some. The frames are those of setFraming():
+    QextLinkStats::framesIn counts the frames readFrame() returned, and
+    QextLinkStats::framesOut the frames whose last byte write() or writev()
+    accepted, however the caller split them between calls. Without framing
+    both stay at zero. The error counters are only
+    filled in where the driver keeps them (QextLinkStats::hasErrorCounters);
+    a pty, for one, does not.
+
+    The byte, call and frame totals are always current. The rates and the error
+    counters are only refreshed every quarter of a second, so calling this
+    on every frame costs a few atomic reads. Can be called from any thread,
+    and never waits for the port: while another thread holds it, in a
+    blocking read for instance, the error counters are left as they were.
+
+    \sa lineStatus()
+*/
+QextLinkStats QextSerialPort::linkStats() const
+{
+    Q_D(const QextSerialPort);
+    bool locked = d->lock.tryLockForRead();
+    d->sampleLink(false, locked);
+    if (locked)
+        d->lock.unlock();
+    QMutexLocker statsLocker(&d->statsLock);
+    return d->link.stats();
+}
+
+void QextSerialPort::resetLinkStats()
+{
+    Q_D(QextSerialPort);
+    QReadLocker locker(&d->lock);
+    d->sampleLink(true, true);
 }
 
 /*!
@@ -979,18 +2244,100 @@ void QextSerialPort::setRts(bool set)
 qint64 QextSerialPort::readData(char *data, qint64 maxSize)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
-    qint64 bytesFromBuffer = 0;
-    if (!d->readBuffer.isEmpty()) {
-        bytesFromBuffer = d->readBuffer.read(data, maxSize);
-        if (bytesFromBuffer == maxSize)
-            return bytesFromBuffer;
+    // the read buffer is lock-free; only the device access needs the lock
+    qint64 bytesFromBuffer = d->readBuffer.read(data, int(qMin(maxSize, qint64(d->readBuffer.capacity()))));
+    if (bytesFromBuffer > 0)
+        d->consumeStamps();
+    if (bytesFromBuffer == maxSize)
+        return bytesFromBuffer;
+#ifdef Q_OS_LINUX
+    if (d->ioEventFd != -1) {
+        // only the I/O thread reads the device
+        QextIoThread::instance()->resume(d);
+        return bytesFromBuffer;
     }
-    qint64 bytesFromDevice = d->readData_sys(data+bytesFromBuffer, maxSize-bytesFromBuffer);
+#endif
+    QWriteLocker locker(&d->lock);
+    // the buffer is empty now: read ahead into it rather than straight into
+    // data, so what the caller did not ask for is counted by bytesAvailable()
+    // without another system call
+    qint64 bytesFromDevice = d->readAhead(maxSize-bytesFromBuffer);
     if (bytesFromDevice < 0) {
+        // the buffered bytes are taken already: report the error next time
+        return bytesFromBuffer > 0 ? bytesFromBuffer : -1;
+    }
+    if (bytesFromDevice == 0)
+        return bytesFromBuffer;
+    qint64 bytesAhead = d->readBuffer.read(data+bytesFromBuffer, int(qMin(maxSize-bytesFromBuffer, qint64(d->readBuffer.capacity()))));
+    d->consumeStamps();
+    return bytesFromBuffer + bytesAhead;
+}
+
+/*! \reimp
+    Reads a line straight from the read buffer when it holds a whole one,
+    and records the dwell time of the bytes taken as read() does. Otherwise
+    falls back to QIODevice, which reads through readData().
+*/
+qint64 QextSerialPort::readLineData(char *data, qint64 maxSize)
+{
+    Q_D(QextSerialPort);
+    int newline = d->readBuffer.indexOf('\n');
+    if (newline == -1)
+        return QIODevice::readLineData(data, maxSize);
+
+    qint64 bytes = d->readBuffer.read(data, int(qMin(qint64(newline) + 1, maxSize)));
+    if (bytes > 0)
+        d->consumeStamps();
+#ifdef Q_OS_LINUX
+    if (d->ioEventFd != -1)
+        QextIoThread::instance()->resume(d);
+#endif
+    return bytes;
+}
+
+/*!
+    Writes \a count buffers, in order, with a single system call where the
+    platform allows it (writev() on POSIX systems), so a frame can be sent as
+    separate header, payload and checksum without first joining them.
+
+    A write interrupted by a signal is resumed where it stopped. In
+    non-blocking mode (timeout -1) the call returns as soon as the driver
+    accepts no more; the caller resumes from the returned position.
+
+    Returns the number of bytes written, which counts across buffers, or -1
+    if nothing could be written because of an error.
+
+    \sa QextWriteBuffer
+*/
+qint64 QextSerialPort::writev(const QextWriteBuffer *buffers, int count)
+{
+    Q_D(QextSerialPort);
+    if (!isOpen() || !(openMode() & QIODevice::WriteOnly)) {
+        QESP_WARNING("QextSerialPort::writev: device not open for writing");
         return -1;
     }
-    return bytesFromBuffer + bytesFromDevice;
+    QWriteLocker locker(&d->lock);
+    qint64 written = d->writev_sys(buffers, count);
+    if (written > 0) {
+        d->countSent(written);
+        d->countFramesSent(buffers, count, written);
+    }
+    return written;
+}
+
+/*!
+    \overload
+
+    Writes the \a buffers without copying their data.
+*/
+qint64 QextSerialPort::writev(const QList<QByteArray> &buffers)
+{
+    QVarLengthArray<QextWriteBuffer, 64> views(buffers.size());
+    for (int i = 0; i < buffers.size(); ++i) {
+        views[i].data = buffers.at(i).constData();
+        views[i].size = buffers.at(i).size();
+    }
+    return writev(views.constData(), views.size());
 }
 
 /*! \reimp
@@ -1005,7 +2352,13 @@ qint64 QextSerialPort::writeData(const char *data, qint64 maxSize)
 {
     Q_D(QextSerialPort);
     QWriteLocker locker(&d->lock);
-    return d->writeData_sys(data, maxSize);
+    qint64 written = d->writeData_sys(data, maxSize);
+    if (written > 0) {
+        QextWriteBuffer buffer = { data, written };
+        d->countSent(written);
+        d->countFramesSent(&buffer, 1, written);
+    }
+    return written;
 }
 
 #include "moc_qextserialport.cpp"
@@ -164,6 +164,145 @@ struct PortSettings
     long Timeout_Millisec;
 };
 
+/**
+ * one buffer of a scatter/gather write, see QextSerialPort::writev()
+ */
+struct QextWriteBuffer
+{
+    const char *data;
+    qint64 size;
+};
+
+/**
+ * histogram of latencies in microseconds, with a relative precision of 1/32
+ * over the whole range (exact below 64 us), in the manner of HdrHistogram
+ */
+class QEXTSERIALPORT_EXPORT QextLatencyHistogram
+{
+public:
+    enum {
+        SubBuckets = 32,
+        Buckets = 27 * SubBuckets   // values up to 2^31 us
+    };
+
+    QextLatencyHistogram();
+
+    void record(qint64 usecs);
+    void add(const QextLatencyHistogram &other);
+    void reset();
+
+    qint64 count() const { return total; }
+    qint64 minimum() const { return total ? lowest : 0; }
+    qint64 maximum() const { return highest; }
+    double mean() const;
+    qint64 valueAtPercentile(double percentile) const;
+
+    static qint64 bucketLowerBound(int bucket);
+    qint64 bucketValue(int bucket) const { return counts[bucket]; }
+
+private:
+    static int bucketOf(qint64 usecs);
+
+    qint64 counts[Buckets];
+    qint64 total;
+    qint64 sum;
+    qint64 lowest;
+    qint64 highest;
+};
+
+/**
+ * receive statistics, see QextSerialPort::setReceiveTimestamping()
+ */
+struct QextReceiveStats
+{
+    QextLatencyHistogram dwell;    // from wake-up to read, per chunk
+    QextLatencyHistogram jitter;   // change between consecutive inter-arrival times
+    qint64 chunks;
+    qint64 bytes;
+    qint64 unstamped;              // chunks received while the stamp queue was full
+
+    QextReceiveStats() : chunks(0), bytes(0), unstamped(0) {}
+};
+
+/**
+ * rates over one window of QextLinkStats, per second
+ */
+struct QextLinkRate
+{
+    double bytesIn;
+    double bytesOut;
+    double readCalls;
+    double writeCalls;
+    double framesIn;
+    double framesOut;
+    double errors;
+
+    QextLinkRate() : bytesIn(0), bytesOut(0), readCalls(0), writeCalls(0), framesIn(0), framesOut(0), errors(0) {}
+};
+
+/**
+ * link statistics, see QextSerialPort::linkStats()
+ */
+struct QextLinkStats
+{
+    qint64 bytesIn;                // taken from the driver
+    qint64 bytesOut;               // accepted by write() and writev()
+    qint64 readCalls;              // reads from the driver that returned data
+    qint64 writeCalls;             // write() and writev() calls that wrote data
+    qint64 framesIn;               // returned by readFrame()
+    qint64 framesOut;              // completed by write() and writev(), see setFraming()
+    qint64 badFrames;              // dropped by readFrame(): too long or badly encoded
+
+    // receive errors counted by the driver: TIOCGICOUNT on Linux,
+    // ClearCommError() on Windows (which reports at most one of each kind
+    // per check)
+    bool hasErrorCounters;
+    qint64 framingErrors;
+    qint64 parityErrors;
+    qint64 overruns;               // the UART lost bytes
+    qint64 bufferOverruns;         // the driver buffer was full
+    qint64 breaks;
+
+    QextLinkRate shortRate;        // over the last second
+    QextLinkRate longRate;         // over the last ten seconds
+
+    qint64 errors() const { return framingErrors + parityErrors + overruns + bufferOverruns + breaks; }
+
+    QextLinkStats()
+        : bytesIn(0), bytesOut(0), readCalls(0), writeCalls(0), framesIn(0), framesOut(0), badFrames(0),
+          hasErrorCounters(false),
+          framingErrors(0), parityErrors(0), overruns(0), bufferOverruns(0), breaks(0) {}
+};
+
+/**
+ * how QextSerialPort::readFrame() splits the received bytes into frames
+ */
+struct QEXTSERIALPORT_EXPORT QextFraming
+{
+    enum Mode {
+        NoFraming,
+        FixedSize,          // every frame is size bytes
+        LengthPrefixed,     // a size-byte length (1, 2 or 4), then that many bytes
+        Delimited,          // frames end with delimiter
+        Slip,               // RFC 1055
+        Cobs                // consistent overhead byte stuffing, 0 ends a frame
+    };
+
+    Mode mode;
+    int size;
+    bool bigEndian;         // of the LengthPrefixed length
+    char delimiter;
+    int maxSize;            // longest frame accepted, after decoding
+
+    QextFraming() : mode(NoFraming), size(0), bigEndian(false), delimiter('\n'), maxSize(4096) {}
+
+    static QextFraming fixedSize(int size);
+    static QextFraming lengthPrefixed(int prefixSize, bool bigEndian = false);
+    static QextFraming delimited(char delimiter);
+    static QextFraming slip();
+    static QextFraming cobs();
+};
+
 class QextSerialPortPrivate;
 class QEXTSERIALPORT_EXPORT QextSerialPort: public QIODevice
 {
@@ -175,7 +314,8 @@ class QEXTSERIALPORT_EXPORT QextSerialPort: public QIODevice
 public:
     enum QueryMode {
         Polling,
-        EventDriven
+        EventDriven,
+        IoThread
     };
 
     explicit QextSerialPort(QueryMode mode = EventDriven, QObject* parent = 0);
@@ -188,6 +328,9 @@ public:
     QString portName() const;
     QueryMode queryMode() const;
     BaudRateType baudRate() const;
+    int actualBaudRate() const;
+    bool isLowLatency() const;
+    int readMinimum() const;
     DataBitsType dataBits() const;
     ParityType parity() const;
     StopBitsType stopBits() const;
@@ -198,8 +341,26 @@ public:
     void close();
     void flush();
     qint64 bytesAvailable() const;
+    qint64 refresh();
+    qint64 bytesToWrite() const;
+    bool waitForReadyRead(int msecs);
+    bool waitForBytesWritten(int msecs);
+    qint64 writeHighWaterMark() const;
     bool canReadLine() const;
     QByteArray readAll();
+    qint64 readableSpan(const char **data);
+    void consume(qint64 size);
+    QextFraming framing() const;
+    void setFraming(const QextFraming &framing);
+    bool canReadFrame() const;
+    QByteArray readFrame();
+    bool isReceiveTimestamping() const;
+    QextReceiveStats receiveStats() const;
+    void resetReceiveStats();
+    QextLinkStats linkStats() const;
+    void resetLinkStats();
+    qint64 writev(const QextWriteBuffer *buffers, int count);
+    qint64 writev(const QList<QByteArray> &buffers);
 
     ulong lastError() const;
 
@@ -215,15 +376,21 @@ public Q_SLOTS:
     void setStopBits(StopBitsType);
     void setFlowControl(FlowType);
     void setTimeout(long);
+    void setLowLatency(bool enable);
+    void setReadMinimum(int bytes);
+    void setReceiveTimestamping(bool enable);
+    void setWriteHighWaterMark(qint64 bytes);
 
     void setDtr(bool set=true);
     void setRts(bool set=true);
 
 Q_SIGNALS:
     void dsrChanged(bool status);
+    void frameReady();
 
 protected:
     qint64 readData(char * data, qint64 maxSize);
+    qint64 readLineData(char * data, qint64 maxSize);
     qint64 writeData(const char * data, qint64 maxSize);
 
 private:
@@ -233,6 +400,7 @@ private:
     Q_PRIVATE_SLOT(d_func(), void _q_onWinEvent(HANDLE))
 #endif
     Q_PRIVATE_SLOT(d_func(), void _q_canRead())
+    Q_PRIVATE_SLOT(d_func(), void _q_canWrite())
 
     QextSerialPortPrivate * const d_ptr;
 };
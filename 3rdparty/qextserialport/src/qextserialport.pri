@@ -26,6 +26,17 @@ qextserialport-library:!qextserialport-buildlib {
                               $$PWD/qextserialenumerator.cpp
     unix {
         SOURCES            += $$PWD/qextserialport_unix.cpp
+        linux* {
+            HEADERS        += $$PWD/qextiothread_p.h
+            SOURCES        += $$PWD/qextiothread_linux.cpp \
+                              $$PWD/qextserialport_linux.cpp
+            # io_uring backend of the I/O thread (Linux 5.1, fixed buffers 5.19)
+            qextserialport-io_uring {
+                DEFINES    += QESP_IO_URING
+                HEADERS    += $$PWD/qextiouring_p.h
+                SOURCES    += $$PWD/qextiouring_linux.cpp
+            }
+        }
         linux*:!qextserialport-no-udev {
             SOURCES        += $$PWD/qextserialenumerator_linux.cpp
         } else:macx {
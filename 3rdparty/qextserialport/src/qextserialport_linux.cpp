@@ -0,0 +1,112 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+// termios2 lives in the kernel headers, which can not be included together
+// with <termios.h>: hence this file, which only talks to the driver.
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include <QtCore/QtGlobal>
+
+/*
+    Sets any baud rate the driver accepts, not only the Bxxx constants, by
+    passing the rate itself along with BOTHER. Returns false on error.
+*/
+bool qextSetCustomBaudRate(int fd, int baudRate)
+{
+    struct termios2 tio;
+    if (::ioctl(fd, TCGETS2, &tio) == -1)
+        return false;
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_ospeed = baudRate;
+#ifdef IBSHIFT
+    // same input speed
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    tio.c_cflag |= BOTHER << IBSHIFT;
+    tio.c_ispeed = baudRate;
+#endif
+    return ::ioctl(fd, TCSETS2, &tio) != -1;
+}
+
+/*
+    Returns the output baud rate actually in effect, as reported back by the
+    driver (which may round it to what the hardware can do), or -1 on error.
+*/
+int qextActualBaudRate(int fd)
+{
+    struct termios2 tio;
+    if (::ioctl(fd, TCGETS2, &tio) == -1)
+        return -1;
+    return int(tio.c_ospeed);
+}
+
+/*
+    Sets or clears ASYNC_LOW_LATENCY, which makes the driver hand received
+    bytes to the line discipline at once instead of batching them (USB
+    adapters such as the FTDI ones also shorten their latency timer to 1 ms).
+    Returns the state read back from the driver, or -1 if the driver does
+    not support the serial ioctls at all (ptys, some USB CDC adapters).
+*/
+int qextSetLowLatency(int fd, bool enable)
+{
+    struct serial_struct serial;
+    if (::ioctl(fd, TIOCGSERIAL, &serial) == -1)
+        return -1;
+    if (enable)
+        serial.flags |= ASYNC_LOW_LATENCY;
+    else
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    ::ioctl(fd, TIOCSSERIAL, &serial);
+    if (::ioctl(fd, TIOCGSERIAL, &serial) == -1)
+        return -1;
+    return (serial.flags & ASYNC_LOW_LATENCY) ? 1 : 0;
+}
+
+/*
+    Reads the receive error counters the driver keeps (TIOCGICOUNT) into
+    \a counts: framing, parity, overrun, buffer overrun and break. They count
+    since the driver loaded, not since the port was opened. Returns false if
+    the driver keeps none (ptys, some USB adapters).
+*/
+bool qextErrorCounters(int fd, qint64 *counts)
+{
+    struct serial_icounter_struct icount;
+    if (::ioctl(fd, TIOCGICOUNT, &icount) == -1)
+        return false;
+    counts[0] = icount.frame;
+    counts[1] = icount.parity;
+    counts[2] = icount.overrun;
+    counts[3] = icount.buf_overrun;
+    counts[4] = icount.brk;
+    return true;
+}
@@ -45,129 +45,369 @@
 
 #include "qextserialport.h"
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QMutex>
+#include <QtCore/QList>
 #ifdef Q_OS_UNIX
 #  include <termios.h>
 #elif (defined Q_OS_WIN)
 #  include <QtCore/qt_windows.h>
 #endif
 #include <stdlib.h>
+#include <string.h>
 
 // This is QextSerialPort's read buffer, needed by posix system.
-// ref: QRingBuffer & QIODevicePrivateLinearBuffer
-class QextReadBuffer
+//
+// A fixed-capacity single-producer/single-consumer ring buffer: one thread
+// fills it (writeSpan() + commitWrite()) while another drains it
+// (readSpan() + consume()) without any lock. Data is never moved once
+// written; the producer and the consumer each own one index, which live on
+// separate cache lines so the two threads do not invalidate each other's
+// line on every update.
+//
+// The indices run freely and are masked on access, so the capacity is
+// always a power of two.
+class QextRingBuffer
 {
 public:
-    inline QextReadBuffer(size_t growth=4096)
-        : len(0), first(0), buf(0), capacity(0), basicBlockSize(growth) {
+    enum { CacheLineSize = 64 };
+
+    inline explicit QextRingBuffer(int minCapacity=65536)
+        : cachedTail(0), cachedHead(0) {
+        int c = 1;
+        while (c < minCapacity)
+            c <<= 1;
+        cap = c;
+        mask = c - 1;
+        buf = new char[c];
     }
 
-    ~QextReadBuffer() {
+    ~QextRingBuffer() {
         delete [] buf;
     }
 
+    inline int capacity() const {
+        return cap;
+    }
+
+    // The memory behind the buffer, e.g. to register it with the kernel.
+    inline char *data() const {
+        return buf;
+    }
+
+    // Consumer side: discards everything written so far.
     inline void clear() {
-        first = buf;
-        len = 0;
+        cachedTail = loadAcquire(tail);
+        storeRelease(head, cachedTail);
     }
 
+    // Bytes ready to be read. Exact on the consumer side, a lower bound
+    // anywhere else.
     inline int size() const {
-        return len;
+        return int(uint(loadAcquire(tail)) - uint(loadAcquire(head)));
     }
 
     inline bool isEmpty() const {
-        return len == 0;
+        return size() == 0;
     }
 
-    inline int read(char* target, int size) {
-        int r = qMin(size, len);
-        if (r == 1) {
-            *target = *first;
-            --len;
-            ++first;
-        } else {
-            memcpy(target, first, r);
-            len -= r;
-            first += r;
-        }
-        return r;
+    // Producer side: bytes that can be written.
+    inline int freeSpace() const {
+        return cap - int(uint(loadRelaxed(tail)) - uint(loadAcquire(head)));
     }
 
-    inline char* reserve(size_t size) {
-        if ((first - buf) + len + size > capacity) {
-            size_t newCapacity = qMax(capacity, basicBlockSize);
-            while (newCapacity < size)
-                newCapacity *= 2;
-            if (newCapacity > capacity) {
-                // allocate more space
-                char* newBuf = new char[newCapacity];
-                memmove(newBuf, first, len);
-                delete [] buf;
-                buf = newBuf;
-                capacity = newCapacity;
-            } else {
-                // shift any existing data to make space
-                memmove(buf, first, len);
-            }
-            first = buf;
+    // Producer side: returns where the next bytes go and, in *size, how many
+    // fit contiguously there (0 if the buffer is full). A full write may
+    // need two spans when the free area wraps around.
+    inline char *writeSpan(int *size) {
+        uint t = uint(loadRelaxed(tail));
+        if (int(t - cachedHead) == cap)
+            cachedHead = uint(loadAcquire(head));
+        int free = cap - int(t - cachedHead);
+        int offset = int(t & mask);
+        *size = qMin(free, cap - offset);
+        return buf + offset;
+    }
+
+    // Producer side: publishes n bytes written to the last writeSpan().
+    inline void commitWrite(int n) {
+        storeRelease(tail, int(uint(loadRelaxed(tail)) + uint(n)));
+    }
+
+    // Consumer side: returns the oldest unread bytes and, in *size, how many
+    // are contiguous there (0 if the buffer is empty).
+    inline const char *readSpan(int *size) const {
+        uint h = uint(loadRelaxed(head));
+        if (h == cachedTail)
+            cachedTail = uint(loadAcquire(tail));
+        int offset = int(h & mask);
+        *size = qMin(int(cachedTail - h), cap - offset);
+        return buf + offset;
+    }
+
+    // Free-running count of the bytes consumed so far (consumer side) and
+    // committed so far (producer side); wraps around like the indices.
+    inline uint readPosition() const {
+        return uint(loadRelaxed(head));
+    }
+
+    inline uint writePosition() const {
+        return uint(loadRelaxed(tail));
+    }
+
+    // Consumer side: releases n bytes returned by readSpan() to the producer.
+    inline void consume(int n) {
+        storeRelease(head, int(uint(loadRelaxed(head)) + uint(n)));
+    }
+
+    // Consumer side: copies up to maxSize bytes out of the buffer.
+    inline int read(char *target, int maxSize) {
+        int total = 0;
+        while (total < maxSize) {
+            int n;
+            const char *span = readSpan(&n);
+            if (n == 0)
+                break;
+            n = qMin(n, maxSize - total);
+            memcpy(target + total, span, n);
+            consume(n);
+            total += n;
         }
-        char* writePtr = first + len;
-        len += (int)size;
-        return writePtr;
+        return total;
     }
 
-    inline void chop(int size) {
-        if (size >= len) {
-            clear();
-        } else {
-            len -= size;
+    // Consumer side: copies size bytes starting offset bytes after the
+    // oldest unread one, leaving them in the buffer. Returns false if fewer
+    // are available.
+    inline bool peek(char *target, int offset, int size) const {
+        uint h = uint(loadAcquire(head));
+        if (offset + size > int(uint(loadAcquire(tail)) - h))
+            return false;
+        int start = int((h + uint(offset)) & mask);
+        int first = qMin(size, cap - start);
+        memcpy(target, buf + start, first);
+        memcpy(target + first, buf, size - first);
+        return true;
+    }
+
+    // Consumer side: offset of the first c at or after offset from in the
+    // unread bytes, or -1. A memchr() over at most two spans.
+    inline int indexOf(char c, int from = 0) const {
+        uint h = uint(loadAcquire(head));
+        int len = int(uint(loadAcquire(tail)) - h);
+        while (from < len) {
+            int start = int((h + uint(from)) & mask);
+            int n = qMin(len - from, cap - start);
+            const char *found = static_cast<const char *>(memchr(buf + start, c, n));
+            if (found)
+                return from + int(found - (buf + start));
+            from += n;
         }
+        return -1;
+    }
+
+    inline bool canReadLine() const {
+        return indexOf('\n') != -1;
     }
 
-    inline void squeeze() {
-        if (first != buf) {
-            memmove(buf, first, len);
-            first = buf;
+private:
+    Q_DISABLE_COPY(QextRingBuffer)
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    static inline int loadRelaxed(const QAtomicInt &v) { return v.load(); }
+    static inline int loadAcquire(const QAtomicInt &v) { return v.loadAcquire(); }
+    static inline void storeRelease(QAtomicInt &v, int x) { v.storeRelease(x); }
+#else
+    static inline int loadRelaxed(const QAtomicInt &v) { return v; }
+    static inline int loadAcquire(const QAtomicInt &v) { return const_cast<QAtomicInt &>(v).fetchAndAddAcquire(0); }
+    static inline void storeRelease(QAtomicInt &v, int x) { v.fetchAndStoreRelease(x); }
+#endif
+
+    // read-mostly, shared by both sides
+    char *buf;
+    int cap;
+    uint mask;
+    char pad0[CacheLineSize];
+
+    // consumer-owned
+    QAtomicInt head;
+    mutable uint cachedTail;
+    char pad1[CacheLineSize - sizeof(QAtomicInt) - sizeof(uint)];
+
+    // producer-owned
+    QAtomicInt tail;
+    uint cachedHead;
+    char pad2[CacheLineSize - sizeof(QAtomicInt) - sizeof(uint)];
+};
+
+#ifdef Q_OS_LINUX
+// qextserialport_linux.cpp
+bool qextSetCustomBaudRate(int fd, int baudRate);
+int qextActualBaudRate(int fd);
+int qextSetLowLatency(int fd, bool enable);
+bool qextErrorCounters(int fd, qint64 *counts);
+#endif
+
+// qextserialport_unix.cpp / qextserialport_win.cpp
+qint64 qextMonotonicUsecs();
+
+// When a chunk of received bytes was taken from the driver, queued next to
+// the read buffer; end is the readBuffer write position after the chunk.
+struct QextReceiveStamp
+{
+    uint end;
+    uint reserved;
+    qint64 time;
+};
+
+// A value that many threads read while one writer at a time replaces it.
+//
+// The writer publishes a new immutable copy and swaps the pointer; readers
+// take no lock. A reader pins the current epoch by counting itself in that
+// epoch's slot (one atomic increment, and one decrement when it leaves),
+// and only starts over if publish() moved to the next epoch in between.
+//
+// A replaced copy is retired in the epoch in which it was replaced. Only
+// readers pinned in that epoch or the one before can hold it, so publish()
+// moves to the next epoch, freeing what was retired two epochs back, as
+// soon as the readers pinned in the previous epoch have all left. Readers
+// that keep arriving pin the new epoch and do not hold reclamation back.
+template <typename T>
+class QextSnapshot
+{
+public:
+    inline QextSnapshot() : current(new T) {}
+
+    ~QextSnapshot() {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+        delete current.load();
+#else
+        delete (T *)current;
+#endif
+        qDeleteAll(retired[0]);
+        qDeleteAll(retired[1]);
+    }
+
+    // Writer side: callers must serialize publish() among themselves.
+    inline void publish(const T &value) {
+        int e = epoch.fetchAndAddOrdered(0);
+        retired[e & 1].append(current.fetchAndStoreOrdered(new T(value)));
+        // the readers pinned in the previous epoch are gone: what was
+        // retired before it can not be held by anyone, and its slot is
+        // free for the next epoch
+        if (readers[(e + 1) & 1].fetchAndAddOrdered(0) == 0) {
+            qDeleteAll(retired[(e + 1) & 1]);
+            retired[(e + 1) & 1].clear();
+            epoch.fetchAndStoreOrdered(e + 1);
         }
-        size_t newCapacity = basicBlockSize;
-        while (newCapacity < size_t(len))
-            newCapacity *= 2;
-        if (newCapacity < capacity) {
-            char * tmp = static_cast<char*>(realloc(buf, newCapacity));
-            if (tmp) {
-                buf = tmp;
-                capacity = newCapacity;
+    }
+
+    // Reader side, any thread: the copy stays valid while the Reader lives.
+    class Reader
+    {
+    public:
+        inline explicit Reader(const QextSnapshot &snapshot)
+            : s(snapshot) {
+            forever {
+                int e = s.epoch.fetchAndAddOrdered(0);
+                slot = e & 1;
+                s.readers[slot].ref();      // ordered: the loads below can not move above it
+                if (s.epoch.fetchAndAddOrdered(0) == e)
+                    break;
+                s.readers[slot].deref();    // publish() moved on meanwhile
             }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+            value = s.current.loadAcquire();
+#else
+            value = s.current;
+#endif
         }
-    }
+        inline ~Reader() { s.readers[slot].deref(); }
+        inline const T *operator->() const { return value; }
 
-    inline QByteArray readAll() {
-        char* f = first;
-        int l = len;
-        clear();
-        return QByteArray(f, l);
-    }
+    private:
+        Q_DISABLE_COPY(Reader)
+        const QextSnapshot &s;
+        const T *value;
+        int slot;
+    };
+
+private:
+    Q_DISABLE_COPY(QextSnapshot)
+
+    QAtomicPointer<T> current;
+    mutable QAtomicInt epoch;
+    mutable QAtomicInt readers[2];  // readers pinned in the epochs of each parity
+    QList<T *> retired[2];          // copies replaced in the epochs of each parity
+};
 
-    inline int readLine(char* target, int size) {
-        int r = qMin(size, len);
-        char* eol = static_cast<char*>(memchr(first, '\n', r));
-        if (eol)
-            r = 1+(eol-first);
-        memcpy(target, first, r);
-        len -= r;
-        first += r;
-        return int(r);
+// What the getters of QextSerialPort return, published by
+// QextSerialPortPrivate::publishSettings() after every change.
+struct QextSettingsSnapshot
+{
+    QString port;
+    PortSettings Settings;
+    QextSerialPort::QueryMode queryMode;
+    int actualBaudRate;
+    bool lowLatency;
+    int readMinimum;
+    bool receiveStamping;
+    qint64 writeHighWaterMark;
+    QextFraming framing;
+};
+
+// Turns the link counters of a port into a QextLinkStats. The counters are
+// 32-bit and wrap; update() widens them, so it must run at least once per
+// 4 GiB moved. A sample of the totals is kept every SampleInterval for the
+// rates, which are only recomputed then.
+class QextLinkMonitor
+{
+public:
+    enum {
+        SampleInterval = 250000,    // us; also how often the driver is asked
+        Samples = 64                // 16 s of history
+    };
+    enum Counter {
+        BytesIn,
+        BytesOut,
+        ReadCalls,
+        WriteCalls,
+        FramesIn,
+        FramesOut,
+        BadFrames,
+        Counters
+    };
+
+    QextLinkMonitor();
+
+    inline bool isDue(qint64 now) const {
+        return count == 0 || now - samples[(next + Samples - 1) % Samples].time >= SampleInterval;
     }
+    void update(const uint *counters);
+    void sample(qint64 now, const QextLinkStats *errors);
+    void reset(qint64 now, const uint *counters, const QextLinkStats *errors);
 
-    inline bool canReadLine() const {
-        return memchr(first, '\n', len);
+    inline const QextLinkStats &stats() const {
+        return current;
     }
 
 private:
-    int len;
-    char* first;
-    char* buf;
-    size_t capacity;
-    size_t basicBlockSize;
+    struct Sample
+    {
+        qint64 time;
+        qint64 totals[Counters];
+        qint64 errors;
+    };
+
+    QextLinkRate rateSince(const Sample &now, qint64 window) const;
+
+    QextLinkStats current;
+    QextLinkStats errorBase;    // driver counters at the last reset
+    uint seen[Counters];        // counters at the last update()
+    Sample samples[Samples];
+    int count;
+    int next;
 };
 
 class QextWinEventNotifier;
@@ -189,13 +429,36 @@ public:
         DFE_DataBits = 0x0008,
         DFE_Flow = 0x0010,
         DFE_TimeOut = 0x0100,
+        DFE_LowLatency = 0x0200,
         DFE_ALL = 0x0fff,
         DFE_Settings_Mask = 0x00ff //without TimeOut
     };
     mutable QReadWriteLock lock;
+    QextSnapshot<QextSettingsSnapshot> snapshot;
     QString port;
     PortSettings Settings;
-    QextReadBuffer readBuffer;
+    int actualBaudRate;         // as read back from the driver, 0 if unknown
+    bool lowLatency;            // requested
+    bool lowLatencyAccepted;    // as read back from the driver
+    int readMinimum;            // VMIN: bytes a blocking read waits for
+    QextRingBuffer readBuffer;
+    // receive timestamping, see QextSerialPort::setReceiveTimestamping()
+    QAtomicInt receiveStamping;
+    QextRingBuffer stampBuffer; // QextReceiveStamp entries, same producer and consumer as readBuffer
+    mutable QMutex statsLock;
+    QextReceiveStats stats;
+    qint64 lastArrival;         // guarded by statsLock, 0 before the first chunk
+    qint64 lastInterval;        // guarded by statsLock, -1 before the second chunk
+    qint64 writeHighWaterMark;  // most bytes queued for writing, 0 for no limit
+    // link statistics, see QextSerialPort::linkStats(); the counters are
+    // bumped by whichever thread moves the data and read by sampleLink()
+    mutable QAtomicInt linkCounters[QextLinkMonitor::Counters];
+    mutable QextLinkMonitor link;   // guarded by statsLock
+    // framed reads, see QextSerialPort::setFraming()
+    QextFraming framing;
+    mutable uint frameScanEnd;  // readBuffer position up to which no delimiter was found
+    qint64 frameOutPos;         // bytes written of the outgoing frame, see countFramesSent()
+    quint32 frameOutLength;     // its length, once a LengthPrefixed prefix is complete
     int settingsDirtyFlags;
     ulong lastErr;
     QextSerialPort::QueryMode _queryMode;
@@ -204,8 +467,25 @@ public:
 #ifdef Q_OS_UNIX
     int fd;
     QSocketNotifier *readNotifier;
+    // write queue, in the modes with an event loop
+    QSocketNotifier *writeNotifier; // enabled while writeQueue is not empty
+    QList<QByteArray> writeQueue;
+    int writeOffset;            // bytes of writeQueue.first() already written
+    qint64 writeQueued;         // bytes in writeQueue, writeOffset included
+    qint64 writeUnsignalled;    // written at once by write(), not yet in bytesWritten()
+#  ifdef Q_OS_LINUX
+    // QextSerialPort::IoThread (see QextIoThread)
+    int ioEventFd;              // -1 when the port is not drained by the thread
+    QAtomicInt ioNotifyPending; // a wake-up was sent and not yet acknowledged
+    QAtomicInt ioStalled;       // the port is not watched: the buffer was full
+    int ioUringSlot;            // io_uring fixed buffer of readBuffer, -1 for none
+    bool ioUringPosted;         // io_uring: a read is in flight (guarded by the thread)
+#  endif
     struct termios Posix_CommConfig;
     struct termios old_termios;
+#  ifdef Q_OS_LINUX
+    bool customBaudRate;        // not a Bxxx speed: set through termios2
+#  endif
 #elif (defined Q_OS_WIN)
     HANDLE Win_Handle;
     OVERLAPPED overlap;
@@ -217,6 +497,9 @@ public:
     QextWinEventNotifier *winEventNotifier;
 #  endif
     DWORD eventMask;
+    // ClearCommError() flags seen by any call: framing, parity, overrun,
+    // buffer overrun, break
+    mutable QAtomicInt commErrors[5];
     QList<OVERLAPPED*> pendingWrites;
     QReadWriteLock* bytesToWriteLock;
     qint64 _bytesToWrite;
@@ -229,7 +512,10 @@ public:
     void setStopBits(StopBitsType stopbits, bool update=true);
     void setFlowControl(FlowType flow, bool update=true);
     void setTimeout(long millisec, bool update=true);
+    void setLowLatency(bool enable, bool update=true);
+    void setReadMinimum(int bytes, bool update=true);
     void setPortSettings(const PortSettings& settings, bool update=true);
+    void publishSettings();
 
     void platformSpecificDestruct();
     void platformSpecificInit();
@@ -238,6 +524,17 @@ public:
 
     qint64 readData_sys(char * data, qint64 maxSize);
     qint64 writeData_sys(const char * data, qint64 maxSize);
+    qint64 writev_sys(const QextWriteBuffer *buffers, int count);
+    qint64 bytesToWrite_sys() const;
+    bool waitForReadyRead_sys(int msecs);
+    bool waitForBytesWritten_sys(int msecs);
+#ifdef Q_OS_UNIX
+    qint64 writevNow(const QextWriteBuffer *buffers, int count);
+    qint64 queueWrite(const QextWriteBuffer *buffers, int count);
+    qint64 drainWriteQueue();
+    qint64 takeUnsignalled();
+    void emitUnsignalled();
+#endif
     void setDtr_sys(bool set=true);
     void setRts_sys(bool set=true);
     bool open_sys(QIODevice::OpenMode mode);
@@ -245,11 +542,36 @@ public:
     bool flush_sys();
     ulong lineStatus_sys();
     qint64 bytesAvailable_sys() const;
+    bool errorCounters_sys(QextLinkStats *stats) const;
+    qint64 fillReadBuffer(bool wait);
+    qint64 readAhead(qint64 wanted);
+    qint64 receiveTime();
+    void stampReceived(qint64 time, int bytes);
+    void consumeStamps();
+    inline void countReceived(qint64 bytes) {
+        linkCounters[QextLinkMonitor::BytesIn].fetchAndAddRelaxed(int(bytes));
+        linkCounters[QextLinkMonitor::ReadCalls].fetchAndAddRelaxed(1);
+    }
+    inline void countSent(qint64 bytes) {
+        linkCounters[QextLinkMonitor::BytesOut].fetchAndAddRelaxed(int(bytes));
+        linkCounters[QextLinkMonitor::WriteCalls].fetchAndAddRelaxed(1);
+    }
+    inline void countFrameIn() {
+        linkCounters[QextLinkMonitor::FramesIn].fetchAndAddRelaxed(1);
+    }
+    void countFramesSent(const QextWriteBuffer *buffers, int count, qint64 bytes);
+    inline void countBadFrame() {
+        linkCounters[QextLinkMonitor::BadFrames].fetchAndAddRelaxed(1);
+    }
+    void sampleLink(bool reset, bool poll) const;
+    int findFrame(const QextFraming &framing, int *start) const;
+    bool takeFrame(QByteArray *frame);
 
 #ifdef Q_OS_WIN
     void _q_onWinEvent(HANDLE h);
 #endif
     void _q_canRead();
+    void _q_canWrite();
 
     QextSerialPort * q_ptr;
 };
@@ -38,14 +38,33 @@
 #include <sys/time.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <time.h>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QReadLocker>
+#include <QtCore/QWriteLocker>
 #include <QtCore/QDebug>
 #include <QtCore/QSocketNotifier>
+#ifdef Q_OS_LINUX
+#  include <sys/eventfd.h>
+#  include "qextiothread_p.h"
+#endif
 
 void QextSerialPortPrivate::platformSpecificInit()
 {
     fd = 0;
     readNotifier = 0;
+    writeNotifier = 0;
+    writeOffset = 0;
+    writeQueued = 0;
+    writeUnsignalled = 0;
+#ifdef Q_OS_LINUX
+    ioEventFd = -1;
+    ioUringSlot = -1;
+    ioUringPosted = false;
+    customBaudRate = false;
+#endif
 }
 
 /*!
@@ -55,6 +74,18 @@ void QextSerialPortPrivate::platformSpecificDestruct()
 {
 }
 
+qint64 qextMonotonicUsecs()
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (::clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+    struct timeval tv;
+    ::gettimeofday(&tv, 0);
+    return qint64(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
 static QString fullPortName(const QString &name)
 {
     if (name.startsWith(QLatin1Char('/')))
@@ -93,7 +124,27 @@ bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
         settingsDirtyFlags = DFE_ALL;
         updatePortSettings();
 
-        if (_queryMode == QextSerialPort::EventDriven) {
+        if (_queryMode != QextSerialPort::Polling) {
+            writeNotifier = new QSocketNotifier(fd, QSocketNotifier::Write, q);
+            writeNotifier->setEnabled(false);
+            q->connect(writeNotifier, SIGNAL(activated(int)), q, SLOT(_q_canWrite()));
+        }
+#ifdef Q_OS_LINUX
+        if (_queryMode == QextSerialPort::IoThread) {
+            ioEventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (ioEventFd != -1 && QextIoThread::instance()->addPort(this)) {
+                readNotifier = new QSocketNotifier(ioEventFd, QSocketNotifier::Read, q);
+                q->connect(readNotifier, SIGNAL(activated(int)), q, SLOT(_q_canRead()));
+                return true;
+            }
+            // no I/O thread: fall back to the notifier on the owning thread
+            if (ioEventFd != -1) {
+                ::close(ioEventFd);
+                ioEventFd = -1;
+            }
+        }
+#endif
+        if (_queryMode != QextSerialPort::Polling) {
             readNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, q);
             q->connect(readNotifier, SIGNAL(activated(int)), q, SLOT(_q_canRead()));
         }
@@ -106,6 +157,16 @@ bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
 
 bool QextSerialPortPrivate::close_sys()
 {
+#ifdef Q_OS_LINUX
+    if (ioEventFd != -1) {
+        QextIoThread::instance()->removePort(this);
+        ::close(ioEventFd);
+        ioEventFd = -1;
+        ioNotifyPending.fetchAndStoreOrdered(0);
+        ioStalled.fetchAndStoreOrdered(0);
+    }
+#endif
+    lowLatencyAccepted = false;
     // Force a flush and then restore the original termios
     flush_sys();
     // Using both TCSAFLUSH and TCSANOW here discards any pending input
@@ -115,13 +176,87 @@ bool QextSerialPortPrivate::close_sys()
         delete readNotifier;
         readNotifier = 0;
     }
+    delete writeNotifier;
+    writeNotifier = 0;
+    writeQueue.clear();
+    writeOffset = 0;
+    writeQueued = 0;
+    writeUnsignalled = 0;
     return true;
 }
 
+/*
+    Longest time flush_sys() waits for the driver to take or transmit
+    anything before it gives up on a wedged device (lost CTS, for one).
+*/
+static const int FlushStallMsecs = 2000;
+
+#ifdef TIOCOUTQ
+/*
+    Waits until the driver has transmitted what was written to \a fd,
+    sleeping about as long as the line needs at \a rate, 10 bits a byte.
+    Gives up at \a deadline (from qextMonotonicUsecs(), -1 for none) or when
+    the output queue stays the same for \a stallMsecs (-1 for no limit).
+    Returns 1 once the queue is empty, 0 on a timeout or a stall, and -1 if
+    the queue cannot be read.
+*/
+static int waitOutputDrained(int fd, int rate, qint64 deadline, int stallMsecs)
+{
+    int last = -1;
+    qint64 stalledSince = 0;
+    forever {
+        int pending = 0;
+        if (::ioctl(fd, TIOCOUTQ, &pending) == -1)
+            return -1;
+        if (pending == 0)
+            return 1;
+        qint64 now = qextMonotonicUsecs();
+        if (pending != last) {
+            last = pending;
+            stalledSince = now;
+        } else if (stallMsecs >= 0 && now - stalledSince >= qint64(stallMsecs) * 1000) {
+            return 0;
+        }
+        qint64 left = (deadline == -1) ? qint64(10000) : qMin(deadline - now, qint64(10000));
+        if (left <= 0)
+            return 0;
+        qint64 needed = qint64(pending) * 10 * 1000000 / qMax(rate, 1);
+        ::usleep(useconds_t(qBound(qint64(100), needed, left)));
+    }
+}
+#endif
+
+/*
+    Writes out the write queue, waiting for the driver to take it, then
+    waits until it has been transmitted. Returns false if the device makes
+    no progress for FlushStallMsecs.
+*/
 bool QextSerialPortPrivate::flush_sys()
 {
+    while (!writeQueue.isEmpty()) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        int ret = ::poll(&pfd, 1, FlushStallMsecs);
+        if (ret == -1 && errno != EINTR)
+            break;
+        if (ret == 0) {
+            lastErr = E_WRITE_FAILED;
+            return false;
+        }
+        drainWriteQueue();
+    }
+#ifdef TIOCOUTQ
+    int rate = actualBaudRate > 0 ? actualBaudRate : int(Settings.BaudRate);
+    if (waitOutputDrained(fd, rate, -1, FlushStallMsecs) == 0) {
+        lastErr = E_WRITE_FAILED;
+        return false;
+    }
+    return true;
+#else
     ::tcdrain(fd);
     return true;
+#endif
 }
 
 qint64 QextSerialPortPrivate::bytesAvailable_sys() const
@@ -133,6 +268,25 @@ qint64 QextSerialPortPrivate::bytesAvailable_sys() const
     return bytesQueued;
 }
 
+bool QextSerialPortPrivate::errorCounters_sys(QextLinkStats *stats) const
+{
+#ifdef Q_OS_LINUX
+    qint64 counts[5];
+    if (!qextErrorCounters(fd, counts))
+        return false;
+    stats->hasErrorCounters = true;
+    stats->framingErrors = counts[0];
+    stats->parityErrors = counts[1];
+    stats->overruns = counts[2];
+    stats->bufferOverruns = counts[3];
+    stats->breaks = counts[4];
+    return true;
+#else
+    Q_UNUSED(stats);
+    return false;
+#endif
+}
+
 /*!
     Translates a system-specific error code to a QextSerialPort error code.  Used internally.
 */
@@ -158,6 +312,299 @@ void QextSerialPortPrivate::translateError(ulong error)
     }
 }
 
+qint64 QextSerialPortPrivate::writev_sys(const QextWriteBuffer *buffers, int count)
+{
+    if (writeNotifier)
+        return queueWrite(buffers, count);
+    return writevNow(buffers, count);
+}
+
+/*
+    Writes as much of the buffers as the driver takes now.
+*/
+qint64 QextSerialPortPrivate::writevNow(const QextWriteBuffer *buffers, int count)
+{
+    enum { MaxIoVecs = 64 };
+    struct iovec iov[MaxIoVecs];
+    qint64 total = 0;
+    int first = 0;
+    qint64 offset = 0; // already written from buffers[first]
+
+    while (first < count) {
+        int n = 0;
+        for (int i = first; i < count && n < MaxIoVecs; ++i, ++n) {
+            qint64 skip = (i == first) ? offset : 0;
+            iov[n].iov_base = const_cast<char *>(buffers[i].data) + skip;
+            iov[n].iov_len = size_t(buffers[i].size - skip);
+        }
+
+        ssize_t written = ::writev(fd, iov, n);
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            lastErr = E_WRITE_FAILED;
+            return total > 0 ? total : -1;
+        }
+        total += written;
+
+        // skip what was written, the partly written buffer is resumed
+        offset += written;
+        while (first < count && offset >= buffers[first].size) {
+            offset -= buffers[first].size;
+            ++first;
+        }
+        if (written == 0)
+            break;
+    }
+    return total;
+}
+
+/*
+    Writes what the driver takes now and queues the rest, up to the high-water
+    mark, for _q_canWrite(). Returns the number of bytes written or queued.
+*/
+qint64 QextSerialPortPrivate::queueWrite(const QextWriteBuffer *buffers, int count)
+{
+    qint64 accepted = 0;
+    // anything queued must go first
+    if (writeQueue.isEmpty()) {
+        accepted = writevNow(buffers, count);
+        if (accepted == -1)
+            return -1;
+        // reported by bytesWritten() from _q_canWrite(), not from inside
+        // the caller's write()
+        writeUnsignalled += accepted;
+    }
+
+    qint64 skip = accepted;
+    for (int i = 0; i < count; ++i) {
+        if (skip >= buffers[i].size) {
+            skip -= buffers[i].size;
+            continue;
+        }
+        qint64 size = buffers[i].size - skip;
+        if (writeHighWaterMark > 0)
+            size = qMin(size, writeHighWaterMark - (writeQueued - writeOffset));
+        if (size <= 0)
+            break;
+        writeQueue.append(QByteArray(buffers[i].data + skip, int(size)));
+        writeQueued += size;
+        accepted += size;
+        skip = 0;
+    }
+
+    if (!writeQueue.isEmpty() || writeUnsignalled > 0)
+        writeNotifier->setEnabled(true);
+    return accepted;
+}
+
+/*
+    Writes as much of the write queue as the driver takes now. Returns the
+    number of bytes written.
+*/
+qint64 QextSerialPortPrivate::drainWriteQueue()
+{
+    enum { MaxBuffers = 64 };
+    qint64 total = 0;
+    while (!writeQueue.isEmpty()) {
+        QextWriteBuffer views[MaxBuffers];
+        int count = qMin(writeQueue.size(), int(MaxBuffers));
+        qint64 requested = 0;
+        for (int i = 0; i < count; ++i) {
+            int skip = (i == 0) ? writeOffset : 0;
+            views[i].data = writeQueue.at(i).constData() + skip;
+            views[i].size = writeQueue.at(i).size() - skip;
+            requested += views[i].size;
+        }
+
+        qint64 written = writevNow(views, count);
+        if (written == -1) {
+            // the device is gone: what is queued can never be written
+            QESP_WARNING()<<"QextSerialPort: write failed, discarding"
+                          <<(writeQueued - writeOffset)<<"queued bytes";
+            writeQueue.clear();
+            writeOffset = 0;
+            writeQueued = 0;
+            break;
+        }
+        total += written;
+
+        written += writeOffset;
+        while (!writeQueue.isEmpty() && written >= writeQueue.first().size()) {
+            written -= writeQueue.first().size();
+            writeQueued -= writeQueue.first().size();
+            writeQueue.removeFirst();
+        }
+        writeOffset = int(written);
+
+        if (written < requested)
+            break;  // the driver is full
+    }
+
+    if (writeNotifier)
+        writeNotifier->setEnabled(!writeQueue.isEmpty() || writeUnsignalled > 0);
+    return total;
+}
+
+/*
+    The driver has room again: writes out the queue.
+*/
+void QextSerialPortPrivate::_q_canWrite()
+{
+    Q_Q(QextSerialPort);
+    qint64 written;
+    {
+        QWriteLocker locker(&lock);
+        written = takeUnsignalled();
+        written += drainWriteQueue();
+    }
+    if (written > 0)
+        Q_EMIT q->bytesWritten(written);
+}
+
+qint64 QextSerialPortPrivate::bytesToWrite_sys() const
+{
+    return writeQueued - writeOffset;
+}
+
+/*
+    Milliseconds to pass to poll() until \a deadline (from
+    qextMonotonicUsecs(), -1 for none).
+*/
+static int pollTimeout(qint64 deadline)
+{
+    if (deadline == -1)
+        return -1;
+    qint64 left = deadline - qextMonotonicUsecs();
+    return left > 0 ? int((left + 999) / 1000) : 0;
+}
+
+bool QextSerialPortPrivate::waitForReadyRead_sys(int msecs)
+{
+    qint64 deadline = (msecs < 0) ? -1 : qextMonotonicUsecs() + qint64(msecs) * 1000;
+    forever {
+        if (!readBuffer.isEmpty())
+            return true;
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+#ifdef Q_OS_LINUX
+        // the I/O thread reads the port and signals its eventfd
+        if (ioEventFd != -1)
+            pfd.fd = ioEventFd;
+#endif
+        pfd.events = POLLIN;
+        int ret = ::poll(&pfd, 1, pollTimeout(deadline));
+        if (ret == -1) {
+            if (errno != EINTR) {
+                lastErr = E_READ_FAILED;
+                return false;
+            }
+        } else if (ret == 0) {
+            return false;
+        } else if (!(pfd.revents & POLLIN)) {
+            // hang-up or error without data
+            lastErr = E_READ_FAILED;
+            return false;
+        } else if (_queryMode == QextSerialPort::Polling) {
+            return true;
+        } else {
+            _q_canRead();
+        }
+        // EINTR, or a wake-up for bytes that were consumed already
+        if (deadline != -1 && qextMonotonicUsecs() >= deadline)
+            return !readBuffer.isEmpty();
+    }
+}
+
+bool QextSerialPortPrivate::waitForBytesWritten_sys(int msecs)
+{
+    Q_Q(QextSerialPort);
+    qint64 deadline = (msecs < 0) ? -1 : qextMonotonicUsecs() + qint64(msecs) * 1000;
+    bool queued;
+    {
+        QReadLocker locker(&lock);
+        queued = !writeQueue.isEmpty();
+    }
+
+    while (queued) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        int ret = ::poll(&pfd, 1, pollTimeout(deadline));
+        if (ret == -1 && errno != EINTR) {
+            lastErr = E_WRITE_FAILED;
+            return false;
+        }
+        if (ret == 0)
+            return false;
+
+        qint64 written = 0;
+        if (ret > 0) {
+            QWriteLocker locker(&lock);
+            written = drainWriteQueue();
+            queued = !writeQueue.isEmpty();
+            if (written > 0)
+                written += takeUnsignalled();
+        }
+        if (written > 0) {
+            Q_EMIT q->bytesWritten(written);
+            return true;
+        }
+        if (deadline != -1 && qextMonotonicUsecs() >= deadline)
+            return false;
+    }
+
+    // nothing queued: wait for the driver to send what it has
+    if (deadline == -1) {
+        ::tcdrain(fd);
+        emitUnsignalled();
+        return true;
+    }
+#ifdef TIOCOUTQ
+    int rate = actualBaudRate > 0 ? actualBaudRate : int(Settings.BaudRate);
+    if (waitOutputDrained(fd, rate, deadline, -1) != 1)
+        return false;
+    emitUnsignalled();
+    return true;
+#else
+    ::tcdrain(fd);
+    emitUnsignalled();
+    return true;
+#endif
+}
+
+/*
+    Takes the bytes write() wrote at once and bytesWritten() has not
+    reported yet. Must be called with the write lock held.
+*/
+qint64 QextSerialPortPrivate::takeUnsignalled()
+{
+    qint64 bytes = writeUnsignalled;
+    writeUnsignalled = 0;
+    if (writeNotifier)
+        writeNotifier->setEnabled(!writeQueue.isEmpty());
+    return bytes;
+}
+
+/*
+    Reports with bytesWritten() the bytes write() wrote at once, once they
+    have been transmitted.
+*/
+void QextSerialPortPrivate::emitUnsignalled()
+{
+    Q_Q(QextSerialPort);
+    qint64 bytes;
+    {
+        QWriteLocker locker(&lock);
+        bytes = takeUnsignalled();
+    }
+    if (bytes > 0)
+        Q_EMIT q->bytesWritten(bytes);
+}
+
 void QextSerialPortPrivate::setDtr_sys(bool set)
 {
     int status;
@@ -205,6 +652,15 @@ unsigned long QextSerialPortPrivate::lineStatus_sys()
 */
 qint64 QextSerialPortPrivate::readData_sys(char * data, qint64 maxSize)
 {
+    // with VMIN set, VTIME only starts after the first byte: the timeout is
+    // applied to that one here
+    if (Posix_CommConfig.c_cc[VMIN] > 0 && Settings.Timeout_Millisec > 0) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (::poll(&pfd, 1, Settings.Timeout_Millisec) <= 0)
+            return 0;
+    }
     int retVal = ::read(fd, data, maxSize);
     if (retVal == -1)
         lastErr = E_READ_FAILED;
@@ -222,6 +678,10 @@ qint64 QextSerialPortPrivate::readData_sys(char * data, qint64 maxSize)
 */
 qint64 QextSerialPortPrivate::writeData_sys(const char * data, qint64 maxSize)
 {
+    if (writeNotifier) {
+        QextWriteBuffer buffer = { data, maxSize };
+        return queueWrite(&buffer, 1);
+    }
     int retVal = ::write(fd, data, maxSize);
     if (retVal == -1)
         lastErr = E_WRITE_FAILED;
@@ -249,6 +709,9 @@ void QextSerialPortPrivate::updatePortSettings()
         return;
 
     if (settingsDirtyFlags & DFE_BaudRate) {
+#ifdef Q_OS_LINUX
+        customBaudRate = false;
+#endif
         switch (Settings.BaudRate) {
         case BAUD50:
             setBaudRate2Termios(&Posix_CommConfig, B50);
@@ -346,6 +809,12 @@ void QextSerialPortPrivate::updatePortSettings()
         case BAUD4000000:
             setBaudRate2Termios(&Posix_CommConfig, B4000000);
             break;
+#endif
+#ifdef Q_OS_LINUX
+        default:
+            // applied below, after the other settings
+            customBaudRate = true;
+            break;
 #endif
         }
     }
@@ -438,7 +907,8 @@ void QextSerialPortPrivate::updatePortSettings()
 
     if (settingsDirtyFlags & DFE_TimeOut) {
         int millisec = Settings.Timeout_Millisec;
-        if (millisec == -1) {
+        // the I/O thread must never block on one port
+        if (millisec == -1 || _queryMode == QextSerialPort::IoThread) {
             ::fcntl(fd, F_SETFL, O_NDELAY);
         }
         else {
@@ -447,9 +917,36 @@ void QextSerialPortPrivate::updatePortSettings()
             ::fcntl(fd, F_SETFL, O_SYNC);
         }
         ::tcgetattr(fd, & Posix_CommConfig);
-        Posix_CommConfig.c_cc[VTIME] = millisec/100;
+        // frame-sized reads: VTIME becomes the gap that ends a short frame
+        Posix_CommConfig.c_cc[VMIN] = readMinimum;
+        Posix_CommConfig.c_cc[VTIME] = readMinimum > 0 ? 1 : millisec/100;
         ::tcsetattr(fd, TCSAFLUSH, & Posix_CommConfig);
+        // keep what the driver accepted
+        ::tcgetattr(fd, & Posix_CommConfig);
+    }
+
+    if (settingsDirtyFlags & DFE_LowLatency) {
+#ifdef Q_OS_LINUX
+        // leave the driver alone unless asked (setserial may have set it)
+        if (lowLatency || lowLatencyAccepted)
+            lowLatencyAccepted = (qextSetLowLatency(fd, lowLatency) == 1);
+#else
+        lowLatencyAccepted = false;
+#endif
     }
 
+#ifdef Q_OS_LINUX
+    // tcsetattr() above only knows the Bxxx speeds and may have reset a
+    // custom one
+    if (customBaudRate && !qextSetCustomBaudRate(fd, Settings.BaudRate))
+        QESP_WARNING()<<"QextSerialPort: driver refused baudRate:"<<Settings.BaudRate;
+    if (settingsDirtyFlags & DFE_BaudRate) {
+        actualBaudRate = qextActualBaudRate(fd);
+        // the two ends of a link tolerate about 2% of difference
+        if (actualBaudRate > 0 && qAbs(actualBaudRate - int(Settings.BaudRate)) * 50 > int(Settings.BaudRate))
+            QESP_WARNING()<<"QextSerialPort: baudRate"<<Settings.BaudRate<<"applied as"<<actualBaudRate;
+    }
+#endif
+
     settingsDirtyFlags = 0;
 }
@@ -47,6 +47,17 @@
 #  include "qextwineventnotifier_p.h"
 #  define WinEventNotifier QextWinEventNotifier
 #endif
+qint64 qextMonotonicUsecs()
+{
+    static LARGE_INTEGER frequency = { { 0, 0 } };
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return qint64(counter.QuadPart / frequency.QuadPart) * 1000000
+            + qint64(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
 void QextSerialPortPrivate::platformSpecificInit()
 {
     Win_Handle=INVALID_HANDLE_VALUE;
@@ -156,11 +167,30 @@ qint64 QextSerialPortPrivate::bytesAvailable_sys() const
     DWORD Errors;
     COMSTAT Status;
     if (ClearCommError(Win_Handle, &Errors, &Status)) {
+        // the flags are cleared by the call: keep them for linkStats()
+        static const DWORD kinds[5] = { CE_FRAME, CE_RXPARITY, CE_OVERRUN, CE_RXOVER, CE_BREAK };
+        for (int i = 0; i < 5; ++i) {
+            if (Errors & kinds[i])
+                commErrors[i].fetchAndAddRelaxed(1);
+        }
         return Status.cbInQue;
     }
     return (qint64)-1;
 }
 
+bool QextSerialPortPrivate::errorCounters_sys(QextLinkStats *stats) const
+{
+    if (bytesAvailable_sys() == -1)
+        return false;
+    stats->hasErrorCounters = true;
+    stats->framingErrors = commErrors[0].fetchAndAddRelaxed(0);
+    stats->parityErrors = commErrors[1].fetchAndAddRelaxed(0);
+    stats->overruns = commErrors[2].fetchAndAddRelaxed(0);
+    stats->bufferOverruns = commErrors[3].fetchAndAddRelaxed(0);
+    stats->breaks = commErrors[4].fetchAndAddRelaxed(0);
+    return true;
+}
+
 /*
     Translates a system-specific error code to a QextSerialPort error code.  Used internally.
 */
@@ -236,6 +266,12 @@ qint64 QextSerialPortPrivate::writeData_sys(const char *data, qint64 maxSize)
     DWORD bytesWritten = 0;
     bool failed = false;
     if (_queryMode == QextSerialPort::EventDriven) {
+        if (writeHighWaterMark > 0) {
+            QReadLocker readlocker(bytesToWriteLock);
+            maxSize = qMin(maxSize, writeHighWaterMark - _bytesToWrite);
+            if (maxSize <= 0)
+                return 0;
+        }
         OVERLAPPED* newOverlapWrite = new OVERLAPPED;
         ZeroMemory(newOverlapWrite, sizeof(OVERLAPPED));
         newOverlapWrite->hEvent = CreateEvent(NULL, true, false, NULL);
@@ -269,6 +305,24 @@ qint64 QextSerialPortPrivate::writeData_sys(const char *data, qint64 maxSize)
     return -1;
 }
 
+/*
+    No gathering write for serial handles: the buffers are written one by
+    one, stopping at the first one that is not taken completely.
+*/
+qint64 QextSerialPortPrivate::writev_sys(const QextWriteBuffer *buffers, int count)
+{
+    qint64 total = 0;
+    for (int i = 0; i < count; ++i) {
+        qint64 written = writeData_sys(buffers[i].data, buffers[i].size);
+        if (written == -1)
+            return total > 0 ? total : -1;
+        total += written;
+        if (written < buffers[i].size)
+            break;
+    }
+    return total;
+}
+
 void QextSerialPortPrivate::setDtr_sys(bool set) {
     EscapeCommFunction(Win_Handle, set ? SETDTR : CLRDTR);
 }
@@ -287,6 +341,79 @@ ulong QextSerialPortPrivate::lineStatus_sys(void) {
     return Status;
 }
 
+qint64 QextSerialPortPrivate::bytesToWrite_sys() const
+{
+    QReadLocker readlocker(bytesToWriteLock);
+    return _bytesToWrite;
+}
+
+/*
+    In EventDriven mode waits on the comm event, handling it as the notifier
+    would. Other modes have no event to wait on and check the driver every
+    millisecond.
+*/
+bool QextSerialPortPrivate::waitForReadyRead_sys(int msecs)
+{
+    qint64 deadline = (msecs < 0) ? -1 : qextMonotonicUsecs() + qint64(msecs) * 1000;
+    forever {
+        if (!readBuffer.isEmpty())
+            return true;
+        if (_queryMode != QextSerialPort::EventDriven) {
+            qint64 bytes = bytesAvailable_sys();
+            if (bytes != 0)
+                return bytes > 0;
+        }
+
+        DWORD wait = INFINITE;
+        if (deadline != -1)
+            wait = DWORD(qMax(qint64(0), (deadline - qextMonotonicUsecs() + 999) / 1000));
+        if (_queryMode == QextSerialPort::EventDriven) {
+            if (WaitForSingleObject(overlap.hEvent, wait) != WAIT_OBJECT_0)
+                return false;
+            _q_onWinEvent(overlap.hEvent);
+        } else {
+            if (wait == 0)
+                return false;
+            Sleep(1);
+        }
+    }
+}
+
+/*
+    Waits for the oldest pending overlapped write; with none, flushes.
+*/
+bool QextSerialPortPrivate::waitForBytesWritten_sys(int msecs)
+{
+    Q_Q(QextSerialPort);
+    if (pendingWrites.isEmpty())
+        return flush_sys();
+
+    OVERLAPPED *o = pendingWrites.first();
+    if (WaitForSingleObject(o->hEvent, msecs < 0 ? INFINITE : DWORD(msecs)) != WAIT_OBJECT_0)
+        return false;
+    DWORD numBytes = 0;
+    bool ok = GetOverlappedResult(Win_Handle, o, &numBytes, false);
+    pendingWrites.removeFirst();
+    CloseHandle(o->hEvent);
+    delete o;
+    {
+        QWriteLocker writelocker(bytesToWriteLock);
+        _bytesToWrite = qMax(qint64(0), _bytesToWrite - qint64(numBytes));
+    }
+    if (!ok || numBytes == 0)
+        return false;
+    Q_EMIT q->bytesWritten(numBytes);
+    return true;
+}
+
+/*
+  Overlapped writes complete in _q_onWinEvent(); there is no write queue to
+  drain here.
+*/
+void QextSerialPortPrivate::_q_canWrite()
+{
+}
+
 /*
   Triggered when there's activity on our HANDLE.
 */
@@ -0,0 +1,4 @@
+TARGET = tst_qextframing
+include(../../src/qextserialport.pri)
+SOURCES  += tst_qextframing.cpp
+QT = core testlib
@@ -0,0 +1,221 @@
+#include "qextserialport.h"
+#include <QtTest/QtTest>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+Q_DECLARE_METATYPE(QextSerialPort::QueryMode)
+Q_DECLARE_METATYPE(QextFraming)
+#if QT_VERSION < 0x050000
+Q_DECLARE_METATYPE(QList<QByteArray>)
+#endif
+
+class tst_QextFraming : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void frames_data();
+    void frames();
+    void partialFrame();
+    void dropsBadFrames_data();
+    void dropsBadFrames();
+    void frameReady_data();
+    void frameReady();
+    void invalidFraming();
+
+private:
+    void send(const QByteArray &data);
+    static QList<QByteArray> readFrames(QextSerialPort &port);
+
+    int master;
+    QString slaveName;
+};
+
+void tst_QextFraming::init()
+{
+    master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    QVERIFY(master != -1);
+    QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+    slaveName = QString::fromLatin1(::ptsname(master));
+}
+
+void tst_QextFraming::cleanup()
+{
+    ::close(master);
+}
+
+/*
+  Writes to the master side and gives the pty time to pass it on.
+*/
+void tst_QextFraming::send(const QByteArray &data)
+{
+    QCOMPARE(::write(master, data.constData(), data.size()), ssize_t(data.size()));
+    QTest::qSleep(20);
+}
+
+QList<QByteArray> tst_QextFraming::readFrames(QextSerialPort &port)
+{
+    QList<QByteArray> frames;
+    QByteArray frame;
+    while (!(frame = port.readFrame()).isEmpty())
+        frames.append(frame);
+    return frames;
+}
+
+void tst_QextFraming::frames_data()
+{
+    QTest::addColumn<QextFraming>("framing");
+    QTest::addColumn<QByteArray>("wire");
+    QTest::addColumn<QList<QByteArray> >("expected");
+
+    QList<QByteArray> abc;
+    abc << QByteArray("ab") << QByteArray("cd") << QByteArray("ef");
+    QTest::newRow("fixed size") << QextFraming::fixedSize(2) << QByteArray("abcdefg") << abc;
+
+    QList<QByteArray> two;
+    two << QByteArray("abc") << QByteArray("de");
+    QTest::newRow("1-byte length")
+            << QextFraming::lengthPrefixed(1) << QByteArray("\x03" "abc" "\x00" "\x02" "de", 8) << two;
+    QTest::newRow("2-byte length, little endian")
+            << QextFraming::lengthPrefixed(2) << QByteArray("\x03\x00" "abc" "\x02\x00" "de", 9) << two;
+    QTest::newRow("4-byte length, big endian")
+            << QextFraming::lengthPrefixed(4, true) << QByteArray("\0\0\0\x03" "abc" "\0\0\0\x02" "de", 13) << two;
+
+    QTest::newRow("delimited") << QextFraming::delimited(';') << QByteArray(";;abc;de;f") << two;
+
+    QList<QByteArray> escaped;
+    escaped << QByteArray("a\xc0" "b", 3) << QByteArray("\xdb", 1);
+    QTest::newRow("SLIP")
+            << QextFraming::slip() << QByteArray("\xc0" "a\xdb\xdc" "b\xc0\xc0\xdb\xdd\xc0", 10) << escaped;
+
+    QList<QByteArray> zeros;
+    zeros << QByteArray("\x11\x22\x00\x33", 4) << QByteArray("\x00", 1);
+    QTest::newRow("COBS")
+            << QextFraming::cobs() << QByteArray("\x03\x11\x22\x02\x33\x00\x01\x01\x00", 9) << zeros;
+}
+
+void tst_QextFraming::frames()
+{
+    QFETCH(QextFraming, framing);
+    QFETCH(QByteArray, wire);
+    QFETCH(QList<QByteArray>, expected);
+
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    port.setFraming(framing);
+    QCOMPARE(port.framing().mode, framing.mode);
+
+    send(wire);
+    QCOMPARE(readFrames(port), expected);
+    QCOMPARE(port.linkStats().badFrames, qint64(0));
+}
+
+/*
+  A frame that arrives in pieces is only returned once complete.
+*/
+void tst_QextFraming::partialFrame()
+{
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    port.setFraming(QextFraming::delimited('\n'));
+
+    send("hel");
+    QVERIFY(port.readFrame().isEmpty());
+    QVERIFY(!port.canReadFrame());
+    send("lo");
+    QVERIFY(port.readFrame().isEmpty());
+    send("\nwor");
+    QVERIFY(port.canReadFrame());
+    QCOMPARE(port.readFrame(), QByteArray("hello"));
+    QVERIFY(port.readFrame().isEmpty());
+    send("ld\n");
+    QCOMPARE(port.readFrame(), QByteArray("world"));
+}
+
+void tst_QextFraming::dropsBadFrames_data()
+{
+    QTest::addColumn<QextFraming>("framing");
+    QTest::addColumn<QByteArray>("wire");
+    QTest::addColumn<QByteArray>("expected");
+    QTest::addColumn<int>("dropped");
+
+    QextFraming delimited = QextFraming::delimited('\n');
+    delimited.maxSize = 4;
+    QTest::newRow("too long, delimited") << delimited << QByteArray("toolong\nok\n") << QByteArray("ok") << 1;
+    QTest::newRow("no delimiter in time") << delimited << QByteArray("xxxxxxxxxx") << QByteArray() << 1;
+
+    QextFraming prefixed = QextFraming::lengthPrefixed(1);
+    prefixed.maxSize = 4;
+    // the length 9 is skipped, then 2 "ok" is a frame
+    QTest::newRow("too long, length prefixed") << prefixed << QByteArray("\x09\x02ok", 4) << QByteArray("ok") << 1;
+
+    QTest::newRow("bad SLIP escape")
+            << QextFraming::slip() << QByteArray("a\xdb" "b\xc0ok\xc0", 7) << QByteArray("ok") << 1;
+    QTest::newRow("bad COBS code")
+            << QextFraming::cobs() << QByteArray("\x05\x11\x00\x03ok\x00", 7) << QByteArray("ok") << 1;
+}
+
+void tst_QextFraming::dropsBadFrames()
+{
+    QFETCH(QextFraming, framing);
+    QFETCH(QByteArray, wire);
+    QFETCH(QByteArray, expected);
+    QFETCH(int, dropped);
+
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    port.setFraming(framing);
+
+    send(wire);
+    QCOMPARE(port.readFrame(), expected);
+    QVERIFY(port.readFrame().isEmpty());
+    QCOMPARE(port.linkStats().badFrames, qint64(dropped));
+}
+
+void tst_QextFraming::frameReady_data()
+{
+    QTest::addColumn<QextSerialPort::QueryMode>("mode");
+    QTest::newRow("EventDriven") << QextSerialPort::EventDriven;
+    QTest::newRow("IoThread") << QextSerialPort::IoThread;
+}
+
+/*
+  frameReady() only comes once a whole frame is there.
+*/
+void tst_QextFraming::frameReady()
+{
+    QFETCH(QextSerialPort::QueryMode, mode);
+    QextSerialPort port(slaveName, mode);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    port.setFraming(QextFraming::lengthPrefixed(2, true));
+    QSignalSpy readySpy(&port, SIGNAL(readyRead()));
+    QSignalSpy frameSpy(&port, SIGNAL(frameReady()));
+
+    send(QByteArray("\x00\x04pi", 4));
+    QVERIFY(port.waitForReadyRead(1000));
+    QVERIFY(readySpy.count() > 0);
+    QCOMPARE(frameSpy.count(), 0);
+
+    send("ng");
+    QVERIFY(port.waitForReadyRead(1000));
+    QCOMPARE(frameSpy.count(), 1);
+    QCOMPARE(port.readFrame(), QByteArray("ping"));
+    QVERIFY(!port.canReadFrame());
+}
+
+void tst_QextFraming::invalidFraming()
+{
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    port.setFraming(QextFraming::lengthPrefixed(3));
+    QCOMPARE(port.framing().mode, QextFraming::NoFraming);
+    port.setFraming(QextFraming::fixedSize(0));
+    QCOMPARE(port.framing().mode, QextFraming::NoFraming);
+}
+
+QTEST_MAIN(tst_QextFraming)
+
+#include "tst_qextframing.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_qextiothread
+CONFIG += qextserialport-io_uring
+include(../../src/qextserialport.pri)
+SOURCES  += tst_qextiothread.cpp
+QT = core testlib
@@ -0,0 +1,123 @@
+#include "qextserialport.h"
+#include "qextiothread_p.h"
+#include <QtTest/QtTest>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+class tst_QextIoThread : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void readyRead();
+    void busyOwner();
+    void fullBuffer();
+    void idlePortsIoUring();
+
+private:
+    int master;
+    QString slaveName;
+};
+
+void tst_QextIoThread::init()
+{
+    master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    QVERIFY(master != -1);
+    QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+    ::fcntl(master, F_SETFL, ::fcntl(master, F_GETFL) | O_NONBLOCK);
+    slaveName = QString::fromLatin1(::ptsname(master));
+}
+
+void tst_QextIoThread::cleanup()
+{
+    ::close(master);
+}
+
+void tst_QextIoThread::readyRead()
+{
+    QextSerialPort port(slaveName, QextSerialPort::IoThread);
+    QVERIFY(port.open(QIODevice::ReadWrite));
+    QSignalSpy spy(&port, SIGNAL(readyRead()));
+
+    QCOMPARE(int(::write(master, "hello", 5)), 5);
+    QTRY_VERIFY(spy.count() > 0);
+    QCOMPARE(port.bytesAvailable(), qint64(5));
+    QCOMPARE(port.readAll(), QByteArray("hello"));
+}
+
+void tst_QextIoThread::busyOwner()
+{
+    QextSerialPort port(slaveName, QextSerialPort::IoThread);
+    QVERIFY(port.open(QIODevice::ReadWrite));
+
+    // the owning thread is stuck: the bytes must be buffered anyway
+    QCOMPARE(int(::write(master, "abc", 3)), 3);
+    QTest::qSleep(100);
+    QCOMPARE(port.bytesAvailable(), qint64(3));
+    QCOMPARE(port.read(3), QByteArray("abc"));
+}
+
+void tst_QextIoThread::fullBuffer()
+{
+    QextSerialPort port(slaveName, QextSerialPort::IoThread);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    // more than the read buffer holds: the rest waits in the driver until
+    // the buffer is drained
+    const int total = 256 * 1024;
+    QByteArray received;
+    int sent = 0;
+    QTime timer;
+    timer.start();
+    while (received.size() < total && timer.elapsed() < 10000) {
+        char chunk[1024];
+        for (int i = 0; i < int(sizeof(chunk)); ++i)
+            chunk[i] = char(sent + i);
+        if (sent < total) {
+            int n = ::write(master, chunk, qMin(int(sizeof(chunk)), total - sent));
+            if (n > 0)
+                sent += n;
+        }
+        received += port.readAll();
+        if (port.bytesAvailable() == 0)
+            QTest::qSleep(1);
+    }
+
+    QCOMPARE(received.size(), total);
+    for (int i = 0; i < total; ++i) {
+        if (received.at(i) != char(i))
+            QFAIL(qPrintable(QString::fromLatin1("byte %1 out of order").arg(i)));
+    }
+}
+
+/*
+  Attaching and removing a port each need a wake-up of the I/O thread, and
+  with no traffic nothing else wakes it: every wake-up has to be answered,
+  not only the first.
+*/
+void tst_QextIoThread::idlePortsIoUring()
+{
+#ifdef QESP_IO_URING
+    if (!QextIoThread::instance()->setBackend(QextIoThread::IoUring))
+        QSKIP("io_uring not available", SkipSingle);
+
+    for (int i = 0; i < 3; ++i) {
+        QextSerialPort *port = new QextSerialPort(slaveName, QextSerialPort::IoThread);
+        QVERIFY(port->open(QIODevice::ReadWrite));
+        QTest::qSleep(20);
+        port->close();
+        delete port;
+    }
+    QVERIFY(QextIoThread::instance()->setBackend(QextIoThread::Epoll));
+#else
+    QSKIP("built without qextserialport-io_uring", SkipSingle);
+#endif
+}
+
+QTEST_MAIN(tst_QextIoThread)
+
+#include "tst_qextiothread.moc"
@@ -0,0 +1,4 @@
+TARGET = tst_qextlatencyhistogram
+include(../../src/qextserialport.pri)
+SOURCES  += tst_qextlatencyhistogram.cpp
+QT = core testlib
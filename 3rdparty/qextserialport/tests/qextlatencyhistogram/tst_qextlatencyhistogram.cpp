@@ -0,0 +1,173 @@
+#include "qextserialport.h"
+#include <QtTest/QtTest>
+#ifdef Q_OS_UNIX
+#  include <fcntl.h>
+#  include <stdlib.h>
+#  include <unistd.h>
+#endif
+
+class tst_QextLatencyHistogram : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void empty();
+    void exactBelow64();
+    void precision();
+    void percentiles();
+    void add();
+    void receiveStats();
+    void readLineStats();
+};
+
+void tst_QextLatencyHistogram::empty()
+{
+    QextLatencyHistogram h;
+    QCOMPARE(h.count(), qint64(0));
+    QCOMPARE(h.minimum(), qint64(0));
+    QCOMPARE(h.maximum(), qint64(0));
+    QCOMPARE(h.valueAtPercentile(99), qint64(0));
+}
+
+void tst_QextLatencyHistogram::exactBelow64()
+{
+    QextLatencyHistogram h;
+    for (int i = 0; i < 64; ++i)
+        h.record(i);
+    for (int i = 0; i < 64; ++i)
+        QCOMPARE(h.bucketValue(i), qint64(1));
+    QCOMPARE(h.minimum(), qint64(0));
+    QCOMPARE(h.maximum(), qint64(63));
+    QCOMPARE(h.mean(), 31.5);
+}
+
+void tst_QextLatencyHistogram::precision()
+{
+    // every value falls in a bucket no wider than 1/32 of its lower bound
+    for (int b = 2 * QextLatencyHistogram::SubBuckets; b < QextLatencyHistogram::Buckets - 1; ++b) {
+        qint64 low = QextLatencyHistogram::bucketLowerBound(b);
+        qint64 next = QextLatencyHistogram::bucketLowerBound(b + 1);
+        QVERIFY(next > low);
+        QVERIFY((next - low) * 32 <= low);
+
+        QextLatencyHistogram h;
+        h.record(low);
+        h.record(next - 1);
+        QCOMPARE(h.bucketValue(b), qint64(2));
+    }
+
+    QextLatencyHistogram h;
+    h.record(Q_INT64_C(1) << 40);
+    QCOMPARE(h.bucketValue(QextLatencyHistogram::Buckets - 1), qint64(1));
+}
+
+void tst_QextLatencyHistogram::percentiles()
+{
+    QextLatencyHistogram h;
+    for (int i = 1; i <= 1000; ++i)
+        h.record(i);
+    QCOMPARE(h.valueAtPercentile(0), qint64(1));
+    QCOMPARE(h.valueAtPercentile(100), qint64(1000));
+
+    qint64 median = h.valueAtPercentile(50);
+    QVERIFY(median >= 500 && median <= 500 + 500 / 32);
+    qint64 p99 = h.valueAtPercentile(99);
+    QVERIFY(p99 >= 990 && p99 <= 990 + 990 / 32);
+}
+
+void tst_QextLatencyHistogram::add()
+{
+    QextLatencyHistogram a, b;
+    a.record(10);
+    b.record(5000);
+    b.record(20);
+    a.add(b);
+    QCOMPARE(a.count(), qint64(3));
+    QCOMPARE(a.minimum(), qint64(10));
+    QCOMPARE(a.maximum(), qint64(5000));
+
+    a.reset();
+    QCOMPARE(a.count(), qint64(0));
+}
+
+/*
+  Bytes that wait in the read buffer are counted with their dwell time.
+*/
+void tst_QextLatencyHistogram::receiveStats()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("needs a pty", SkipAll);
+#else
+    int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    QVERIFY(master != -1);
+    QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+
+    QextSerialPort port(QString::fromLatin1(::ptsname(master)), QextSerialPort::Polling);
+    port.setTimeout(1000);
+    port.setReceiveTimestamping(true);
+    QVERIFY(port.isReceiveTimestamping());
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    for (int i = 0; i < 3; ++i) {
+        QCOMPARE(int(::write(master, "abcd", 4)), 4);
+        QTest::qSleep(20);
+        const char *data;
+        QCOMPARE(port.readableSpan(&data), qint64(4));
+
+        // not read yet: no dwell time
+        QCOMPARE(port.receiveStats().dwell.count(), qint64(i));
+        QTest::qSleep(10);
+        port.consume(4);
+    }
+
+    QextReceiveStats stats = port.receiveStats();
+    QCOMPARE(stats.chunks, qint64(3));
+    QCOMPARE(stats.bytes, qint64(12));
+    QCOMPARE(stats.dwell.count(), qint64(3));
+    QVERIFY(stats.dwell.minimum() >= 10000);
+    QCOMPARE(stats.jitter.count(), qint64(1));
+
+    port.resetReceiveStats();
+    QCOMPARE(port.receiveStats().chunks, qint64(0));
+
+    port.close();
+    ::close(master);
+#endif
+}
+
+/*
+  Lines taken with readLine() count their dwell time like read() does, and
+  leave no stamps behind.
+*/
+void tst_QextLatencyHistogram::readLineStats()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("needs a pty", SkipAll);
+#else
+    int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    QVERIFY(master != -1);
+    QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+
+    QextSerialPort port(QString::fromLatin1(::ptsname(master)), QextSerialPort::Polling);
+    port.setTimeout(1000);
+    port.setReceiveTimestamping(true);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    for (int i = 0; i < 3; ++i) {
+        QCOMPARE(int(::write(master, "line\n", 5)), 5);
+        QTest::qSleep(20);
+        QCOMPARE(port.refresh(), qint64(5));
+        QTest::qSleep(10);
+        QCOMPARE(port.readLine(), QByteArray("line\n"));
+        QCOMPARE(port.receiveStats().dwell.count(), qint64(i + 1));
+    }
+    QVERIFY(port.receiveStats().dwell.minimum() >= 10000);
+
+    port.close();
+    ::close(master);
+#endif
+}
+
+QTEST_MAIN(tst_QextLatencyHistogram)
+
+#include "tst_qextlatencyhistogram.moc"
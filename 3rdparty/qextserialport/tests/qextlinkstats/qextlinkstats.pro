@@ -0,0 +1,4 @@
+TARGET = tst_qextlinkstats
+include(../../src/qextserialport.pri)
+SOURCES  += tst_qextlinkstats.cpp
+QT = core testlib
@@ -0,0 +1,235 @@
+#include "qextserialport.h"
+#include <QtTest/QtTest>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+Q_DECLARE_METATYPE(QextSerialPort::QueryMode)
+
+class tst_QextLinkStats : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void counters_data();
+    void counters();
+    void rates();
+    void frames();
+    void reset();
+    void reopen();
+    void duringBlockingRead();
+
+private:
+    int master;
+    QString slaveName;
+};
+
+void tst_QextLinkStats::init()
+{
+    master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    QVERIFY(master != -1);
+    QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+    slaveName = QString::fromLatin1(::ptsname(master));
+}
+
+void tst_QextLinkStats::cleanup()
+{
+    ::close(master);
+}
+
+class BlockingReader : public QThread
+{
+public:
+    BlockingReader(QextSerialPort *port) : port(port) {}
+
+protected:
+    void run()
+    {
+        char c;
+        port->read(&c, 1);
+    }
+
+private:
+    QextSerialPort *port;
+};
+
+static void receive(QextSerialPort &port, int master, const char *data, int size)
+{
+    QCOMPARE(::write(master, data, size), ssize_t(size));
+    QByteArray received;
+    while (received.size() < size) {
+        QVERIFY(port.waitForReadyRead(1000));
+        received += port.readAll();
+    }
+    QCOMPARE(received, QByteArray(data, size));
+}
+
+void tst_QextLinkStats::counters_data()
+{
+    QTest::addColumn<QextSerialPort::QueryMode>("mode");
+    QTest::newRow("Polling") << QextSerialPort::Polling;
+    QTest::newRow("EventDriven") << QextSerialPort::EventDriven;
+    QTest::newRow("IoThread") << QextSerialPort::IoThread;
+}
+
+void tst_QextLinkStats::counters()
+{
+    QFETCH(QextSerialPort::QueryMode, mode);
+    QextSerialPort port(slaveName, mode);
+    port.setTimeout(-1);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    QextLinkStats stats = port.linkStats();
+    QCOMPARE(stats.bytesIn, qint64(0));
+    QCOMPARE(stats.bytesOut, qint64(0));
+    // a pty keeps no error counters
+    QVERIFY(!stats.hasErrorCounters);
+    QCOMPARE(stats.errors(), qint64(0));
+
+    receive(port, master, "0123456789", 10);
+    QCOMPARE(port.write("abcde", 5), qint64(5));
+    QList<QByteArray> buffers;
+    buffers << QByteArray("fg") << QByteArray("hij");
+    QCOMPARE(port.writev(buffers), qint64(5));
+    port.flush();
+
+    stats = port.linkStats();
+    QCOMPARE(stats.bytesIn, qint64(10));
+    QVERIFY(stats.readCalls >= 1 && stats.readCalls <= 10);
+    QCOMPARE(stats.bytesOut, qint64(10));
+    QCOMPARE(stats.writeCalls, qint64(2));
+
+    char sent[10];
+    QCOMPARE(::read(master, sent, sizeof(sent)), ssize_t(10));
+    QCOMPARE(QByteArray(sent, 10), QByteArray("abcdefghij"));
+}
+
+/*
+  The rates are refreshed every quarter of a second.
+*/
+void tst_QextLinkStats::rates()
+{
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    port.setTimeout(-1);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    receive(port, master, "0123456789", 10);
+    QTest::qSleep(300);
+    QextLinkStats stats = port.linkStats();
+    QVERIFY(stats.shortRate.bytesIn > 0);
+    QVERIFY(stats.shortRate.bytesIn < 10 / 0.25);
+    QVERIFY(stats.longRate.bytesIn > 0);
+    QCOMPARE(stats.shortRate.bytesOut, 0.0);
+
+    // nothing moves for more than the short window
+    for (int i = 0; i < 5; ++i) {
+        QTest::qSleep(300);
+        stats = port.linkStats();
+    }
+    QCOMPARE(stats.shortRate.bytesIn, 0.0);
+    QVERIFY(stats.longRate.bytesIn > 0);
+    QCOMPARE(stats.bytesIn, qint64(10));
+}
+
+/*
+  Frames are counted as readFrame() returns them and as write() and writev()
+  complete them, wherever the caller splits them.
+*/
+void tst_QextLinkStats::frames()
+{
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    port.setTimeout(-1);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    port.setFraming(QextFraming::delimited('\n'));
+
+    // the second frame ends in the next call; the empty one does not count
+    QCOMPARE(port.write("ab\ncd", 5), qint64(5));
+    QList<QByteArray> buffers;
+    buffers << QByteArray("e\n") << QByteArray("\n");
+    QCOMPARE(port.writev(buffers), qint64(3));
+    QextLinkStats stats = port.linkStats();
+    QCOMPARE(stats.framesOut, qint64(2));
+    QCOMPARE(stats.writeCalls, qint64(2));
+
+    QCOMPARE(::write(master, "x\ny\nz", 5), ssize_t(5));
+    QList<QByteArray> frames;
+    QTime timer;
+    timer.start();
+    while (frames.size() < 2 && timer.elapsed() < 1000) {
+        QByteArray frame = port.readFrame();
+        if (!frame.isEmpty())
+            frames << frame;
+    }
+    QCOMPARE(frames, QList<QByteArray>() << QByteArray("x") << QByteArray("y"));
+    // z is not a whole frame yet
+    QCOMPARE(port.readFrame(), QByteArray());
+    QCOMPARE(port.linkStats().framesIn, qint64(2));
+
+    port.resetLinkStats();
+    QCOMPARE(port.linkStats().framesIn, qint64(0));
+    QCOMPARE(port.linkStats().framesOut, qint64(0));
+}
+
+void tst_QextLinkStats::reset()
+{
+    QextSerialPort port(slaveName, QextSerialPort::EventDriven);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    receive(port, master, "0123", 4);
+    QCOMPARE(port.linkStats().bytesIn, qint64(4));
+
+    port.resetLinkStats();
+    QextLinkStats stats = port.linkStats();
+    QCOMPARE(stats.bytesIn, qint64(0));
+    QCOMPARE(stats.readCalls, qint64(0));
+
+    receive(port, master, "45", 2);
+    QCOMPARE(port.linkStats().bytesIn, qint64(2));
+}
+
+/*
+  Opening the port starts the statistics over.
+*/
+void tst_QextLinkStats::reopen()
+{
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QCOMPARE(port.write("abc", 3), qint64(3));
+    port.close();
+    QCOMPARE(port.linkStats().bytesOut, qint64(3));
+
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QCOMPARE(port.linkStats().bytesOut, qint64(0));
+}
+
+/*
+  A blocking read holds the port for up to its timeout; linkStats() does not
+  wait for it.
+*/
+void tst_QextLinkStats::duringBlockingRead()
+{
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    port.setTimeout(2000);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QCOMPARE(port.write("abc", 3), qint64(3));
+
+    BlockingReader reader(&port);
+    reader.start();
+    QTest::qSleep(100);
+
+    QTime timer;
+    timer.start();
+    QextLinkStats stats = port.linkStats();
+    QVERIFY(timer.elapsed() < 500);
+    QCOMPARE(stats.bytesOut, qint64(3));
+    QVERIFY(!reader.isFinished());
+
+    QCOMPARE(::write(master, "x", 1), ssize_t(1));
+    QVERIFY(reader.wait(5000));
+}
+
+QTEST_MAIN(tst_QextLinkStats)
+
+#include "tst_qextlinkstats.moc"
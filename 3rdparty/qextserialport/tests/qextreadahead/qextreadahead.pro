@@ -0,0 +1,4 @@
+TARGET = tst_qextreadahead
+include(../../src/qextserialport.pri)
+SOURCES  += tst_qextreadahead.cpp
+QT = core testlib
@@ -0,0 +1,142 @@
+#include "qextserialport.h"
+#include <QtTest/QtTest>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+Q_DECLARE_METATYPE(QextSerialPort::QueryMode)
+
+class tst_QextReadAhead : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void readTakesAll_data();
+    void readTakesAll();
+    void emptyBufferAsksDriver_data();
+    void emptyBufferAsksDriver();
+    void countingKeepsReadyRead();
+    void refreshSignals();
+    void closedPort();
+
+private:
+    void send(const QByteArray &data);
+
+    int master;
+    QString slaveName;
+};
+
+void tst_QextReadAhead::init()
+{
+    master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    QVERIFY(master != -1);
+    QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+    slaveName = QString::fromLatin1(::ptsname(master));
+}
+
+void tst_QextReadAhead::cleanup()
+{
+    ::close(master);
+}
+
+/*
+  Writes to the master side and gives the pty time to pass it on.
+*/
+void tst_QextReadAhead::send(const QByteArray &data)
+{
+    QCOMPARE(::write(master, data.constData(), data.size()), ssize_t(data.size()));
+    QTest::qSleep(20);
+}
+
+void tst_QextReadAhead::readTakesAll_data()
+{
+    QTest::addColumn<QextSerialPort::QueryMode>("mode");
+    QTest::newRow("Polling") << QextSerialPort::Polling;
+    QTest::newRow("EventDriven") << QextSerialPort::EventDriven;
+}
+
+/*
+  A short read takes everything the driver has; bytesAvailable() then counts
+  it from the buffer and misses what arrives later, until refresh().
+*/
+void tst_QextReadAhead::readTakesAll()
+{
+    QFETCH(QextSerialPort::QueryMode, mode);
+    QextSerialPort port(slaveName, mode);
+    port.setTimeout(100);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    send("0123456789");
+    QCOMPARE(port.read(1), QByteArray("0"));
+    QCOMPARE(port.bytesAvailable(), qint64(9));
+
+    send("abc");
+    QCOMPARE(port.bytesAvailable(), qint64(9));
+    QCOMPARE(port.refresh(), qint64(12));
+    QCOMPARE(port.bytesAvailable(), qint64(12));
+    QCOMPARE(port.readAll(), QByteArray("123456789abc"));
+    QCOMPARE(port.bytesAvailable(), qint64(0));
+}
+
+void tst_QextReadAhead::emptyBufferAsksDriver_data()
+{
+    readTakesAll_data();
+}
+
+void tst_QextReadAhead::emptyBufferAsksDriver()
+{
+    QFETCH(QextSerialPort::QueryMode, mode);
+    QextSerialPort port(slaveName, mode);
+    port.setTimeout(100);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    QCOMPARE(port.bytesAvailable(), qint64(0));
+    send("xyz");
+    QCOMPARE(port.bytesAvailable(), qint64(3));
+    QCOMPARE(port.readAll(), QByteArray("xyz"));
+}
+
+/*
+  In EventDriven mode asking for the count must not take the bytes from the
+  event loop: readyRead() still comes for them.
+*/
+void tst_QextReadAhead::countingKeepsReadyRead()
+{
+    QextSerialPort port(slaveName, QextSerialPort::EventDriven);
+    port.setTimeout(100);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QSignalSpy spy(&port, SIGNAL(readyRead()));
+
+    send("xyz");
+    QCOMPARE(port.bytesAvailable(), qint64(3));
+    QCOMPARE(port.bytesAvailable(), qint64(3));
+    QTRY_VERIFY(spy.count() > 0);
+    QCOMPARE(port.readAll(), QByteArray("xyz"));
+}
+
+void tst_QextReadAhead::refreshSignals()
+{
+    QextSerialPort port(slaveName, QextSerialPort::EventDriven);
+    port.setTimeout(100);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QSignalSpy spy(&port, SIGNAL(readyRead()));
+
+    send("xyz");
+    QCOMPARE(port.refresh(), qint64(3));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(port.readAll(), QByteArray("xyz"));
+}
+
+void tst_QextReadAhead::closedPort()
+{
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    QCOMPARE(port.bytesAvailable(), qint64(0));
+    QCOMPARE(port.refresh(), qint64(0));
+}
+
+QTEST_MAIN(tst_QextReadAhead)
+
+#include "tst_qextreadahead.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_qextringbuffer
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += qextserialport_p.h
+SOURCES  += tst_qextringbuffer.cpp
+QT = core testlib
@@ -0,0 +1,157 @@
+#include "qextserialport_p.h"
+#include <QtTest/QtTest>
+#include <QtCore/QThread>
+
+class Producer : public QThread
+{
+public:
+    Producer(QextRingBuffer *buffer, int total)
+        : buffer(buffer), total(total) {}
+
+protected:
+    void run()
+    {
+        int written = 0;
+        while (written < total) {
+            int spanSize;
+            char *span = buffer->writeSpan(&spanSize);
+            int n = qMin(spanSize, total - written);
+            if (n == 0)
+                yieldCurrentThread();
+            for (int i = 0; i < n; ++i)
+                span[i] = char(written + i);
+            buffer->commitWrite(n);
+            written += n;
+        }
+    }
+
+private:
+    QextRingBuffer *buffer;
+    int total;
+};
+
+class tst_QextRingBuffer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void capacity();
+    void wrapAround();
+    void full();
+    void canReadLine();
+    void clear();
+    void concurrent();
+};
+
+void tst_QextRingBuffer::capacity()
+{
+    QextRingBuffer b1(1000), b2(1024);
+    QCOMPARE(b1.capacity(), 1024);
+    QCOMPARE(b2.capacity(), 1024);
+    QVERIFY(b1.isEmpty());
+    QCOMPARE(b1.freeSpace(), 1024);
+}
+
+void tst_QextRingBuffer::wrapAround()
+{
+    QextRingBuffer b(16);
+    char out[16];
+    int spanSize;
+
+    memcpy(b.writeSpan(&spanSize), "0123456789", 10);
+    b.commitWrite(10);
+    QCOMPARE(b.read(out, 8), 8);
+
+    // 6 bytes until the end of the storage, then the rest from the start
+    char *span = b.writeSpan(&spanSize);
+    QCOMPARE(spanSize, 6);
+    memcpy(span, "abcdef", 6);
+    b.commitWrite(6);
+    span = b.writeSpan(&spanSize);
+    QCOMPARE(spanSize, 8);
+    memcpy(span, "ghij", 4);
+    b.commitWrite(4);
+
+    QCOMPARE(b.size(), 12);
+    const char *readPtr = b.readSpan(&spanSize);
+    QCOMPARE(spanSize, 8);
+    QCOMPARE(QByteArray(readPtr, spanSize), QByteArray("89abcdef"));
+    QCOMPARE(b.read(out, 16), 12);
+    QCOMPARE(QByteArray(out, 12), QByteArray("89abcdefghij"));
+    QVERIFY(b.isEmpty());
+}
+
+void tst_QextRingBuffer::full()
+{
+    QextRingBuffer b(8);
+    int spanSize;
+    b.writeSpan(&spanSize);
+    QCOMPARE(spanSize, 8);
+    b.commitWrite(8);
+    b.writeSpan(&spanSize);
+    QCOMPARE(spanSize, 0);
+    QCOMPARE(b.freeSpace(), 0);
+
+    b.consume(3);
+    b.writeSpan(&spanSize);
+    QCOMPARE(spanSize, 3);
+}
+
+void tst_QextRingBuffer::canReadLine()
+{
+    QextRingBuffer b(8);
+    char out[8];
+    int spanSize;
+
+    memcpy(b.writeSpan(&spanSize), "abcdef", 6);
+    b.commitWrite(6);
+    QVERIFY(!b.canReadLine());
+    b.read(out, 5);
+
+    // the newline lands in the wrapped part
+    memcpy(b.writeSpan(&spanSize), "gh", 2);
+    b.commitWrite(2);
+    memcpy(b.writeSpan(&spanSize), "\n", 1);
+    b.commitWrite(1);
+    QVERIFY(b.canReadLine());
+}
+
+void tst_QextRingBuffer::clear()
+{
+    QextRingBuffer b(8);
+    int spanSize;
+    b.writeSpan(&spanSize);
+    b.commitWrite(5);
+    b.clear();
+    QVERIFY(b.isEmpty());
+    QCOMPARE(b.freeSpace(), 8);
+}
+
+void tst_QextRingBuffer::concurrent()
+{
+    const int total = 16 * 1024 * 1024;
+    QextRingBuffer b(4096);
+    Producer producer(&b, total);
+    producer.start();
+
+    int received = 0;
+    bool inOrder = true;
+    while (received < total) {
+        int spanSize;
+        const char *span = b.readSpan(&spanSize);
+        if (spanSize == 0)
+            QThread::yieldCurrentThread();
+        for (int i = 0; i < spanSize; ++i)
+            inOrder &= (span[i] == char(received + i));
+        b.consume(spanSize);
+        received += spanSize;
+    }
+
+    QVERIFY(producer.wait(30000));
+    QVERIFY(inOrder);
+    QVERIFY(b.isEmpty());
+}
+
+QTEST_MAIN(tst_QextRingBuffer)
+
+#include "tst_qextringbuffer.moc"
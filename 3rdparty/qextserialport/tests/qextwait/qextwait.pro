@@ -0,0 +1,4 @@
+TARGET = tst_qextwait
+include(../../src/qextserialport.pri)
+SOURCES  += tst_qextwait.cpp
+QT = core testlib
@@ -0,0 +1,4 @@
+TARGET = tst_qextwritequeue
+include(../../src/qextserialport.pri)
+SOURCES  += tst_qextwritequeue.cpp
+QT = core testlib
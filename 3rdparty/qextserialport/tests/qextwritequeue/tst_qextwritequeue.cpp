@@ -0,0 +1,222 @@
+#include "qextserialport.h"
+#include <QtTest/QtTest>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+class tst_QextWriteQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void queueAndDrain();
+    void immediateWrite();
+    void highWaterMark();
+    void polling();
+    void partialWritev();
+    void queuedWritev();
+
+private:
+    QByteArray drainMaster(int bytes);
+    static QList<QByteArray> buffers(QByteArray *joined);
+
+    int master;
+    QString slaveName;
+};
+
+void tst_QextWriteQueue::init()
+{
+    master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    QVERIFY(master != -1);
+    QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+    ::fcntl(master, F_SETFL, ::fcntl(master, F_GETFL) | O_NONBLOCK);
+    slaveName = QString::fromLatin1(::ptsname(master));
+}
+
+void tst_QextWriteQueue::cleanup()
+{
+    ::close(master);
+}
+
+/*
+  Reads what the port wrote from the master side, running the event loop so
+  the write queue keeps draining.
+*/
+QByteArray tst_QextWriteQueue::drainMaster(int bytes)
+{
+    QByteArray received;
+    QTime timer;
+    timer.start();
+    while (received.size() < bytes && timer.elapsed() < 10000) {
+        char chunk[4096];
+        int n = ::read(master, chunk, sizeof(chunk));
+        if (n > 0)
+            received.append(chunk, n);
+        QCoreApplication::processEvents();
+    }
+    return received;
+}
+
+/*
+  More than the pty takes, in buffers of an odd size so that the driver
+  stops in the middle of one. Each buffer has its own pattern.
+*/
+QList<QByteArray> tst_QextWriteQueue::buffers(QByteArray *joined)
+{
+    QList<QByteArray> list;
+    for (int b = 0; b < 64; ++b) {
+        QByteArray buffer(4099, '\0');
+        for (int i = 0; i < buffer.size(); ++i)
+            buffer[i] = char(b * 31 + i * 7);
+        list << buffer;
+        joined->append(buffer);
+    }
+    return list;
+}
+
+void tst_QextWriteQueue::queueAndDrain()
+{
+    QextSerialPort port(slaveName, QextSerialPort::EventDriven);
+    port.setTimeout(-1);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QSignalSpy spy(&port, SIGNAL(bytesWritten(qint64)));
+
+    // more than the pty takes: the rest must wait in the queue
+    QByteArray data(256 * 1024, '\0');
+    for (int i = 0; i < data.size(); ++i)
+        data[i] = char(i * 7);
+    QCOMPARE(port.write(data), qint64(data.size()));
+    QVERIFY(port.bytesToWrite() > 0);
+
+    QCOMPARE(drainMaster(data.size()), data);
+    QTRY_COMPARE(port.bytesToWrite(), qint64(0));
+    QVERIFY(spy.count() > 0);
+    // the part the driver took at once is reported too
+    qint64 signalled = 0;
+    for (int i = 0; i < spy.count(); ++i)
+        signalled += spy.at(i).at(0).toLongLong();
+    QCOMPARE(signalled, qint64(data.size()));
+}
+
+void tst_QextWriteQueue::immediateWrite()
+{
+    QextSerialPort port(slaveName, QextSerialPort::EventDriven);
+    port.setTimeout(-1);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QSignalSpy spy(&port, SIGNAL(bytesWritten(qint64)));
+
+    // the driver takes it all: nothing is queued, but it is still reported,
+    // from the event loop rather than from inside write()
+    QCOMPARE(port.write("hello", 5), qint64(5));
+    QCOMPARE(port.bytesToWrite(), qint64(0));
+    QCOMPARE(spy.count(), 0);
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toLongLong(), qint64(5));
+    QCOMPARE(drainMaster(5), QByteArray("hello"));
+}
+
+void tst_QextWriteQueue::highWaterMark()
+{
+    QextSerialPort port(slaveName, QextSerialPort::EventDriven);
+    port.setTimeout(-1);
+    port.setWriteHighWaterMark(1000);
+    QCOMPARE(port.writeHighWaterMark(), qint64(1000));
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    // fill the driver, then the queue up to the mark
+    QByteArray block(4096, 'x');
+    qint64 accepted = 0;
+    while (port.bytesToWrite() < 1000) {
+        qint64 n = port.write(block);
+        QVERIFY(n >= 0);
+        accepted += n;
+        QVERIFY(accepted < 16 * 1024 * 1024);
+    }
+    QCOMPARE(port.bytesToWrite(), qint64(1000));
+    QCOMPARE(port.write(block), qint64(0));
+
+    QCOMPARE(drainMaster(int(accepted)).size(), int(accepted));
+    QTRY_COMPARE(port.bytesToWrite(), qint64(0));
+    QVERIFY(port.write(block) > 0);
+}
+
+void tst_QextWriteQueue::polling()
+{
+    // no event loop to drain a queue: short writes as before
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    port.setTimeout(-1);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    QByteArray data(256 * 1024, 'x');
+    qint64 n = port.write(data);
+    QVERIFY(n > 0 && n < data.size());
+    QCOMPARE(port.bytesToWrite(), qint64(0));
+}
+
+void tst_QextWriteQueue::partialWritev()
+{
+    // no queue: the caller resends from the byte where the driver stopped
+    QextSerialPort port(slaveName, QextSerialPort::Polling);
+    port.setTimeout(-1);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    QByteArray expected;
+    QList<QByteArray> all = buffers(&expected);
+    QByteArray received;
+    qint64 sent = 0;
+    bool midBuffer = false;
+    QTime timer;
+    timer.start();
+    while (sent < expected.size() && timer.elapsed() < 10000) {
+        QList<QByteArray> rest;
+        qint64 skip = sent;
+        for (int i = 0; i < all.size(); ++i) {
+            if (skip >= all.at(i).size()) {
+                skip -= all.at(i).size();
+                continue;
+            }
+            rest << all.at(i).mid(int(skip));
+            skip = 0;
+        }
+        qint64 n = port.writev(rest);
+        QVERIFY(n >= 0);
+        sent += n;
+        if (sent < expected.size() && sent % 4099 != 0)
+            midBuffer = true;
+
+        char chunk[4096];
+        int got;
+        while ((got = ::read(master, chunk, sizeof(chunk))) > 0)
+            received.append(chunk, got);
+    }
+    QCOMPARE(sent, qint64(expected.size()));
+    QVERIFY(midBuffer);
+
+    received += drainMaster(expected.size() - received.size());
+    QCOMPARE(received, expected);
+}
+
+void tst_QextWriteQueue::queuedWritev()
+{
+    // the port queues the rest of the buffer the driver stopped in, and the
+    // ones after it
+    QextSerialPort port(slaveName, QextSerialPort::EventDriven);
+    port.setTimeout(-1);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+
+    QByteArray expected;
+    QCOMPARE(port.writev(buffers(&expected)), qint64(expected.size()));
+    qint64 queued = port.bytesToWrite();
+    QVERIFY(queued > 0 && queued < expected.size());
+    QVERIFY(queued % 4099 != 0);
+
+    QCOMPARE(drainMaster(expected.size()), expected);
+    QTRY_COMPARE(port.bytesToWrite(), qint64(0));
+}
+
+QTEST_MAIN(tst_QextWriteQueue)
+
+#include "tst_qextwritequeue.moc"
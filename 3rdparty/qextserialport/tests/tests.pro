@@ -1,2 +1,10 @@
 TEMPLATE=subdirs
+SUBDIRS += qextringbuffer \
+           qextlatencyhistogram
+linux*:SUBDIRS += qextiothread
+unix:SUBDIRS += qextwritequeue \
+                qextwait \
+                qextlinkstats \
+                qextframing \
+                qextreadahead
 win32:SUBDIRS += qextwineventnotifier
@@ -0,0 +1,13 @@
+TEMPLATE=subdirs
+SUBDIRS += fec \
+           multiplexer \
+           inputredundancy \
+           linkloss \
+           transport \
+           outputqueue \
+           blockbuffer \
+           settings
+unix:SUBDIRS += latency \
+                broadcaster \
+                bonding
+linux*:SUBDIRS += iobackend
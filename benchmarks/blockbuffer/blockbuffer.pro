@@ -0,0 +1,8 @@
+TARGET = tst_blockbuffer
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += blockbuffer.h
+SOURCES  += blockbuffer.cpp \
+            tst_blockbuffer.cpp
+QT = core testlib
+CONFIG += release
@@ -0,0 +1,100 @@
+#include "blockbuffer.h"
+#include <QtTest/QtTest>
+
+class tst_BlockBuffer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fifo();
+    void reserveLarge();
+    void backlog_data();
+    void backlog();
+};
+
+/*
+  Bytes come out in the order they went in, across block boundaries.
+*/
+void tst_BlockBuffer::fifo()
+{
+    BlockBuffer buffer;
+    QByteArray expected;
+    for (int i = 0; i < 3 * BlockBuffer::BLOCK_SIZE; i += 100) {
+        QByteArray chunk(100, char('a' + (i / 100) % 26));
+        buffer.append(chunk.constData(), chunk.size());
+        expected += chunk;
+    }
+    QCOMPARE(buffer.size(), qint64(expected.size()));
+
+    QByteArray received;
+    while (!buffer.isEmpty())
+        received += buffer.read(qint64(77));
+    QCOMPARE(received, expected);
+    QVERIFY(buffer.read(qint64(10)).isEmpty());
+}
+
+void tst_BlockBuffer::reserveLarge()
+{
+    BlockBuffer buffer;
+    buffer.append("ab", 2);
+    const int size = 2 * BlockBuffer::BLOCK_SIZE;
+    char *data = buffer.reserve(size);
+    memset(data, 'x', size);
+    buffer.commit(size);
+    QCOMPARE(buffer.size(), qint64(size + 2));
+    QCOMPARE(buffer.read(qint64(3)), QByteArray("abx"));
+    buffer.clear();
+    QVERIFY(buffer.isEmpty());
+}
+
+void tst_BlockBuffer::backlog_data()
+{
+    QTest::addColumn<bool>("chained");
+    QTest::addColumn<int>("backlog");
+    QTest::newRow("QByteArray, 4 KiB behind") << false << 4096;
+    QTest::newRow("QByteArray, 256 KiB behind") << false << 256 * 1024;
+    QTest::newRow("QByteArray, 4 MiB behind") << false << 4 * 1024 * 1024;
+    QTest::newRow("BlockBuffer, 4 KiB behind") << true << 4096;
+    QTest::newRow("BlockBuffer, 256 KiB behind") << true << 256 * 1024;
+    QTest::newRow("BlockBuffer, 4 MiB behind") << true << 4 * 1024 * 1024;
+}
+
+/*
+  A reader that fell behind (a stalled GUI, a slow spectator) keeps taking
+  one frame as one arrives: the cost of that step, with the given backlog.
+  The QByteArray rows are the former read buffer of UdpTransport, which
+  moved the whole backlog on every read.
+*/
+void tst_BlockBuffer::backlog()
+{
+    QFETCH(bool, chained);
+    QFETCH(int, backlog);
+
+    QByteArray frame(64, 'x');
+    BlockBuffer buffer;
+    QByteArray flat;
+    for (int i = 0; i < backlog; i += frame.size()) {
+        buffer.append(frame.constData(), frame.size());
+        flat.append(frame);
+    }
+
+    if (chained) {
+        QBENCHMARK {
+            buffer.append(frame.constData(), frame.size());
+            QCOMPARE(buffer.read(qint64(frame.size())).size(), frame.size());
+        }
+        QCOMPARE(buffer.size(), qint64(flat.size()));
+    }
+    else {
+        QBENCHMARK {
+            flat.append(frame);
+            QByteArray data = flat.left(frame.size());
+            flat.remove(0, data.size());
+            QCOMPARE(data.size(), frame.size());
+        }
+    }
+}
+
+QTEST_MAIN(tst_BlockBuffer)
+
+#include "tst_blockbuffer.moc"
@@ -0,0 +1,23 @@
+TARGET = tst_bonding
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += transport.h \
+            serialtransport.h \
+            sockettransport.h \
+            blockbuffer.h \
+            localtransport.h \
+            bondedtransport.h \
+            protocol.h \
+            ptytransport.h
+SOURCES  += transport.cpp \
+            serialtransport.cpp \
+            sockettransport.cpp \
+            blockbuffer.cpp \
+            localtransport.cpp \
+            bondedtransport.cpp \
+            protocol.cpp \
+            ptytransport.cpp \
+            tst_bonding.cpp
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
+QT = core network testlib
+CONFIG += release
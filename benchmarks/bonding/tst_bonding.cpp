@@ -0,0 +1,293 @@
+#include "bondedtransport.h"
+#include "ptytransport.h"
+#include "protocol.h"
+#include <QtTest/QtTest>
+#include <unistd.h>
+
+/*
+  Two bonded transports over pty pairs: a uses the master sides and b the
+  slave sides. The slave sides are opened first, so nothing written to a
+  master is processed by a slave still in its default (cooked) mode.
+*/
+struct BondPair
+{
+    BondPair(int links)
+    {
+        QList<Transport *> masters, slaves;
+        for (int i = 0; i < links; ++i) {
+            PtyTransport *master = new PtyTransport();
+            master->open();
+            masters.append(master);
+            slaves.append(new PtyTransport(master->getSlaveName()));
+        }
+        b = new BondedTransport(slaves);
+        b->open();
+        a = new BondedTransport(masters);
+        a->open();
+        b->setTimeout(1000);
+        a->setTimeout(1000);
+    }
+
+    ~BondPair()
+    {
+        delete a;
+        delete b;
+    }
+
+    BondedTransport *a;
+    BondedTransport *b;
+};
+
+class tst_Bonding : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void stream();
+    void reorder();
+    void lostSegment();
+    void linkFailure();
+    void stuckLink();
+    void throughput_data();
+    void throughput();
+
+private:
+    static QByteArray pattern(int size, int seed);
+    static QByteArray segment(quint16 seq, const QByteArray &data);
+    static QByteArray reset(quint16 session);
+};
+
+QByteArray tst_Bonding::pattern(int size, int seed)
+{
+    QByteArray data(size, 0);
+    for (int i = 0; i < size; ++i)
+        data[i] = char(i * 7 + seed);
+    return data;
+}
+
+/*
+  A segment as BondedTransport writes it.
+*/
+QByteArray tst_Bonding::segment(quint16 seq, const QByteArray &data)
+{
+    QByteArray s;
+    s.append(char(FRAME_SYNC));
+    s.append(char(seq >> 8));
+    s.append(char(seq & 0xff));
+    s.append(char(data.size()));
+    s.append(data);
+    s.append(char(crc8(s.constData() + 1, s.size() - 1)));
+    return s;
+}
+
+/*
+  The segment that starts a new numbering, sent on every link by open().
+*/
+QByteArray tst_Bonding::reset(quint16 session)
+{
+    QByteArray s;
+    s.append(char(FRAME_SYNC));
+    s.append(char(session >> 8));
+    s.append(char(session & 0xff));
+    s.append(char(0xff));
+    s.append(char(crc8(s.constData() + 1, s.size() - 1)));
+    return s;
+}
+
+/*
+  Frames of every size go through in order, striped over both links, in
+  both directions.
+*/
+void tst_Bonding::stream()
+{
+    BondPair pair(2);
+
+    QByteArray sent;
+    for (int i = 0; i < 200; ++i) {
+        QByteArray frame = pattern(1 + i % 300, i);
+        sent.append(frame);
+        QCOMPARE(pair.a->write(frame), qint64(frame.size()));
+    }
+    QCOMPARE(pair.b->read(sent.size()), sent);
+    QCOMPARE(pair.b->getLost(), quint32(0));
+    QVERIFY(pair.a->getBytesSent(0) > quint64(sent.size()) / 3);
+    QVERIFY(pair.a->getBytesSent(1) > quint64(sent.size()) / 3);
+
+    QByteArray reply = pattern(1000, 1);
+    pair.b->write(reply);
+    QCOMPARE(pair.a->read(reply.size()), reply);
+}
+
+/*
+  Segments that arrive early, on the other link, are held until the
+  missing one comes.
+*/
+void tst_Bonding::reorder()
+{
+    PtyTransport *master[2];
+    QList<Transport *> slaves;
+    for (int i = 0; i < 2; ++i) {
+        master[i] = new PtyTransport();
+        QVERIFY(master[i]->open());
+        slaves.append(new PtyTransport(master[i]->getSlaveName()));
+    }
+    BondedTransport bond(slaves);
+    QVERIFY(bond.open());
+    bond.setTimeout(100);
+    master[0]->write(reset(1));
+    master[1]->write(reset(1));
+
+    master[1]->write(segment(1, "world"));
+    master[1]->write(segment(2, "!"));
+    QCOMPARE(bond.read(1), QByteArray());
+    master[0]->write(segment(0, "hello "));
+    QCOMPARE(bond.read(12), QByteArray("hello world!"));
+    QCOMPARE(bond.getLost(), quint32(0));
+
+    // sent again by the other link after a failure: dropped
+    master[0]->write(segment(2, "!"));
+    master[0]->write(segment(3, "?"));
+    QCOMPARE(bond.read(1), QByteArray("?"));
+
+    delete master[0];
+    delete master[1];
+}
+
+/*
+  A corrupted segment is skipped once every link has delivered a later one.
+*/
+void tst_Bonding::lostSegment()
+{
+    PtyTransport *master[2];
+    QList<Transport *> slaves;
+    for (int i = 0; i < 2; ++i) {
+        master[i] = new PtyTransport();
+        QVERIFY(master[i]->open());
+        slaves.append(new PtyTransport(master[i]->getSlaveName()));
+    }
+    BondedTransport bond(slaves);
+    QVERIFY(bond.open());
+    bond.setTimeout(100);
+    master[0]->write(reset(1));
+    master[1]->write(reset(1));
+
+    QByteArray bad = segment(0, "lost");
+    bad[5] = bad[5] ^ 0x40;
+    master[0]->write(bad);
+    master[1]->write(segment(1, "one "));
+    QCOMPARE(bond.read(1), QByteArray());
+    master[0]->write(segment(2, "two"));
+    QCOMPARE(bond.read(7), QByteArray("one two"));
+    QCOMPARE(bond.getLost(), quint32(1));
+
+    delete master[0];
+    delete master[1];
+}
+
+/*
+  One link dies: what is written afterwards goes through the other link,
+  nothing is lost, and the far side stops sending on the dead link. Bytes
+  still in flight on a link when it dies are lost with it (a pty discards
+  them on hang-up), so the first half is read back before the failure.
+*/
+void tst_Bonding::linkFailure()
+{
+    BondPair pair(2);
+
+    QByteArray sent;
+    for (int i = 0; i < 50; ++i) {
+        QByteArray frame = pattern(100, i);
+        sent.append(frame);
+        pair.a->write(frame);
+    }
+    QCOMPARE(pair.b->read(sent.size()), sent);
+
+    pair.a->getLink(1)->close();
+    sent.clear();
+    for (int i = 50; i < 100; ++i) {
+        QByteArray frame = pattern(100, i);
+        sent.append(frame);
+        QCOMPARE(pair.a->write(frame), qint64(frame.size()));
+    }
+    QVERIFY(pair.a->isOpen());
+    QVERIFY(!pair.a->isLinkUsable(1));
+    QCOMPARE(pair.b->read(sent.size()), sent);
+    QCOMPARE(pair.b->getLost(), quint32(0));
+
+    // the slave side of the dead link gets nothing more
+    QTest::qWait(BondedTransport::LINK_TIMEOUT + 2 * BondedTransport::KEEPALIVE);
+    pair.a->write(pattern(10, 0));
+    QCOMPARE(pair.b->read(10), pattern(10, 0));
+    QVERIFY(!pair.b->isLinkUsable(1));
+
+    QByteArray reply = pattern(1000, 2);
+    pair.b->write(reply);
+    QCOMPARE(pair.a->read(reply.size()), reply);
+}
+
+/*
+  The peer stops reading one link without closing it: once its pty and its
+  queue (MAX_BACKLOG bytes) are full, the link gets no more segments and
+  everything goes through the other link.
+*/
+void tst_Bonding::stuckLink()
+{
+    PtyTransport *master[2];
+    QList<Transport *> slaves;
+    for (int i = 0; i < 2; ++i) {
+        master[i] = new PtyTransport();
+        QVERIFY(master[i]->open());
+        slaves.append(new PtyTransport(master[i]->getSlaveName()));
+    }
+    BondedTransport bond(slaves);
+    QVERIFY(bond.open());
+
+    QByteArray frame = pattern(BondedTransport::MAX_SEGMENT, 3);
+    quint64 stuck = 0;
+    for (int i = 0; i < 3000; ++i) {
+        if (i == 2000)
+            stuck = bond.getBytesSent(0);
+
+        // both queues can be full for a moment: 0 means retry later
+        QTime timer;
+        timer.start();
+        qint64 written;
+        while ((written = bond.write(frame)) == 0 && timer.elapsed() < 1000)
+            master[1]->readAll();
+        QCOMPARE(written, qint64(frame.size()));
+        master[1]->readAll();
+    }
+    QCOMPARE(bond.getBytesSent(0), stuck);
+
+    delete master[0];
+    delete master[1];
+}
+
+void tst_Bonding::throughput_data()
+{
+    QTest::addColumn<int>("links");
+    QTest::newRow("1 link") << 1;
+    QTest::newRow("2 links") << 2;
+    QTest::newRow("4 links") << 4;
+}
+
+/*
+  The cost of segmenting and reassembling, since a pty has no rate limit:
+  16 frames of 64 bytes per iteration, read back as a single block.
+*/
+void tst_Bonding::throughput()
+{
+    QFETCH(int, links);
+    BondPair pair(links);
+
+    QByteArray frame(64, 'x');
+    QBENCHMARK {
+        for (int i = 0; i < 16; ++i)
+            pair.a->write(frame);
+        QCOMPARE(pair.b->read(16 * frame.size()).size(), 16 * frame.size());
+    }
+}
+
+QTEST_MAIN(tst_Bonding)
+
+#include "tst_bonding.moc"
@@ -0,0 +1,23 @@
+TARGET = tst_broadcaster
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += broadcaster.h \
+            transport.h \
+            serialtransport.h \
+            sockettransport.h \
+            blockbuffer.h \
+            localtransport.h \
+            bondedtransport.h \
+            ptytransport.h
+SOURCES  += broadcaster.cpp \
+            transport.cpp \
+            serialtransport.cpp \
+            sockettransport.cpp \
+            blockbuffer.cpp \
+            localtransport.cpp \
+            bondedtransport.cpp \
+            ptytransport.cpp \
+            tst_broadcaster.cpp
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
+QT = core network testlib
+CONFIG += release
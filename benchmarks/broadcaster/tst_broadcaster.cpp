@@ -0,0 +1,56 @@
+#include "broadcaster.h"
+#include "ptytransport.h"
+#include <QtTest/QtTest>
+
+class tst_Broadcaster : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_Broadcaster(){}
+    ~tst_Broadcaster(){}
+
+private slots:
+    void stalledSink();
+};
+
+/*
+  A spectator on a pty that is never read: once the pty buffer fills up its
+  queue stays at MAX_QUEUE and the oldest frames are dropped, while the
+  player, written first in every tick as the game does, gets every frame
+  without waiting for it.
+*/
+void tst_Broadcaster::stalledSink()
+{
+    PtyTransport player;
+    QVERIFY(player.open());
+    PtyTransport opponent(player.getSlaveName());
+    QVERIFY(opponent.open());
+
+    Broadcaster broadcaster;
+    QVERIFY(broadcaster.addSink("pty"));
+
+    QByteArray frame(14, 'x');
+    const int ticks = 4000;
+    int slowest = 0;
+    for (int i = 0; i < ticks; ++i) {
+        frame[1] = char(i);
+
+        QTime tick;
+        tick.start();
+        QCOMPARE(player.write(frame), qint64(frame.size()));
+        broadcaster.broadcast(frame);
+        slowest = qMax(slowest, tick.elapsed());
+
+        QCOMPARE(opponent.read(frame.size()), frame);
+    }
+
+    qDebug("slowest tick %d ms, %u frames dropped", slowest, broadcaster.getDropped(0));
+    QCOMPARE(broadcaster.getQueueDepth(0), int(Broadcaster::MAX_QUEUE));
+    QVERIFY(broadcaster.getDropped(0) > 0);
+    QVERIFY(slowest < 20);
+}
+
+QTEST_MAIN(tst_Broadcaster)
+
+#include "tst_broadcaster.moc"
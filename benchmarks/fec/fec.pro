@@ -0,0 +1,9 @@
+TARGET = tst_fec
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += fec.h \
+            protocol.h
+SOURCES  += fec.cpp \
+            tst_fec.cpp
+QT = core testlib
+CONFIG += release
@@ -0,0 +1,150 @@
+#include "fec.h"
+#include "protocol.h"
+#include <QtTest/QtTest>
+
+class tst_Fec : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_Fec(){}
+    ~tst_Fec(){}
+
+private slots:
+    void correctsSingleBitErrors();
+    void rejectedFrameKeepsBuffer();
+    void noiseBeforeFrames();
+    void corruptedSync();
+    void encode_data();
+    void encode();
+    void decode_data();
+    void decode();
+
+private:
+    static QByteArray message(int size);
+};
+
+QByteArray tst_Fec::message(int size)
+{
+    QByteArray data;
+    for (int i = 0; i < size; ++i)
+        data.append(char(i * 37 + 11));
+    return data;
+}
+
+void tst_Fec::correctsSingleBitErrors()
+{
+    QByteArray original = message(sizeof(GameControl));
+    QByteArray encoded = Fec::encode(original);
+
+    // the sync byte must arrive intact; every bit after it is corrected
+    for (int bit = 8; bit < encoded.size() * 8; ++bit) {
+        QByteArray corrupted = encoded;
+        corrupted[bit / 8] = corrupted.at(bit / 8) ^ (1 << (bit % 8));
+
+        FecDecoder decoder;
+        decoder.feed(corrupted);
+        QList<QByteArray> messages = decoder.takeMessages();
+        QCOMPARE(messages.size(), 1);
+        QCOMPARE(messages.at(0), original);
+        QCOMPARE(decoder.getCorrected(), quint32(1));
+    }
+}
+
+void tst_Fec::rejectedFrameKeepsBuffer()
+{
+    /* A false header whose frame overlaps the real one: it is rejected, and
+       the real frame must still be decoded from the bytes as they arrived. */
+    QByteArray original = message(20);
+    QByteArray stream = Fec::encode(message(40)).left(3);
+    stream.append(QByteArray("\xe8\x5c\xfa\xc4\x90\xd0\x85", 7));
+    stream.append(Fec::encode(original));
+    stream.append(QByteArray(64, 0x5a));
+
+    FecDecoder decoder;
+    decoder.feed(stream);
+    QList<QByteArray> messages = decoder.takeMessages();
+    QCOMPARE(decoder.getUncorrectable(), quint32(1));
+    QVERIFY(!messages.isEmpty());
+    QCOMPARE(messages.at(0), original);
+}
+
+void tst_Fec::noiseBeforeFrames()
+{
+    /* Line noise before each frame: a false header in it must neither hold
+       back the real frame nor be delivered as a message. */
+    qsrand(1);
+    FecDecoder decoder;
+    for (int frame = 0; frame < 2000; ++frame) {
+        QByteArray stream;
+        int noise = qrand() % 64;
+        for (int i = 0; i < noise; ++i)
+            stream.append(char(qrand()));
+        QByteArray original = message(sizeof(GameControl));
+        original[0] = char(frame);
+        stream.append(Fec::encode(original));
+
+        decoder.feed(stream);
+        QList<QByteArray> messages = decoder.takeMessages();
+        QCOMPARE(messages.size(), 1);
+        QCOMPARE(messages.at(0), original);
+    }
+}
+
+void tst_Fec::corruptedSync()
+{
+    QByteArray encoded = Fec::encode(message(sizeof(GameControl)));
+    encoded[0] = encoded.at(0) ^ 0x01;
+
+    FecDecoder decoder;
+    decoder.feed(encoded);
+    QVERIFY(decoder.takeMessages().isEmpty());
+}
+
+void tst_Fec::encode_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::newRow("ClientInfo") << int(sizeof(ClientInfo));
+    QTest::newRow("GameControl") << int(sizeof(GameControl));
+    QTest::newRow("64 bytes") << 64;
+}
+
+void tst_Fec::encode()
+{
+    QFETCH(int, size);
+    QByteArray data = message(size);
+
+    QBENCHMARK {
+        Fec::encode(data);
+    }
+}
+
+void tst_Fec::decode_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("corrupt");
+    QTest::newRow("GameControl") << int(sizeof(GameControl)) << false;
+    QTest::newRow("GameControl, 1 bit error") << int(sizeof(GameControl)) << true;
+    QTest::newRow("64 bytes") << 64 << false;
+    QTest::newRow("64 bytes, 1 bit error") << 64 << true;
+}
+
+void tst_Fec::decode()
+{
+    QFETCH(int, size);
+    QFETCH(bool, corrupt);
+
+    QByteArray encoded = Fec::encode(message(size));
+    if (corrupt)
+        encoded[4] = encoded.at(4) ^ 0x10;
+
+    FecDecoder decoder;
+    QBENCHMARK {
+        decoder.feed(encoded);
+        decoder.takeMessages();
+    }
+}
+
+QTEST_MAIN(tst_Fec)
+
+#include "tst_fec.moc"
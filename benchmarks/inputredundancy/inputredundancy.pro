@@ -0,0 +1,10 @@
+TARGET = tst_inputredundancy
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += inputredundancy.h \
+            protocol.h
+SOURCES  += inputredundancy.cpp \
+            protocol.cpp \
+            tst_inputredundancy.cpp
+QT = core testlib
+CONFIG += release
@@ -0,0 +1,188 @@
+#include "inputredundancy.h"
+#include "protocol.h"
+#include <QtTest/QtTest>
+
+class tst_InputRedundancy : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_InputRedundancy(){}
+    ~tst_InputRedundancy(){}
+
+private slots:
+    void roundTrip();
+    void recoversLostFrames();
+    void rejectsBadCrc();
+    void suggestedDepth();
+    void sequenceWraparound();
+    void decode();
+
+private:
+    static ClientInfo command(int frame);
+    static bool sameCommands(const QList<ClientInfo> &inputs, int first, int count);
+};
+
+/* Moves far enough now and then that the delta needs an escape. */
+ClientInfo tst_InputRedundancy::command(int frame)
+{
+    ClientInfo info;
+    info.playerPos = (frame % 10 == 0) ? (frame * 37) % 371 : (frame * 3) % 371;
+    info.velocity  = 1 + (frame / 50) % 20;
+    return info;
+}
+
+/* inputs are the commands of frames first to first + count - 1, in order. */
+bool tst_InputRedundancy::sameCommands(const QList<ClientInfo> &inputs, int first, int count)
+{
+    if (inputs.size() != count)
+        return false;
+    for (int i = 0; i < count; ++i) {
+        ClientInfo expected = command(first + i);
+        if (inputs.at(i).playerPos != expected.playerPos || inputs.at(i).velocity != expected.velocity)
+            return false;
+    }
+    return true;
+}
+
+void tst_InputRedundancy::roundTrip()
+{
+    InputEncoder encoder;
+    encoder.setDepth(InputEncoder::MAX_DEPTH);
+    InputDecoder decoder;
+
+    for (int frame = 0; frame < 200; ++frame) {
+        decoder.feed(encoder.encode(command(frame)));
+        QVERIFY(sameCommands(decoder.takeInputs(), frame, 1));
+    }
+    QCOMPARE(decoder.getReceived(), quint32(200));
+    QCOMPARE(decoder.getRecovered(), quint32(0));
+    QCOMPARE(decoder.getLost(), quint32(0));
+    QCOMPARE(decoder.getLossRate(), 0.0);
+}
+
+/*
+  With K = 3, up to three frames in a row can be lost; a fourth is only
+  counted as lost.
+*/
+void tst_InputRedundancy::recoversLostFrames()
+{
+    InputEncoder encoder;
+    encoder.setDepth(3);
+    InputDecoder decoder;
+
+    for (int frame = 0; frame < 10; ++frame) {
+        QByteArray data = encoder.encode(command(frame));
+        if (frame < 7 || frame == 9)
+            decoder.feed(data);
+    }
+    QVERIFY(sameCommands(decoder.takeInputs(), 0, 10));
+    QCOMPARE(decoder.getRecovered(), quint32(2));
+    QCOMPARE(decoder.getLost(), quint32(0));
+
+    for (int frame = 10; frame < 20; ++frame) {
+        QByteArray data = encoder.encode(command(frame));
+        if (frame < 11 || frame > 14)
+            decoder.feed(data);
+    }
+    // frame 11 is gone for good, 12 to 14 come with frame 15
+    QList<ClientInfo> inputs = decoder.takeInputs();
+    QCOMPARE(inputs.size(), 9);
+    QVERIFY(sameCommands(inputs.mid(0, 1), 10, 1));
+    QVERIFY(sameCommands(inputs.mid(1), 12, 8));
+    QCOMPARE(decoder.getRecovered(), quint32(5));
+    QCOMPARE(decoder.getLost(), quint32(1));
+}
+
+void tst_InputRedundancy::rejectsBadCrc()
+{
+    InputEncoder encoder;
+    InputDecoder decoder;
+
+    decoder.feed(encoder.encode(command(0)));
+    QByteArray corrupted = encoder.encode(command(1));
+    corrupted[4] = corrupted.at(4) ^ 0x04;
+    decoder.feed(corrupted);
+    QCOMPARE(decoder.getCorrupted(), quint32(1));
+    QCOMPARE(decoder.getReceived(), quint32(1));
+
+    // the next frame carries the rejected command in its redundancy
+    decoder.feed(encoder.encode(command(2)));
+    QVERIFY(sameCommands(decoder.takeInputs(), 0, 3));
+    QCOMPARE(decoder.getRecovered(), quint32(1));
+}
+
+void tst_InputRedundancy::suggestedDepth()
+{
+    InputEncoder encoder;
+    InputDecoder decoder;
+    int frame = 0;
+
+    for (; frame < 64; ++frame)
+        decoder.feed(encoder.encode(command(frame)));
+    QCOMPARE(decoder.suggestedDepth(), 1);
+
+    // every other frame lost
+    for (; frame < 128; ++frame) {
+        QByteArray data = encoder.encode(command(frame));
+        if (frame % 2)
+            decoder.feed(data);
+    }
+    QVERIFY(decoder.getLossRate() > 0.4 && decoder.getLossRate() < 0.6);
+    QCOMPARE(decoder.suggestedDepth(), int(InputEncoder::MAX_DEPTH));
+
+    // one in five: p^(K+1) < 0.001 from K = 4
+    for (; frame < 288; ++frame) {
+        QByteArray data = encoder.encode(command(frame));
+        if (frame % 5)
+            decoder.feed(data);
+    }
+    QCOMPARE(decoder.suggestedDepth(), 4);
+
+    // the window forgets the losses
+    for (; frame < 352; ++frame)
+        decoder.feed(encoder.encode(command(frame)));
+    QCOMPARE(decoder.getLossRate(), 0.0);
+    QCOMPARE(decoder.suggestedDepth(), 1);
+}
+
+/*
+  The 8-bit sequence number wraps: losses across the wrap are still
+  recovered and nothing is taken for a late frame.
+*/
+void tst_InputRedundancy::sequenceWraparound()
+{
+    InputEncoder encoder;
+    encoder.setDepth(2);
+    InputDecoder decoder;
+
+    for (int frame = 0; frame < 600; ++frame) {
+        QByteArray data = encoder.encode(command(frame));
+        // lose 255 and 256, then 511
+        if (frame != 255 && frame != 256 && frame != 511)
+            decoder.feed(data);
+    }
+    QVERIFY(sameCommands(decoder.takeInputs(), 0, 600));
+    QCOMPARE(decoder.getRecovered(), quint32(3));
+    QCOMPARE(decoder.getLost(), quint32(0));
+    QCOMPARE(decoder.getReceived(), quint32(597));
+}
+
+void tst_InputRedundancy::decode()
+{
+    InputEncoder encoder;
+    encoder.setDepth(InputEncoder::MAX_DEPTH);
+    QByteArray stream;
+    for (int frame = 0; frame < 100; ++frame)
+        stream.append(encoder.encode(command(frame)));
+
+    QBENCHMARK {
+        InputDecoder decoder;
+        decoder.feed(stream);
+        decoder.takeInputs();
+    }
+}
+
+QTEST_MAIN(tst_InputRedundancy)
+
+#include "tst_inputredundancy.moc"
@@ -0,0 +1,8 @@
+TARGET = tst_iobackend
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+SOURCES  += tst_iobackend.cpp
+CONFIG += qextserialport-io_uring
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
+QT = core testlib
+CONFIG += release
@@ -0,0 +1,97 @@
+#include "qextserialport.h"
+#include "qextiothread_p.h"
+#include "protocol.h"
+#include <QtTest/QtTest>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+class tst_IoBackend : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanupTestCase();
+    void ports_data();
+    void ports();
+};
+
+static qint64 cpuUsecs(const struct rusage &usage)
+{
+    return qint64(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+            + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void tst_IoBackend::cleanupTestCase()
+{
+    QextIoThread::instance()->setBackend(QextIoThread::Epoll);
+}
+
+void tst_IoBackend::ports_data()
+{
+    QTest::addColumn<int>("backend");
+    QTest::addColumn<int>("count");
+    QTest::newRow("epoll, 8 ports") << int(QextIoThread::Epoll) << 8;
+    QTest::newRow("epoll, 64 ports") << int(QextIoThread::Epoll) << 64;
+    QTest::newRow("io_uring, 8 ports") << int(QextIoThread::IoUring) << 8;
+    QTest::newRow("io_uring, 64 ports") << int(QextIoThread::IoUring) << 64;
+}
+
+/*
+  One frame arrives on every port, through a pty each, and is read from all
+  of them; the I/O thread does the draining. Reports the CPU time and
+  context switches of the whole process per round. Run under
+  strace -c -f to count the system calls of each backend.
+*/
+void tst_IoBackend::ports()
+{
+    QFETCH(int, backend);
+    QFETCH(int, count);
+    if (!QextIoThread::instance()->setBackend(QextIoThread::Backend(backend)))
+        QSKIP("backend not available (kernel or build)", SkipSingle);
+
+    const int size = sizeof(GameControl);
+    QList<int> masters;
+    QList<QextSerialPort *> ports;
+    for (int i = 0; i < count; ++i) {
+        int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+        QVERIFY(master != -1);
+        QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+        masters.append(master);
+
+        QextSerialPort *port = new QextSerialPort(QString::fromLatin1(::ptsname(master)),
+                                                  QextSerialPort::IoThread);
+        QVERIFY(port->open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+        ports.append(port);
+    }
+
+    QByteArray out(size, 'x');
+    char frame[sizeof(GameControl)];
+    qint64 rounds = 0;
+    struct rusage before, after;
+    ::getrusage(RUSAGE_SELF, &before);
+    QBENCHMARK {
+        for (int i = 0; i < count; ++i)
+            QCOMPARE(::write(masters.at(i), out.constData(), size), ssize_t(size));
+        for (int i = 0; i < count; ++i) {
+            QextSerialPort *port = ports.at(i);
+            while (port->bytesAvailable() < size)
+                QVERIFY(port->waitForReadyRead(1000));
+            QCOMPARE(port->read(frame, size), qint64(size));
+        }
+        ++rounds;
+    }
+    ::getrusage(RUSAGE_SELF, &after);
+    qDebug("%.1f us CPU, %.2f voluntary context switches per round",
+           double(cpuUsecs(after) - cpuUsecs(before)) / rounds,
+           double(after.ru_nvcsw - before.ru_nvcsw) / rounds);
+
+    qDeleteAll(ports);
+    foreach (int master, masters)
+        ::close(master);
+}
+
+QTEST_MAIN(tst_IoBackend)
+
+#include "tst_iobackend.moc"
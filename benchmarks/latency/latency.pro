@@ -0,0 +1,7 @@
+TARGET = tst_latency
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+SOURCES  += tst_latency.cpp
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
+QT = core testlib
+CONFIG += release
@@ -0,0 +1,163 @@
+#include "qextserialport.h"
+#include "protocol.h"
+#include <QtTest/QtTest>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+  Writes one frame to the master side of a pty each time it is released, in
+  two halves 500 us apart, the way a slow link or a USB adapter delivers it.
+*/
+class FrameWriter : public QThread
+{
+public:
+    FrameWriter(int fd, int frameSize) : fd(fd), frameSize(frameSize), stop(false) {}
+
+    QSemaphore go;
+    bool stop;
+
+protected:
+    void run()
+    {
+        QByteArray frame(frameSize, 'x');
+        int half = frameSize / 2;
+        forever {
+            go.acquire();
+            if (stop)
+                return;
+            ::write(fd, frame.constData(), half);
+            usleep(500);
+            ::write(fd, frame.constData() + half, frameSize - half);
+        }
+    }
+
+private:
+    int fd;
+    int frameSize;
+};
+
+class tst_Latency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ptyFrame_data();
+    void ptyFrame();
+    void loopback_data();
+    void loopback();
+};
+
+/*
+  Reads one frame, returning the number of read calls it took.
+*/
+static int readFrame(QextSerialPort &port, char *frame, int size)
+{
+    int received = 0, calls = 0;
+    while (received < size) {
+        qint64 n = port.read(frame + received, size - received);
+        ++calls;
+        if (n < 0)
+            return -1;
+        received += n;
+    }
+    return calls;
+}
+
+void tst_Latency::ptyFrame_data()
+{
+    QTest::addColumn<int>("readMinimum");
+    QTest::newRow("VMIN 0, read until complete") << 0;
+    QTest::newRow("VMIN frame size") << int(sizeof(GameControl));
+}
+
+/*
+  Time from the first byte of a frame being written until the whole frame
+  has been read, through a pty.
+*/
+void tst_Latency::ptyFrame()
+{
+    QFETCH(int, readMinimum);
+    const int size = sizeof(GameControl);
+
+    int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    QVERIFY(master != -1);
+    QVERIFY(::grantpt(master) == 0 && ::unlockpt(master) == 0);
+
+    QextSerialPort port(QString::fromLatin1(::ptsname(master)), QextSerialPort::Polling);
+    port.setTimeout(1000);
+    port.setReadMinimum(readMinimum);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QCOMPARE(port.readMinimum(), readMinimum);
+
+    FrameWriter writer(master, size);
+    writer.start();
+
+    char frame[sizeof(GameControl)];
+    qint64 frames = 0, calls = 0;
+    QBENCHMARK {
+        writer.go.release();
+        int n = readFrame(port, frame, size);
+        QVERIFY(n > 0);
+        calls += n;
+        ++frames;
+    }
+    qDebug("%.2f read calls per frame", double(calls) / frames);
+
+    writer.stop = true;
+    writer.go.release();
+    writer.wait();
+    port.close();
+    ::close(master);
+}
+
+void tst_Latency::loopback_data()
+{
+    QTest::addColumn<bool>("lowLatency");
+    QTest::newRow("driver default") << false;
+    QTest::newRow("low latency") << true;
+}
+
+/*
+  Round trip of a frame through a real adapter with TX wired to RX, given
+  by TST_LATENCY_PORT (e.g. /dev/ttyUSB0 or /dev/ttyUSB0@1000000). Without
+  low latency, USB adapters hold the received bytes for up to 16 ms.
+*/
+void tst_Latency::loopback()
+{
+    QFETCH(bool, lowLatency);
+
+    QString name = QString::fromLocal8Bit(qgetenv("TST_LATENCY_PORT"));
+    if (name.isEmpty())
+        QSKIP("set TST_LATENCY_PORT to a port with a loopback plug", SkipAll);
+    int rate = 115200;
+    if (name.contains('@')) {
+        rate = name.mid(name.indexOf('@') + 1).toInt();
+        name = name.left(name.indexOf('@'));
+    }
+
+    const int size = sizeof(GameControl);
+    QextSerialPort port(name, QextSerialPort::Polling);
+    port.setBaudRate(BaudRateType(rate));
+    port.setFlowControl(FLOW_OFF);
+    port.setTimeout(1000);
+    port.setReadMinimum(size);
+    port.setLowLatency(lowLatency);
+    QVERIFY(port.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+    qDebug("%d baud, low latency accepted: %s", port.actualBaudRate(),
+           port.isLowLatency() ? "yes" : "no");
+
+    QByteArray out(size, 'x');
+    char frame[sizeof(GameControl)];
+    QBENCHMARK {
+        QCOMPARE(port.write(out), qint64(size));
+        QVERIFY(readFrame(port, frame, size) > 0);
+    }
+    port.close();
+}
+
+QTEST_MAIN(tst_Latency)
+
+#include "tst_latency.moc"
@@ -0,0 +1,44 @@
+TARGET = tst_linkloss
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += game.h \
+            ball.h \
+            player.h \
+            scoreboard.h \
+            globals.h \
+            protocol.h \
+            inputredundancy.h \
+            fec.h \
+            multiplexer.h \
+            transport.h \
+            serialtransport.h \
+            sockettransport.h \
+            blockbuffer.h \
+            localtransport.h \
+            bondedtransport.h \
+            broadcaster.h \
+            outputqueue.h
+SOURCES  += game.cpp \
+            ball.cpp \
+            player.cpp \
+            scoreboard.cpp \
+            protocol.cpp \
+            inputredundancy.cpp \
+            fec.cpp \
+            multiplexer.cpp \
+            transport.cpp \
+            serialtransport.cpp \
+            sockettransport.cpp \
+            blockbuffer.cpp \
+            localtransport.cpp \
+            bondedtransport.cpp \
+            broadcaster.cpp \
+            outputqueue.cpp \
+            tst_linkloss.cpp
+unix:HEADERS += ptytransport.h
+unix:SOURCES += ptytransport.cpp
+RESOURCES += ../../resources/pixmaps.qrc \
+             ../../resources/fonts.qrc
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
+QT = core gui network testlib
+CONFIG += release
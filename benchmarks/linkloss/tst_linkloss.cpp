@@ -0,0 +1,173 @@
+#include "game.h"
+#include <QtTest/QtTest>
+#include <QtCore/QThread>
+#include <QtNetwork/QUdpSocket>
+
+/* server: receives on 47101, sends to the relay on 47102 */
+static const char *SERVER_PORT = "udp:47101:47102";
+/* client: receives on 47103, sends to the relay on 47104 */
+static const char *CLIENT_PORT = "udp:47103:47104";
+
+static const int LINK_TIMEOUT = 1000;
+
+/*
+  Forwards the datagrams of the two games to each other, like the cable
+  between them. While cut, every datagram is dropped.
+*/
+class Relay : public QThread
+{
+public:
+    Relay() : cut(false), stop(false), firstToClient(-1) { clock.start(); }
+
+    bool cut;
+    bool stop;
+
+    /* time, on clock, of the first datagram sent to the client since the
+       link was restored (-1 until then) */
+    int firstToClient;
+
+    int elapsed() const { return clock.elapsed(); }
+
+    void restore()
+    {
+        firstToClient = -1;
+        cut = false;
+    }
+
+protected:
+    void run()
+    {
+        QUdpSocket toClient, toServer;
+        toClient.bind(QHostAddress::LocalHost, 47102);
+        toServer.bind(QHostAddress::LocalHost, 47104);
+
+        while (!stop) {
+            toClient.waitForReadyRead(5);
+            forward(toClient, 47103);
+            toServer.waitForReadyRead(5);
+            forward(toServer, 47101);
+        }
+    }
+
+private:
+    void forward(QUdpSocket &socket, quint16 port)
+    {
+        while (socket.hasPendingDatagrams()) {
+            QByteArray datagram(int(socket.pendingDatagramSize()), 0);
+            socket.readDatagram(datagram.data(), datagram.size());
+            if (cut)
+                continue;
+            socket.writeDatagram(datagram, QHostAddress::LocalHost, port);
+            if (47103 == port && firstToClient < 0)
+                firstToClient = clock.elapsed();
+        }
+    }
+
+    QTime clock;
+};
+
+/*
+  Records, on the relay clock, when the link state of a game changes.
+*/
+class LinkRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    LinkRecorder(const Relay *relay) : relay(relay) {}
+
+    QList<bool> states;
+    QList<int> times;
+
+public slots:
+    void linkStateChanged(bool connected)
+    {
+        states << connected;
+        times << relay->elapsed();
+    }
+
+private:
+    const Relay *relay;
+};
+
+class tst_LinkLoss : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_LinkLoss(){}
+    ~tst_LinkLoss(){}
+
+private slots:
+    void lossAndResync();
+};
+
+/*
+  Two games playing through the relay: the link is cut long enough for both
+  sides to reopen their sockets, then restored. The loss must be reported
+  only after the link timeout, and the client must resume play on the first
+  frame that reaches it after the link is back.
+*/
+void tst_LinkLoss::lossAndResync()
+{
+    Relay relay;
+    relay.start();
+
+    Game server, client;
+    server.setGameMode(Game::SERVER);
+    server.setPortName(SERVER_PORT);
+    server.setLinkTimeout(LINK_TIMEOUT);
+    client.setGameMode(Game::CLIENT);
+    client.setPortName(CLIENT_PORT);
+    client.setLinkTimeout(LINK_TIMEOUT);
+
+    LinkRecorder serverLink(&relay), clientLink(&relay);
+    connect(&server, SIGNAL(linkStateChanged(bool)), &serverLink, SLOT(linkStateChanged(bool)));
+    connect(&client, SIGNAL(linkStateChanged(bool)), &clientLink, SLOT(linkStateChanged(bool)));
+
+    server.readyToPlay();
+    client.readyToPlay();
+    QTRY_VERIFY(server.isPlaying());
+    QTest::qWait(500);
+    QVERIFY(clientLink.states.isEmpty());
+    QVERIFY(serverLink.states.isEmpty());
+
+    // cut: both sides stop receiving
+    int cutAt = relay.elapsed();
+    relay.cut = true;
+    QTRY_COMPARE(clientLink.states.size(), 1);
+    QCOMPARE(clientLink.states.at(0), false);
+    QVERIFY(clientLink.times.at(0) - cutAt >= LINK_TIMEOUT);
+    QVERIFY(clientLink.times.at(0) - cutAt < 2 * LINK_TIMEOUT);
+    QVERIFY(!client.isConnected());
+    QVERIFY(!client.isPlaying());
+    QTRY_COMPARE(serverLink.states.size(), 1);
+    QCOMPARE(serverLink.states.at(0), false);
+    QVERIFY(!server.isPlaying());
+
+    // keep it down across a few reconnect attempts
+    QTest::qWait(1500);
+    QCOMPARE(clientLink.states.size(), 1);
+
+    relay.restore();
+    QTRY_COMPARE(clientLink.states.size(), 2);
+    QCOMPARE(clientLink.states.at(1), true);
+    QVERIFY(relay.firstToClient >= 0);
+
+    /* the frame is read at most one tick of each game later: a client read
+       of up to 200 ms that it may have just missed, plus the server tick */
+    qDebug("resync %d ms after the first frame", clientLink.times.at(1) - relay.firstToClient);
+    QVERIFY(clientLink.times.at(1) - relay.firstToClient < 500);
+
+    QTRY_COMPARE(serverLink.states.size(), 2);
+    QCOMPARE(serverLink.states.at(1), true);
+    QTRY_VERIFY(server.isPlaying() && client.isPlaying());
+    QVERIFY(client.isConnected());
+
+    relay.stop = true;
+    relay.wait();
+}
+
+QTEST_MAIN(tst_LinkLoss)
+
+#include "tst_linkloss.moc"
@@ -0,0 +1,10 @@
+TARGET = tst_multiplexer
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += multiplexer.h \
+            protocol.h
+SOURCES  += multiplexer.cpp \
+            protocol.cpp \
+            tst_multiplexer.cpp
+QT = core testlib
+CONFIG += release
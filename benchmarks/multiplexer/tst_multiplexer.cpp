@@ -0,0 +1,179 @@
+#include "multiplexer.h"
+#include "protocol.h"
+#include <QtTest/QtTest>
+
+class tst_Multiplexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_Multiplexer(){}
+    ~tst_Multiplexer(){}
+
+private slots:
+    void gameChannelFirst();
+    void budgetAndCapacity();
+    void splitsAndReassembles();
+    void corruptSegment();
+    void sequenceGap();
+    void takeOutput();
+
+private:
+    static void addChannels(Multiplexer &mux);
+    static QByteArray message(int size, int seed);
+    static QByteArray join(const QList<QByteArray> &segments);
+};
+
+/* The channels as Game sets them up. */
+void tst_Multiplexer::addChannels(Multiplexer &mux)
+{
+    mux.addChannel(CHANNEL_GAME, 3);
+    mux.addChannel(CHANNEL_CHAT, 2, 32);
+    mux.addChannel(CHANNEL_TELEMETRY, 1, 32);
+    mux.addChannel(CHANNEL_BULK, 0);
+}
+
+QByteArray tst_Multiplexer::message(int size, int seed)
+{
+    QByteArray data;
+    for (int i = 0; i < size; ++i)
+        data.append(char(i * 37 + seed));
+    return data;
+}
+
+QByteArray tst_Multiplexer::join(const QList<QByteArray> &segments)
+{
+    QByteArray data;
+    for (int i = 0; i < segments.size(); ++i)
+        data.append(segments.at(i));
+    return data;
+}
+
+void tst_Multiplexer::gameChannelFirst()
+{
+    Multiplexer mux;
+    addChannels(mux);
+
+    // queued before the game message, still sent after it
+    QVERIFY(mux.enqueue(CHANNEL_BULK, message(300, 1)));
+    QVERIFY(mux.enqueue(CHANNEL_CHAT, message(10, 2)));
+    QVERIFY(mux.enqueue(CHANNEL_GAME, message(12, 3)));
+
+    QList<QByteArray> segments = mux.takeOutput(1000);
+    QVERIFY(segments.size() >= 3);
+    QCOMPARE((quint8) segments.at(0).at(1) >> 4, int(CHANNEL_GAME));
+    QCOMPARE((quint8) segments.at(1).at(1) >> 4, int(CHANNEL_CHAT));
+    for (int i = 2; i < segments.size(); ++i)
+        QCOMPARE((quint8) segments.at(i).at(1) >> 4, int(CHANNEL_BULK));
+}
+
+void tst_Multiplexer::budgetAndCapacity()
+{
+    Multiplexer mux;
+    addChannels(mux);
+    QVERIFY(mux.enqueue(CHANNEL_CHAT, message(400, 1)));
+    QVERIFY(mux.enqueue(CHANNEL_BULK, message(2000, 2)));
+
+    for (int tick = 0; tick < 10; ++tick) {
+        int chat = 0;
+        int total = 0;
+        QList<QByteArray> segments = mux.takeOutput(150);
+        for (int i = 0; i < segments.size(); ++i) {
+            total += segments.at(i).size();
+            if ((quint8) segments.at(i).at(1) >> 4 == CHANNEL_CHAT)
+                chat += segments.at(i).size();
+        }
+        QVERIFY(total <= 150);
+        QVERIFY(chat > 0 && chat <= 32);
+        QVERIFY(total > 150 - Multiplexer::MAX_SEGMENT - Multiplexer::OVERHEAD);
+    }
+    QVERIFY(mux.pendingBytes(CHANNEL_CHAT) > 0);
+}
+
+void tst_Multiplexer::splitsAndReassembles()
+{
+    Multiplexer mux;
+    addChannels(mux);
+    QByteArray bulk = message(1000, 1);
+    QByteArray chat = message(100, 2);
+    QVERIFY(mux.enqueue(CHANNEL_BULK, bulk));
+    QVERIFY(mux.enqueue(CHANNEL_CHAT, chat));
+
+    Demultiplexer demux;
+    int segments = 0;
+    for (int tick = 0; tick < 100 && (mux.pendingBytes(CHANNEL_BULK) > 0 || mux.pendingBytes(CHANNEL_CHAT) > 0); ++tick) {
+        QList<QByteArray> output = mux.takeOutput(120);
+        segments += output.size();
+        demux.feed(join(output));
+    }
+    QVERIFY(segments >= 1000 / Multiplexer::MAX_SEGMENT + 1);
+
+    QCOMPARE(demux.takeMessages(CHANNEL_BULK), QList<QByteArray>() << bulk);
+    QCOMPARE(demux.takeMessages(CHANNEL_CHAT), QList<QByteArray>() << chat);
+    QCOMPARE(demux.getDropped(), quint32(0));
+}
+
+/*
+  A segment with a bad CRC-8 loses its message; the decoder resyncs on the
+  next segment and the following message arrives whole.
+*/
+void tst_Multiplexer::corruptSegment()
+{
+    Multiplexer mux;
+    addChannels(mux);
+    QByteArray lost = message(200, 1);
+    QByteArray next = message(50, 2);
+    QVERIFY(mux.enqueue(CHANNEL_BULK, lost));
+    QVERIFY(mux.enqueue(CHANNEL_BULK, next));
+
+    QList<QByteArray> segments = mux.takeOutput(1000);
+    QVERIFY(segments.size() >= 4);
+    segments[1][6] = segments.at(1).at(6) ^ 0x10;
+
+    Demultiplexer demux;
+    demux.feed(join(segments));
+    QCOMPARE(demux.takeMessages(CHANNEL_BULK), QList<QByteArray>() << next);
+    QVERIFY(demux.getDropped() >= 2);
+}
+
+/*
+  A segment that never arrives: the message it belonged to is dropped, the
+  next one is not.
+*/
+void tst_Multiplexer::sequenceGap()
+{
+    Multiplexer mux;
+    addChannels(mux);
+    QByteArray lost = message(200, 1);
+    QByteArray next = message(50, 2);
+    QVERIFY(mux.enqueue(CHANNEL_BULK, lost));
+    QVERIFY(mux.enqueue(CHANNEL_BULK, next));
+
+    QList<QByteArray> segments = mux.takeOutput(1000);
+    QVERIFY(segments.size() >= 4);
+    segments.removeAt(1);
+
+    Demultiplexer demux;
+    demux.feed(join(segments));
+    QCOMPARE(demux.takeMessages(CHANNEL_BULK), QList<QByteArray>() << next);
+    QVERIFY(demux.getDropped() > 0);
+}
+
+void tst_Multiplexer::takeOutput()
+{
+    Multiplexer mux;
+    addChannels(mux);
+    QByteArray game = message(12, 1);
+    QByteArray bulk = message(4096, 2);
+
+    QBENCHMARK {
+        mux.enqueue(CHANNEL_GAME, game);
+        mux.enqueue(CHANNEL_BULK, bulk);
+        while (mux.pendingBytes(CHANNEL_BULK) > 0)
+            mux.takeOutput(200);
+    }
+}
+
+QTEST_MAIN(tst_Multiplexer)
+
+#include "tst_multiplexer.moc"
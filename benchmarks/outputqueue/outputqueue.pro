@@ -0,0 +1,25 @@
+TARGET = tst_outputqueue
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += outputqueue.h \
+            transport.h \
+            serialtransport.h \
+            sockettransport.h \
+            blockbuffer.h \
+            localtransport.h \
+            bondedtransport.h \
+            protocol.h
+SOURCES  += outputqueue.cpp \
+            transport.cpp \
+            serialtransport.cpp \
+            sockettransport.cpp \
+            blockbuffer.cpp \
+            localtransport.cpp \
+            bondedtransport.cpp \
+            protocol.cpp \
+            tst_outputqueue.cpp
+unix:HEADERS += ptytransport.h
+unix:SOURCES += ptytransport.cpp
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
+QT = core network testlib
+CONFIG += release
@@ -0,0 +1,239 @@
+#include "outputqueue.h"
+#include "transport.h"
+#ifdef Q_OS_UNIX
+# include "ptytransport.h"
+#endif
+#include <QtTest/QtTest>
+
+/*
+  Transport that only counts the write calls it receives, standing in for
+  the write()/writev() system calls of a real port.
+*/
+class CountingTransport : public Transport
+{
+public:
+    CountingTransport() : calls(0), bytes(0) {}
+
+    bool open() { return true; }
+    void close() {}
+    bool isOpen() const { return true; }
+
+    qint64 write(const QByteArray &data) { ++calls; bytes += data.size(); return data.size(); }
+    qint64 writev(const QList<QByteArray> &buffers)
+    {
+        ++calls;
+        qint64 size = 0;
+        for (int i = 0; i < buffers.size(); ++i)
+            size += buffers.at(i).size();
+        bytes += size;
+        return size;
+    }
+    QByteArray read(qint64) { return QByteArray(); }
+    QByteArray readAll() { return QByteArray(); }
+    qint64 bytesAvailable() { return 0; }
+
+    int calls;
+    qint64 bytes;
+};
+
+class tst_OutputQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_OutputQueue(){}
+    ~tst_OutputQueue(){}
+
+private slots:
+    void writesPerSecond_data();
+    void writesPerSecond();
+    void keepsPartialWrites();
+    void dropsStaleFrames();
+    void boundsQueue();
+#ifdef Q_OS_UNIX
+    void ptyWrite_data();
+    void ptyWrite();
+#endif
+};
+
+void tst_OutputQueue::writesPerSecond_data()
+{
+    QTest::addColumn<int>("tickRate");
+    QTest::addColumn<int>("latencyCap");
+    QTest::addColumn<int>("expected");
+
+    // game, chat and telemetry segments every tick
+    QTest::newRow("20 Hz, one write per frame") << 20 << -1 << 60;
+    QTest::newRow("20 Hz, batched per tick") << 20 << 0 << 20;
+    QTest::newRow("100 Hz, one write per frame") << 100 << -1 << 300;
+    QTest::newRow("100 Hz, batched per tick") << 100 << 0 << 100;
+    QTest::newRow("100 Hz, 10 ms cap") << 100 << 10 << 50;
+    QTest::newRow("100 Hz, 20 ms cap") << 100 << 20 << 33;
+}
+
+/*
+  Simulates one second of ticks and reports the write calls issued.
+  The latency cap is applied on the simulated clock, so the count does not
+  depend on the speed of the machine.
+*/
+void tst_OutputQueue::writesPerSecond()
+{
+    QFETCH(int, tickRate);
+    QFETCH(int, latencyCap);
+    QFETCH(int, expected);
+
+    CountingTransport transport;
+    OutputQueue queue(&transport);
+    queue.setLatencyCap(60 * 60 * 1000);
+
+    QByteArray frame(12, 'x');
+    int tick = 1000 / tickRate;
+    int waited = 0;
+    for (int t = 0; t < tickRate; ++t) {
+        for (int segment = 0; segment < 3; ++segment) {
+            if (latencyCap < 0)
+                transport.write(frame);
+            else
+                queue.enqueue(frame);
+        }
+        if (latencyCap >= 0 && waited >= latencyCap) {
+            queue.flush(true);
+            waited = 0;
+        }
+        else {
+            waited += tick;
+        }
+    }
+
+    qDebug("%d write calls per second", transport.calls);
+    QCOMPARE(transport.calls, expected);
+}
+
+void tst_OutputQueue::keepsPartialWrites()
+{
+    class ShortTransport : public CountingTransport
+    {
+    public:
+        qint64 writev(const QList<QByteArray> &buffers)
+        {
+            CountingTransport::writev(buffers);
+            return 5;
+        }
+    };
+
+    ShortTransport transport;
+    OutputQueue queue(&transport);
+    queue.enqueue(QByteArray(4, 'a'));
+    queue.enqueue(QByteArray(4, 'b'));
+
+    QVERIFY(queue.flush());
+    QCOMPARE(queue.pendingBytes(), 3);
+    QCOMPARE(queue.getFramesWritten(), quint64(1));
+    QVERIFY(queue.flush());
+    QCOMPARE(queue.pendingBytes(), 0);
+    QCOMPARE(queue.getFramesWritten(), quint64(2));
+}
+
+/*
+  Transport that accepts nothing while stalled, like a port with lost CTS.
+*/
+class StalledTransport : public CountingTransport
+{
+public:
+    StalledTransport() : stalled(true) {}
+
+    qint64 writev(const QList<QByteArray> &buffers)
+    {
+        if (stalled) {
+            ++calls;
+            return 0;
+        }
+        return CountingTransport::writev(buffers);
+    }
+
+    bool stalled;
+};
+
+void tst_OutputQueue::dropsStaleFrames()
+{
+    StalledTransport transport;
+    OutputQueue queue(&transport);
+    queue.setLatencyCap(10);
+    queue.setMaxAge(50);
+
+    queue.enqueue(QByteArray(4, 'a'));
+    queue.enqueue(QByteArray(4, 'b'));
+    QTest::qSleep(20);
+    QVERIFY(queue.flush());
+    QCOMPARE(queue.pendingBytes(), 8);
+
+    // the sink stays stalled past the limit: the old state is not sent late
+    QTest::qSleep(60);
+    queue.enqueue(QByteArray(4, 'c'));
+    transport.stalled = false;
+    queue.flush(true);
+    QCOMPARE(queue.getFramesDropped(), quint64(2));
+    QCOMPARE(queue.getFramesWritten(), quint64(1));
+    QCOMPARE(transport.bytes, qint64(4));
+    QCOMPARE(queue.pendingBytes(), 0);
+}
+
+void tst_OutputQueue::boundsQueue()
+{
+    StalledTransport transport;
+    OutputQueue queue(&transport);
+    queue.setMaxAge(60 * 60 * 1000);
+
+    QByteArray frame(100, 'x');
+    for (int i = 0; i < 2 * OutputQueue::MAX_QUEUED / frame.size(); ++i) {
+        queue.enqueue(frame);
+        queue.flush();
+    }
+    QVERIFY(queue.pendingBytes() <= OutputQueue::MAX_QUEUED);
+    QVERIFY(queue.getFramesDropped() > 0);
+
+    queue.clear();
+    QCOMPARE(queue.pendingBytes(), 0);
+}
+
+#ifdef Q_OS_UNIX
+void tst_OutputQueue::ptyWrite_data()
+{
+    QTest::addColumn<bool>("batched");
+    QTest::newRow("write per frame") << false;
+    QTest::newRow("writev per tick") << true;
+}
+
+/*
+  Cost of sending one tick worth of segments (4 x 16 bytes) through a real
+  pty, one write() per frame versus a single writev().
+*/
+void tst_OutputQueue::ptyWrite()
+{
+    QFETCH(bool, batched);
+
+    PtyTransport master;
+    QVERIFY(master.open());
+    PtyTransport slave(master.getSlaveName());
+    slave.setTimeout(-1);
+    QVERIFY(slave.open());
+
+    OutputQueue queue(&master);
+    QByteArray frame(16, 'x');
+
+    QBENCHMARK {
+        for (int i = 0; i < 4; ++i) {
+            if (batched)
+                queue.enqueue(frame);
+            else
+                master.write(frame);
+        }
+        queue.flush();
+        slave.readAll();
+    }
+}
+#endif
+
+QTEST_MAIN(tst_OutputQueue)
+
+#include "tst_outputqueue.moc"
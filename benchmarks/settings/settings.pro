@@ -0,0 +1,5 @@
+TARGET = tst_settings
+SOURCES  += tst_settings.cpp
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
+QT = core testlib
+CONFIG += release
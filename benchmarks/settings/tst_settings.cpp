@@ -0,0 +1,113 @@
+#include "qextserialport.h"
+#include <QtTest/QtTest>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QThread>
+
+/*
+  What the getters of QextSerialPort did before the settings snapshot: take
+  the port lock for reading around every access.
+*/
+class LockedSettings
+{
+public:
+    LockedSettings() { settings.BaudRate = BAUD9600; }
+
+    BaudRateType baudRate() const
+    {
+        QReadLocker locker(&lock);
+        return settings.BaudRate;
+    }
+
+    void setBaudRate(BaudRateType rate)
+    {
+        QWriteLocker locker(&lock);
+        settings.BaudRate = rate;
+    }
+
+private:
+    mutable QReadWriteLock lock;
+    PortSettings settings;
+};
+
+/*
+  Changes the baud rate over and over, as a configuration thread would
+  while the I/O thread keeps reading the settings.
+*/
+class SettingsWriter : public QThread
+{
+public:
+    SettingsWriter(QextSerialPort *port, LockedSettings *locked)
+        : port(port), locked(locked), stop(0) {}
+
+    QAtomicInt stop;
+
+protected:
+    void run()
+    {
+        bool fast = false;
+        while (!stop.fetchAndAddRelaxed(0)) {
+            BaudRateType rate = fast ? BAUD115200 : BAUD9600;
+            if (port)
+                port->setBaudRate(rate);
+            else
+                locked->setBaudRate(rate);
+            fast = !fast;
+            yieldCurrentThread();
+        }
+    }
+
+private:
+    QextSerialPort *port;
+    LockedSettings *locked;
+};
+
+class tst_Settings : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void getter_data();
+    void getter();
+};
+
+void tst_Settings::getter_data()
+{
+    QTest::addColumn<bool>("snapshot");
+    QTest::addColumn<bool>("writer");
+    QTest::newRow("read lock") << false << false;
+    QTest::newRow("read lock, concurrent writer") << false << true;
+    QTest::newRow("snapshot") << true << false;
+    QTest::newRow("snapshot, concurrent writer") << true << true;
+}
+
+/*
+  Cost of 1000 calls to baudRate(), alone and with another thread changing
+  the settings at the same time.
+*/
+void tst_Settings::getter()
+{
+    QFETCH(bool, snapshot);
+    QFETCH(bool, writer);
+
+    QextSerialPort port(QLatin1String("/dev/null"), QextSerialPort::Polling);
+    LockedSettings locked;
+    SettingsWriter thread(snapshot ? &port : 0, snapshot ? 0 : &locked);
+    if (writer)
+        thread.start();
+
+    int fast = 0;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            BaudRateType rate = snapshot ? port.baudRate() : locked.baudRate();
+            fast += (rate == BAUD115200);
+        }
+    }
+    QVERIFY(fast >= 0);
+
+    thread.stop.fetchAndStoreRelaxed(1);
+    thread.wait();
+}
+
+QTEST_MAIN(tst_Settings)
+
+#include "tst_settings.moc"
@@ -0,0 +1,166 @@
+#include "transport.h"
+#ifdef Q_OS_UNIX
+# include "ptytransport.h"
+#endif
+#include "protocol.h"
+#include <QtTest/QtTest>
+
+class tst_Transport : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_Transport(){}
+    ~tst_Transport(){}
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void throughput_data();
+    void throughput();
+    void peekAfterReconnect();
+
+private:
+    static void addRows();
+    static bool openPair(const QString &kind, Transport *&a, Transport *&b);
+};
+
+void tst_Transport::addRows()
+{
+    QTest::addColumn<QString>("kind");
+    QTest::newRow("local") << QString("local");
+#ifdef Q_OS_UNIX
+    QTest::newRow("pty") << QString("pty");
+#endif
+    QTest::newRow("udp") << QString("udp");
+    QTest::newRow("tcp") << QString("tcp");
+
+    // serial ports given by the environment, e.g. the two ends of linkemu,
+    // at the game's rate and at custom rates of USB adapters
+    if (qgetenv("TST_TRANSPORT_PORTS").contains(',')) {
+        static const int rates[] = { 57600, 250000, 1000000, 2000000, 3000000 };
+        for (unsigned i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+            QString row = QString("serial@%1").arg(rates[i]);
+            QTest::newRow(row.toLatin1()) << row;
+        }
+    }
+}
+
+/*
+  Opens both ends of a link and waits until a byte goes through in each
+  direction, so the connection setup is not part of the measurement.
+*/
+bool tst_Transport::openPair(const QString &kind, Transport *&a, Transport *&b)
+{
+    if (kind == "local") {
+        a = Transport::create("local:tst_transport");
+        b = Transport::create("local:tst_transport");
+    }
+#ifdef Q_OS_UNIX
+    else if (kind == "pty") {
+        PtyTransport *master = new PtyTransport();
+        a = master;
+        if (!a->open())
+            return false;
+        b = new PtyTransport(master->getSlaveName());
+    }
+#endif
+    else if (kind == "udp") {
+        a = Transport::create("udp:45100:45101");
+        b = Transport::create("udp:45101:45100");
+    }
+    else if (kind.startsWith("serial@")) {
+        QString rate = kind.mid(kind.indexOf('@'));
+        QList<QByteArray> ports = qgetenv("TST_TRANSPORT_PORTS").split(',');
+        a = Transport::create(ports.at(0) + rate);
+        b = Transport::create(ports.at(1) + rate);
+    }
+    else {
+        a = Transport::create("tcp-listen:45102");
+        b = Transport::create("tcp:45102");
+    }
+
+    if ((!a->isOpen() && !a->open()) || !b->open())
+        return false;
+
+    for (int i = 0; i < 100 && b->write(QByteArray(1, 'b')) <= 0; ++i)
+        QTest::qWait(10);
+    if (a->read(1).size() != 1 || a->write(QByteArray(1, 'a')) != 1)
+        return false;
+    return b->read(1).size() == 1;
+}
+
+void tst_Transport::roundTrip_data()
+{
+    addRows();
+}
+
+void tst_Transport::roundTrip()
+{
+    QFETCH(QString, kind);
+
+    Transport *a = 0, *b = 0;
+    QVERIFY(openPair(kind, a, b));
+
+    QByteArray frame(sizeof(GameControl), 'x');
+    QBENCHMARK {
+        a->write(frame);
+        QCOMPARE(b->read(frame.size()).size(), frame.size());
+        b->write(frame);
+        QCOMPARE(a->read(frame.size()).size(), frame.size());
+    }
+
+    delete a;
+    delete b;
+}
+
+void tst_Transport::throughput_data()
+{
+    addRows();
+}
+
+void tst_Transport::throughput()
+{
+    QFETCH(QString, kind);
+
+    Transport *a = 0, *b = 0;
+    QVERIFY(openPair(kind, a, b));
+
+    // 16 frames per iteration, read back as a single block
+    QByteArray frame(64, 'x');
+    QBENCHMARK {
+        for (int i = 0; i < 16; ++i)
+            a->write(frame);
+        QCOMPARE(b->read(16 * frame.size()).size(), 16 * frame.size());
+    }
+
+    delete a;
+    delete b;
+}
+
+/*
+  The start of a message peeked before the link was reopened must not be
+  joined to the bytes that arrive afterwards.
+*/
+void tst_Transport::peekAfterReconnect()
+{
+    Transport *a = 0, *b = 0;
+    QVERIFY(openPair("udp", a, b));
+
+    a->write(QByteArray(3, 'o'));
+    QVERIFY(b->peek(8) == 0);
+
+    QVERIFY(b->reconnect());
+    a->write(QByteArray(8, 'n'));
+    const char *message = b->peek(8);
+    QVERIFY(message != 0);
+    QCOMPARE(QByteArray(message, 8), QByteArray(8, 'n'));
+    b->consume(8);
+
+    delete a;
+    delete b;
+}
+
+QTEST_MAIN(tst_Transport)
+
+#include "tst_transport.moc"
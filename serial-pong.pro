@@ -9,7 +9,7 @@ include(3rdparty/qextserialport/src/qextserialport.pri)
 
 CONFIG += qt release
 
-QT += core gui
+QT += core gui network
 
 TARGET = serial-pong
 TEMPLATE = app
@@ -20,7 +20,19 @@ SOURCES += src/main.cpp\
            src/gameoptions.cpp \
            src/game.cpp \
            src/scoreboard.cpp \
-           src/player.cpp
+           src/player.cpp \
+           src/protocol.cpp \
+           src/inputredundancy.cpp \
+           src/fec.cpp \
+           src/multiplexer.cpp \
+           src/transport.cpp \
+           src/serialtransport.cpp \
+           src/sockettransport.cpp \
+           src/blockbuffer.cpp \
+           src/localtransport.cpp \
+           src/bondedtransport.cpp \
+           src/broadcaster.cpp \
+           src/outputqueue.cpp
 
 HEADERS += src/mainwindow.h \
            src/ball.h \
@@ -28,7 +40,22 @@ HEADERS += src/mainwindow.h \
            src/globals.h \
            src/game.h \
            src/scoreboard.h \
-           src/player.h
+           src/player.h \
+           src/protocol.h \
+           src/inputredundancy.h \
+           src/fec.h \
+           src/multiplexer.h \
+           src/transport.h \
+           src/serialtransport.h \
+           src/sockettransport.h \
+           src/blockbuffer.h \
+           src/localtransport.h \
+           src/bondedtransport.h \
+           src/broadcaster.h \
+           src/outputqueue.h
+
+unix:SOURCES += src/ptytransport.cpp
+unix:HEADERS += src/ptytransport.h
 
 FORMS += src/mainwindow.ui \
          src/gameoptions.ui
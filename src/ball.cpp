@@ -129,6 +129,15 @@ float Ball::getAngle (){
     return this->angle;
 }
 
+/**
+ * Deslocamento da bola no próximo quadro, considerando o ângulo e a velocidade
+ * atuais (o mesmo utilizado em Ball::advance).
+ */
+QPointF Ball::getVelocity() const
+{
+    return QPointF( cos( this->angle ) * this->speed, -sin( this->angle ) * this->speed );
+}
+
 /**
  * Método utilizado para mover a bola.
  *
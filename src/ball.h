@@ -24,6 +24,7 @@ public:
     void resetAngle();
     void setAngle(int i, int j);
     float getAngle ();
+    QPointF getVelocity() const;
 
     void setGoals( int top, int bottom, int width );
 
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "blockbuffer.h"
+
+/**
+ * Cria a fila vazia, sem nenhum bloco.
+ */
+BlockBuffer::BlockBuffer()
+{
+    this->bytes = 0;
+}
+
+/**
+ * Destrutor. Libera todos os blocos, inclusive os da reserva.
+ */
+BlockBuffer::~BlockBuffer()
+{
+    for ( int i = 0; i < this->blocks.size(); i++ ) {
+        free( this->blocks.at( i ) );
+    }
+    for ( int i = 0; i < this->spare.size(); i++ ) {
+        free( this->spare.at( i ) );
+    }
+}
+
+/**
+ * Retorna espaço contíguo para @a size bytes no fim da fila. Os bytes escritos
+ * nele só entram na fila com BlockBuffer::commit.
+ *
+ * Se o último bloco não tem espaço, um novo bloco é usado. Um pedido maior que
+ * BLOCK_SIZE recebe um bloco só para ele, que não volta para a reserva.
+ */
+char * BlockBuffer::reserve( int size )
+{
+    if ( !this->blocks.isEmpty() ) {
+        Block * last = this->blocks.last();
+        if ( last->capacity - last->end >= size ) {
+            return last->data + last->end;
+        }
+    }
+
+    Block * block = this->takeBlock( qMax( size, (int) BLOCK_SIZE ) );
+    this->blocks.append( block );
+    return block->data;
+}
+
+/**
+ * Acrescenta à fila @a size bytes escritos no espaço de BlockBuffer::reserve.
+ */
+void BlockBuffer::commit( int size )
+{
+    this->blocks.last()->end += size;
+    this->bytes += size;
+}
+
+/**
+ * Acrescenta @a size bytes no fim da fila, completando o último bloco antes de
+ * usar o próximo.
+ */
+void BlockBuffer::append( const char * data, int size )
+{
+    while ( size > 0 ) {
+        int room = 0;
+        if ( !this->blocks.isEmpty() ) {
+            room = this->blocks.last()->capacity - this->blocks.last()->end;
+        }
+        int chunk = ( room > 0 ) ? qMin( room, size ) : qMin( size, (int) BLOCK_SIZE );
+
+        memcpy( this->reserve( chunk ), data, chunk );
+        this->commit( chunk );
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+/**
+ * Número de bytes na fila.
+ */
+qint64 BlockBuffer::size() const
+{
+    return this->bytes;
+}
+
+bool BlockBuffer::isEmpty() const
+{
+    return 0 == this->bytes;
+}
+
+/**
+ * Retira até @a maxSize bytes do início da fila, copiando-os para @a data.
+ *
+ * @return O número de bytes copiados.
+ */
+int BlockBuffer::read( char * data, int maxSize )
+{
+    int total = 0;
+    while ( total < maxSize && !this->blocks.isEmpty() ) {
+        Block * first = this->blocks.first();
+        int size = qMin( first->end - first->begin, maxSize - total );
+
+        memcpy( data + total, first->data + first->begin, size );
+        first->begin += size;
+        total        += size;
+
+        if ( first->begin == first->end ) {
+            this->blocks.removeFirst();
+            this->releaseBlock( first );
+        }
+    }
+
+    this->bytes -= total;
+    return total;
+}
+
+/**
+ * @overload
+ */
+QByteArray BlockBuffer::read( qint64 maxSize )
+{
+    QByteArray data;
+    data.resize( (int) qMin( maxSize, this->bytes ) );
+    this->read( data.data(), data.size() );
+    return data;
+}
+
+/**
+ * Esvazia a fila. Os blocos voltam para a reserva.
+ */
+void BlockBuffer::clear()
+{
+    while ( !this->blocks.isEmpty() ) {
+        this->releaseBlock( this->blocks.takeFirst() );
+    }
+    this->bytes = 0;
+}
+
+/**
+ * Um bloco vazio de pelo menos @a capacity bytes, da reserva se possível.
+ */
+BlockBuffer::Block * BlockBuffer::takeBlock( int capacity )
+{
+    Block * block;
+    if ( BLOCK_SIZE == capacity && !this->spare.isEmpty() ) {
+        block = this->spare.takeLast();
+    }
+    else {
+        block = (Block *) malloc( sizeof( Block ) + capacity );
+        block->capacity = capacity;
+    }
+
+    block->begin = 0;
+    block->end   = 0;
+    return block;
+}
+
+/**
+ * Devolve um bloco esvaziado para a reserva, ou o libera se a reserva já tem
+ * blocos suficientes para um pico de tráfego.
+ */
+void BlockBuffer::releaseBlock( Block * block )
+{
+    if ( BLOCK_SIZE == block->capacity && this->spare.size() < MAX_SPARE ) {
+        this->spare.append( block );
+    }
+    else {
+        free( block );
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef BLOCKBUFFER_H
+#define BLOCKBUFFER_H
+
+#include <QByteArray>
+#include <QList>
+
+/**
+ * @class BlockBuffer blockbuffer.h "blockbuffer.h"
+ * Fila de bytes em uma cadeia de blocos de tamanho fixo.
+ *
+ * Os bytes entram no fim do último bloco e saem do início do primeiro; nenhum
+ * byte já guardado é movido, então acrescentar e retirar custam o mesmo com
+ * qualquer quantidade acumulada (por exemplo quando o jogo fica parado e os
+ * dados se acumulam). Os blocos esvaziados voltam para uma reserva e são
+ * reutilizados: com o volume de dados estável, não há alocação de memória.
+ */
+class BlockBuffer
+{
+public:
+    static const int BLOCK_SIZE = 4096;
+    static const int MAX_SPARE  = 16;
+
+    BlockBuffer();
+    ~BlockBuffer();
+
+    char * reserve( int size );
+    void   commit( int size );
+    void   append( const char * data, int size );
+
+    qint64     size() const;
+    bool       isEmpty() const;
+    int        read( char * data, int maxSize );
+    QByteArray read( qint64 maxSize );
+    void       clear();
+
+private:
+    struct Block {
+        int  begin;     // primeiro byte não lido
+        int  end;       // fim dos bytes escritos
+        int  capacity;
+        char data[1];   // capacity bytes
+    };
+
+    QList<Block *> blocks;
+    QList<Block *> spare;   // blocos vazios de BLOCK_SIZE bytes, para reutilizar
+    qint64         bytes;
+
+    Block * takeBlock( int capacity );
+    void    releaseBlock( Block * block );
+
+    BlockBuffer( const BlockBuffer & );
+    BlockBuffer & operator=( const BlockBuffer & );
+};
+
+#endif // BLOCKBUFFER_H
@@ -0,0 +1,654 @@
+#include <QDateTime>
+
+#include "bondedtransport.h"
+#include "protocol.h"
+
+// tamanho do segmento que inicia uma nova numeração (o campo seq leva o
+// identificador da sessão)
+static const quint8 SEGMENT_RESET = 0xff;
+
+// taxa considerada para os links sem taxa conhecida: a padrão do jogo
+static const int DEFAULT_BYTE_RATE = 57600 / 10;
+
+/**
+ * Diferença entre dois números de sequência, considerando a volta de 65535
+ * para 0.
+ */
+static inline int distance( quint16 a, quint16 b )
+{
+    return (qint16) (quint16) ( a - b );
+}
+
+static QByteArray makeSegment( quint16 seq, quint8 len, const char * data = NULL )
+{
+    int size = ( SEGMENT_RESET == len ) ? 0 : len;
+
+    QByteArray segment;
+    segment.reserve( size + BondedTransport::OVERHEAD );
+    segment.append( (char) FRAME_SYNC );
+    segment.append( (char) ( seq >> 8 ) );
+    segment.append( (char) ( seq & 0xff ) );
+    segment.append( (char) len );
+    segment.append( data, size );
+    segment.append( (char) crc8( segment.constData() + 1, segment.size() - 1 ) );
+    return segment;
+}
+
+/**
+ * Cria o meio. Os links só são abertos em BondedTransport::open.
+ *
+ * @param links Os meios entre os quais o fluxo é dividido. Passam a pertencer
+ *              a este objeto.
+ */
+BondedTransport::BondedTransport( const QList<Transport *> & links )
+{
+    for ( int i = 0; i < links.size(); i++ ) {
+        Link link;
+        link.transport = links.at( i );
+        link.failed    = false;
+        link.offset    = 0;
+        link.queued    = 0;
+        link.load      = 0;
+        link.bytesSent = 0;
+        link.passed    = 0xffff;
+        this->links.append( link );
+    }
+    this->nextSeq     = 0;
+    this->expected    = 0;
+    this->synced      = false;
+    this->session     = 0;
+    this->peerSession = 0;
+    this->lost        = 0;
+}
+
+/**
+ * Destrutor. Fecha e destrói os links.
+ */
+BondedTransport::~BondedTransport()
+{
+    this->close();
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        delete this->links.at( i ).transport;
+    }
+}
+
+/**
+ * Abre os links que ainda não estão abertos, sem espera, e inicia uma nova
+ * numeração dos segmentos, anunciada ao outro lado por todos os links.
+ *
+ * @return true se ao menos um link foi aberto.
+ */
+bool BondedTransport::open()
+{
+    this->nextSeq     = 0;
+    this->expected    = 0;
+    this->synced      = false;
+    this->peerSession = 0;
+    this->held.clear();
+    this->stream.clear();
+    this->session = (quint16) ( QDateTime::currentMSecsSinceEpoch() % 0xffff + 1 );
+
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        Link & link = this->links[i];
+        link.transport->setTimeout( -1 );
+        link.failed = !link.transport->isOpen() && !link.transport->open();
+        link.queue.clear();
+        link.offset = 0;
+        link.queued = 0;
+        link.load   = 0;
+        link.input.clear();
+        link.passed = 0xffff;
+        link.lastSent.start();
+        link.lastRetry.start();
+        link.lastReceived.start();
+
+        if ( !link.failed ) {
+            link.queue.append( makeSegment( this->session, SEGMENT_RESET ) );
+            link.queued = link.queue.first().size();
+        }
+    }
+
+    this->flush();
+    return this->isOpen();
+}
+
+void BondedTransport::close()
+{
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        Link & link = this->links[i];
+        link.transport->close();
+        link.failed = false;
+        link.queue.clear();
+        link.offset = 0;
+        link.queued = 0;
+        link.input.clear();
+    }
+    this->held.clear();
+    this->stream.clear();
+    this->clearPeeked();
+}
+
+/**
+ * O meio está aberto enquanto houver um link em que a escrita não falhou.
+ */
+bool BondedTransport::isOpen() const
+{
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        if ( !this->links.at( i ).failed && this->links.at( i ).transport->isOpen() ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reabre os links que falharam ou em que nada chega há mais de
+ * BondedTransport::LINK_TIMEOUT milissegundos. A numeração dos segmentos
+ * continua, já que o outro lado não foi necessariamente reaberto.
+ */
+bool BondedTransport::reconnect()
+{
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        Link & link = this->links[i];
+        if ( link.failed || !link.transport->isOpen() || link.lastReceived.elapsed() > LINK_TIMEOUT ) {
+            link.failed = !link.transport->reconnect();
+            link.lastRetry.start();
+            link.input.clear();
+        }
+    }
+    return this->isOpen();
+}
+
+/**
+ * Divide os bytes em segmentos, distribui os segmentos entre os links e
+ * escreve o que cada link aceitar sem bloquear. O restante fica na fila do
+ * link para as próximas chamadas, até BondedTransport::MAX_BACKLOG bytes por
+ * link.
+ *
+ * @return O número de bytes aceitos (menos que o tamanho de @a data se as
+ *         filas de todos os links estão cheias), ou -1 se nenhum link pode
+ *         ser usado.
+ */
+qint64 BondedTransport::write( const QByteArray & data )
+{
+    this->retry();
+
+    int pos = 0;
+    while ( pos < data.size() ) {
+        int link = this->pickLink();
+        if ( link < 0 ) {
+            break;
+        }
+
+        int len = qMin( data.size() - pos, (int) MAX_SEGMENT );
+        this->enqueue( link, makeSegment( this->nextSeq++, len, data.constData() + pos ) );
+        pos += len;
+    }
+
+    this->flush();
+    return ( pos > 0 || this->isOpen() ) ? pos : -1;
+}
+
+/**
+ * Lê até @a maxSize bytes, já na ordem em que foram escritos, aguardando no
+ * máximo o tempo limite configurado.
+ *
+ * A espera é feita na leitura dos próprios links, um de cada vez, por até
+ * BondedTransport::WAIT_SLICE milissegundos cada.
+ */
+QByteArray BondedTransport::read( qint64 maxSize )
+{
+    QTime elapsed;
+    elapsed.start();
+
+    this->receive();
+    for ( int turn = 0; this->stream.size() < maxSize; turn++ ) {
+        int remaining = this->timeout - elapsed.elapsed();
+        if ( remaining <= 0 || !this->waitLink( turn, remaining ) ) {
+            break;
+        }
+
+        // mantém os keepalives enquanto espera
+        this->flush();
+        this->receive();
+    }
+
+    return this->stream.read( maxSize );
+}
+
+QByteArray BondedTransport::readAll()
+{
+    this->flush();
+    this->receive();
+    return this->stream.read( this->stream.size() );
+}
+
+qint64 BondedTransport::bytesAvailable()
+{
+    this->flush();
+    this->receive();
+    return this->stream.size();
+}
+
+/**
+ * Soma das taxas dos links em uso, ou 0 se a de algum deles não é conhecida.
+ */
+int BondedTransport::getByteRate() const
+{
+    int rate = 0;
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        if ( !this->isLinkUsable( i ) ) {
+            continue;
+        }
+        int linkRate = this->links.at( i ).transport->getByteRate();
+        if ( 0 == linkRate ) {
+            return 0;
+        }
+        rate += linkRate;
+    }
+    return rate;
+}
+
+int BondedTransport::linkCount() const
+{
+    return this->links.size();
+}
+
+/**
+ * O meio utilizado por um dos links.
+ */
+Transport * BondedTransport::getLink( int link ) const
+{
+    return this->links.at( link ).transport;
+}
+
+/**
+ * Indica se o link recebe segmentos novos: está aberto, a última escrita não
+ * falhou e não está em silêncio enquanto os outros links recebem.
+ */
+bool BondedTransport::isLinkUsable( int link ) const
+{
+    const Link & l = this->links.at( link );
+    if ( l.failed || !l.transport->isOpen() ) {
+        return false;
+    }
+    if ( l.lastReceived.elapsed() <= LINK_TIMEOUT ) {
+        return true;
+    }
+
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        const Link & other = this->links.at( i );
+        if ( i != link && !other.failed && other.transport->isOpen()
+             && other.lastReceived.elapsed() <= LINK_TIMEOUT ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Número de bytes (segmentos e keepalives) escritos em um link.
+ */
+quint64 BondedTransport::getBytesSent( int link ) const
+{
+    return this->links.at( link ).bytesSent;
+}
+
+/**
+ * Número de segmentos recebidos que foram pulados por não terem chegado.
+ */
+quint32 BondedTransport::getLost() const
+{
+    return this->lost;
+}
+
+/**
+ * Escolhe o link com menos bytes atribuídos em proporção à sua taxa, entre
+ * os que têm menos de BondedTransport::MAX_BACKLOG bytes na fila: um link
+ * lento ou travado, que ainda não falhou, deixa de receber segmentos.
+ *
+ * @return O link, ou -1 se nenhum pode ser usado.
+ */
+int BondedTransport::pickLink() const
+{
+    int best = -1;
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        if ( this->isLinkUsable( i ) && this->links.at( i ).queued < MAX_BACKLOG
+             && ( best < 0 || this->links.at( i ).load < this->links.at( best ).load ) ) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+void BondedTransport::enqueue( int link, const QByteArray & segment )
+{
+    Link & l = this->links[link];
+    int rate = l.transport->getByteRate();
+    l.queue.append( segment );
+    l.queued += segment.size();
+    l.load += segment.size() / (double) ( ( rate > 0 ) ? rate : DEFAULT_BYTE_RATE );
+}
+
+/**
+ * Escreve as filas dos links, sem bloquear, com uma única chamada por link
+ * (Transport::writev), e envia os keepalives dos links ociosos.
+ */
+void BondedTransport::flush()
+{
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        Link & link = this->links[i];
+        if ( link.failed || link.queue.isEmpty() ) {
+            continue;
+        }
+
+        QList<QByteArray> buffers = link.queue;
+        if ( link.offset > 0 ) {
+            buffers[0] = buffers.at( 0 ).mid( link.offset );
+        }
+
+        qint64 written = link.transport->isOpen() ? link.transport->writev( buffers ) : -1;
+        if ( written < 0 ) {
+            // a fila foi para os outros links, inclusive os já percorridos
+            this->fail( i );
+            i = -1;
+            continue;
+        }
+        if ( 0 == written ) {
+            continue;
+        }
+
+        link.bytesSent += written;
+        link.lastSent.start();
+
+        written += link.offset;
+        while ( !link.queue.isEmpty() && written >= link.queue.first().size() ) {
+            written -= link.queue.first().size();
+            link.queued -= link.queue.first().size();
+            link.queue.removeFirst();
+        }
+        link.offset = written;
+    }
+
+    // inclusive nos links em silêncio, para que o outro lado volte a usá-los
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        Link & link = this->links[i];
+        if ( link.failed || !link.queue.isEmpty() || !link.transport->isOpen()
+             || link.lastSent.elapsed() < KEEPALIVE ) {
+            continue;
+        }
+
+        QByteArray keepalive = makeSegment( this->nextSeq, 0 );
+        qint64 written = link.transport->write( keepalive );
+        if ( written < 0 ) {
+            this->fail( i );
+            continue;
+        }
+        if ( written > 0 ) {
+            link.bytesSent += written;
+            link.lastSent.start();
+            if ( written < keepalive.size() ) {
+                link.queue.append( keepalive );
+                link.queued = keepalive.size();
+                link.offset = written;
+            }
+        }
+    }
+}
+
+/**
+ * Marca um link como falho e passa os segmentos da sua fila para os outros.
+ * O segmento que estava sendo escrito é enviado por inteiro outra vez; o
+ * outro lado descarta o que chegar duplicado. Os que não couberem nas filas
+ * dos outros links são descartados, e o outro lado os pula como perdidos.
+ */
+void BondedTransport::fail( int link )
+{
+    Link & l = this->links[link];
+
+    l.failed = true;
+    l.lastRetry.start();
+    QList<QByteArray> queue = l.queue;
+    l.queue.clear();
+    l.offset = 0;
+    l.queued = 0;
+
+    for ( int i = 0; i < queue.size(); i++ ) {
+        int other = this->pickLink();
+        if ( other < 0 ) {
+            break;
+        }
+        this->enqueue( other, queue.at( i ) );
+    }
+}
+
+/**
+ * Tenta reabrir os links falhos, no máximo uma vez a cada
+ * BondedTransport::RETRY_INTERVAL milissegundos.
+ */
+void BondedTransport::retry()
+{
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        Link & link = this->links[i];
+        if ( !link.failed || link.lastRetry.elapsed() < RETRY_INTERVAL ) {
+            continue;
+        }
+
+        link.lastRetry.start();
+        if ( !link.transport->reconnect() ) {
+            continue;
+        }
+
+        // começa com a carga dos outros, para não receber todos os segmentos
+        link.failed = false;
+        link.input.clear();
+        link.load = -1;
+        for ( int j = 0; j < this->links.size(); j++ ) {
+            if ( j != i && this->isLinkUsable( j ) && ( link.load < 0 || this->links.at( j ).load < link.load ) ) {
+                link.load = this->links.at( j ).load;
+            }
+        }
+        link.load = qMax( 0.0, link.load );
+    }
+}
+
+/**
+ * Aguarda algum byte em um dos links abertos, escolhido em rodízio por
+ * @a turn, por até BondedTransport::WAIT_SLICE milissegundos (ou @a msecs, se
+ * for menor), com a espera do próprio link (Transport::read). O que chegar
+ * fica na entrada do link, para BondedTransport::receive.
+ *
+ * @return false se nenhum link está aberto.
+ */
+bool BondedTransport::waitLink( int turn, int msecs )
+{
+    QList<int> open;
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        if ( this->links.at( i ).transport->isOpen() ) {
+            open.append( i );
+        }
+    }
+    if ( open.isEmpty() ) {
+        return false;
+    }
+
+    Link & link = this->links[open.at( turn % open.size() )];
+    link.transport->setTimeout( qMin( msecs, (int) WAIT_SLICE ) );
+    QByteArray data = link.transport->read( 1 );
+    link.transport->setTimeout( -1 );
+
+    if ( !data.isEmpty() ) {
+        link.lastReceived.start();
+        link.input.append( data );
+    }
+    return true;
+}
+
+/**
+ * Lê o que chegou em todos os links, separa os segmentos e entrega os que
+ * estão em ordem.
+ */
+void BondedTransport::receive()
+{
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        Link & link = this->links[i];
+        if ( !link.transport->isOpen() ) {
+            continue;
+        }
+
+        QByteArray data = link.transport->readAll();
+        if ( !data.isEmpty() ) {
+            link.lastReceived.start();
+            link.input.append( data );
+        }
+        if ( link.input.size() < OVERHEAD ) {
+            continue;
+        }
+
+        int pos = 0;
+        while ( link.input.size() - pos >= OVERHEAD ) {
+            const char * p = link.input.constData() + pos;
+
+            int len = (quint8) p[3];
+            int size = ( SEGMENT_RESET == len ) ? 0 : len;
+            if ( (quint8) p[0] != FRAME_SYNC || size > MAX_SEGMENT ) {
+                pos++;
+                continue;
+            }
+            if ( link.input.size() - pos < size + OVERHEAD ) {
+                break;
+            }
+            if ( crc8( p + 1, size + 3 ) != (quint8) p[size + 4] ) {
+                pos++;
+                continue;
+            }
+
+            this->parseSegment( link, p + 1, len );
+            pos += size + OVERHEAD;
+        }
+        link.input.remove( 0, pos );
+    }
+
+    this->deliver();
+}
+
+/**
+ * Trata um segmento válido recebido por um link.
+ *
+ * @param segment Ponteiro para o segmento, a partir do número de sequência.
+ * @param len     O campo de tamanho do segmento.
+ */
+void BondedTransport::parseSegment( Link & link, const char * segment, int len )
+{
+    quint16 seq = (quint16) ( ( (quint8) segment[0] << 8 ) | (quint8) segment[1] );
+
+    if ( SEGMENT_RESET == len ) {
+        // o outro lado foi aberto: a numeração recomeça (o anúncio chega por
+        // todos os links, mas só o primeiro de cada sessão vale)
+        if ( seq != this->peerSession ) {
+            this->peerSession = seq;
+            this->expected = 0;
+            this->synced = true;
+            this->held.clear();
+            for ( int i = 0; i < this->links.size(); i++ ) {
+                this->links[i].passed = 0xffff;
+            }
+        }
+        return;
+    }
+    if ( 0 == len ) {
+        // keepalive: os segmentos anteriores a seq já passaram por este link
+        quint16 before = seq - 1;
+        if ( distance( before, link.passed ) > 0 ) {
+            link.passed = before;
+        }
+        return;
+    }
+
+    if ( distance( seq, link.passed ) > 0 ) {
+        link.passed = seq;
+    }
+
+    int ahead = distance( seq, this->expected );
+    if ( ahead > SEQ_WINDOW || ahead < -SEQ_WINDOW ) {
+        this->synced = false;
+        this->held.clear();
+    }
+    if ( !this->synced ) {
+        // o anúncio da sessão não foi visto (este lado foi aberto depois):
+        // começa pelo menor número recebido até a próxima entrega
+        if ( this->held.isEmpty() || distance( seq, this->expected ) < 0 ) {
+            this->expected = seq;
+        }
+        this->held.insert( seq, QByteArray( segment + 3, len ) );
+        return;
+    }
+
+    // reenviado depois de uma falha, e já recebido
+    if ( ahead < 0 || this->held.contains( seq ) ) {
+        return;
+    }
+    if ( 0 == ahead ) {
+        this->stream.append( segment + 3, len );
+        this->expected++;
+    }
+    else {
+        this->held.insert( seq, QByteArray( segment + 3, len ) );
+    }
+}
+
+/**
+ * Passa para o fluxo de leitura os segmentos guardados que ficaram em ordem,
+ * pulando os perdidos.
+ */
+void BondedTransport::deliver()
+{
+    if ( !this->held.isEmpty() ) {
+        this->synced = true;
+    }
+
+    while ( !this->held.isEmpty() ) {
+        QHash<quint16, QByteArray>::iterator it = this->held.find( this->expected );
+        if ( it != this->held.end() ) {
+            this->stream.append( it.value().constData(), it.value().size() );
+            this->held.erase( it );
+            this->expected++;
+            continue;
+        }
+        if ( !this->gapLost() ) {
+            break;
+        }
+
+        // pula até o próximo segmento guardado
+        int gap = -1;
+        for ( it = this->held.begin(); it != this->held.end(); ++it ) {
+            int ahead = distance( it.key(), this->expected );
+            if ( gap < 0 || ahead < gap ) {
+                gap = ahead;
+            }
+        }
+        this->lost += gap;
+        this->expected += gap;
+    }
+}
+
+/**
+ * Indica se o segmento esperado não vai mais chegar: todos os links já
+ * entregaram segmentos posteriores a ele (cada link entrega em ordem), ou
+ * estão em silêncio. Com muitos segmentos guardados, também desiste dele.
+ */
+bool BondedTransport::gapLost() const
+{
+    if ( this->held.size() >= MAX_REORDER ) {
+        return true;
+    }
+
+    for ( int i = 0; i < this->links.size(); i++ ) {
+        const Link & link = this->links.at( i );
+        if ( link.transport->isOpen() && distance( link.passed, this->expected ) < 0
+             && link.lastReceived.elapsed() <= LINK_TIMEOUT ) {
+            return false;
+        }
+    }
+    return true;
+}
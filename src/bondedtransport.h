@@ -0,0 +1,118 @@
+#ifndef BONDEDTRANSPORT_H
+#define BONDEDTRANSPORT_H
+
+#include <QHash>
+#include <QTime>
+
+#include "blockbuffer.h"
+#include "transport.h"
+
+/**
+ * @class BondedTransport bondedtransport.h "bondedtransport.h"
+ * Um único fluxo de bytes dividido entre vários meios (por exemplo duas portas
+ * seriais), somando as suas taxas de transmissão.
+ *
+ * Os bytes escritos são quebrados em segmentos de até
+ * BondedTransport::MAX_SEGMENT bytes, numerados em sequência:
+ *
+ *      FRAME_SYNC | seq (16 bits) | tamanho | dados | CRC-8
+ *
+ * Cada segmento vai para o link com menos bytes atribuídos em proporção à sua
+ * taxa (Transport::getByteRate), e o outro lado os coloca de volta em ordem
+ * pelo número de sequência. Um segmento perdido (CRC-8 inválido) é pulado
+ * quando todos os links já entregaram segmentos posteriores a ele, ou quando o
+ * link em que ele vinha fica em silêncio por BondedTransport::LINK_TIMEOUT.
+ *
+ * Um segmento de tamanho 0 é um keepalive: enviado por um link ocioso a cada
+ * BondedTransport::KEEPALIVE milissegundos, com o próximo número de sequência,
+ * indica que o link está vivo e que os segmentos anteriores já passaram por
+ * ele. Um segmento de tamanho 255, sem dados, é enviado por todos os links ao
+ * abrir o meio e faz o outro lado recomeçar a numeração; no lugar do número de
+ * sequência ele leva um identificador da sessão.
+ *
+ * Se a escrita em um link falha, os segmentos da sua fila são reenviados pelos
+ * outros e o link é reaberto a cada BondedTransport::RETRY_INTERVAL
+ * milissegundos. Um link em que nada chega enquanto os outros recebem (cabo
+ * desconectado) também deixa de ser usado para enviar, mas continua recebendo
+ * os keepalives e volta a ser usado quando o outro lado voltar a ouvi-lo.
+ *
+ * Cada link guarda na fila no máximo BondedTransport::MAX_BACKLOG bytes; um
+ * link lento ou travado que ainda não falhou deixa de receber segmentos, e a
+ * escrita aceita menos bytes quando as filas de todos estão cheias.
+ *
+ * Os links são abertos sem espera (tempo limite -1); Transport::read aguarda
+ * na leitura de cada link, em rodízio.
+ */
+class BondedTransport : public Transport
+{
+public:
+    static const int MAX_SEGMENT    = 128;
+    static const int OVERHEAD       = 5;
+    static const int MAX_REORDER    = 256;      // segmentos guardados fora de ordem
+    static const int SEQ_WINDOW     = 16384;    // distância a partir da qual o outro lado recomeçou
+    static const int KEEPALIVE      = 50;
+    static const int LINK_TIMEOUT   = 200;
+    static const int RETRY_INTERVAL = 1000;
+    static const int MAX_BACKLOG    = 2048;     // bytes na fila de um link
+    static const int WAIT_SLICE     = 1;        // espera em cada link durante read, em ms
+
+    explicit BondedTransport( const QList<Transport *> & links );
+    ~BondedTransport();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+    bool reconnect();
+
+    qint64     write( const QByteArray & data );
+    QByteArray read( qint64 maxSize );
+    QByteArray readAll();
+    qint64     bytesAvailable();
+
+    int getByteRate() const;
+
+    int         linkCount() const;
+    Transport * getLink( int link ) const;
+    bool        isLinkUsable( int link ) const;
+    quint64     getBytesSent( int link ) const;
+    quint32     getLost() const;
+
+private:
+    struct Link {
+        Transport       * transport;
+        bool              failed;       // a escrita falhou: aguarda ser reaberto
+        QList<QByteArray> queue;        // segmentos que aguardam envio
+        int               offset;       // bytes já escritos do primeiro segmento
+        int               queued;       // bytes na fila (sem descontar offset)
+        double            load;         // bytes atribuídos, divididos pela taxa
+        quint64           bytesSent;
+        QTime             lastSent;
+        QTime             lastRetry;
+        QByteArray        input;        // bytes recebidos ainda não separados em segmentos
+        quint16           passed;       // último número de sequência que passou pelo link
+        QTime             lastReceived;
+    };
+
+    QList<Link>                links;
+    quint16                    nextSeq;     // próximo segmento a ser enviado
+    quint16                    expected;    // próximo segmento a ser entregue
+    bool                       synced;      // expected já corresponde ao outro lado
+    quint16                    session;     // identificador desta abertura
+    quint16                    peerSession; // última sessão anunciada pelo outro lado
+    QHash<quint16, QByteArray> held;        // segmentos recebidos antes do esperado
+    BlockBuffer                stream;      // bytes já em ordem, prontos para leitura
+    quint32                    lost;
+
+    int  pickLink() const;
+    void enqueue( int link, const QByteArray & segment );
+    void flush();
+    void fail( int link );
+    void retry();
+    bool waitLink( int turn, int msecs );
+    void receive();
+    void parseSegment( Link & link, const char * segment, int len );
+    void deliver();
+    bool gapLost() const;
+};
+
+#endif // BONDEDTRANSPORT_H
@@ -0,0 +1,134 @@
+#include <QDebug>
+
+#include "broadcaster.h"
+#include "transport.h"
+
+/**
+ * Cria o transmissor sem nenhum espectador.
+ */
+Broadcaster::Broadcaster()
+{
+}
+
+/**
+ * Destrutor. Fecha a conexão com todos os espectadores.
+ */
+Broadcaster::~Broadcaster()
+{
+    for ( int i = 0; i < this->sinks.size(); i++ ) {
+        delete this->sinks.at( i ).transport;
+    }
+}
+
+/**
+ * Adiciona um espectador.
+ *
+ * @param name O nome da porta serial ou de outro meio de comunicação
+ *             (ver Transport::create).
+ * @return false se não foi possível abrir a conexão com o espectador.
+ */
+bool Broadcaster::addSink( const QString & name )
+{
+    Sink sink;
+    sink.name      = name;
+    sink.transport = Transport::create( name );
+    sink.offset    = 0;
+    sink.dropped   = 0;
+
+    // sem espera: a escrita retorna imediatamente com o que foi aceito
+    sink.transport->setTimeout( -1 );
+    if ( !sink.transport->open() ) {
+        qWarning() << "Broadcaster: não foi possível abrir" << name;
+        delete sink.transport;
+        return false;
+    }
+
+    this->sinks.append( sink );
+    return true;
+}
+
+/**
+ * Número de espectadores.
+ */
+int Broadcaster::sinkCount() const
+{
+    return this->sinks.size();
+}
+
+/**
+ * Coloca um quadro na fila de todos os espectadores e escreve o que for
+ * possível sem bloquear.
+ *
+ * @param frame O quadro, que deve ser completo por si só (o espectador pode
+ *              começar a receber em qualquer ponto).
+ */
+void Broadcaster::broadcast( const QByteArray & frame )
+{
+    for ( int i = 0; i < this->sinks.size(); i++ ) {
+        Sink & sink = this->sinks[i];
+
+        // descarta o quadro mais antigo que ainda não começou a ser escrito
+        if ( sink.queue.size() >= MAX_QUEUE ) {
+            sink.queue.removeAt( ( sink.offset > 0 ) ? 1 : 0 );
+            sink.dropped++;
+        }
+        sink.queue.append( frame );
+    }
+
+    this->flush();
+}
+
+/**
+ * Escreve as filas dos espectadores, sem bloquear. Todos os quadros da fila de
+ * um espectador são escritos com uma única chamada (Transport::writev).
+ */
+void Broadcaster::flush()
+{
+    for ( int i = 0; i < this->sinks.size(); i++ ) {
+        Sink & sink = this->sinks[i];
+        if ( sink.queue.isEmpty() ) {
+            continue;
+        }
+
+        QList<QByteArray> buffers = sink.queue;
+        if ( sink.offset > 0 ) {
+            buffers[0] = buffers.at( 0 ).mid( sink.offset );
+        }
+
+        qint64 written = sink.transport->writev( buffers );
+        if ( written <= 0 ) {
+            continue;
+        }
+
+        written += sink.offset;
+        while ( !sink.queue.isEmpty() && written >= sink.queue.first().size() ) {
+            written -= sink.queue.first().size();
+            sink.queue.removeFirst();
+        }
+        sink.offset = written;
+    }
+}
+
+/**
+ * Nome do meio de comunicação de um espectador.
+ */
+QString Broadcaster::getSinkName( int sink ) const
+{
+    return this->sinks.at( sink ).name;
+}
+
+/**
+ * Número de quadros que aguardam envio para um espectador.
+ */
+int Broadcaster::getQueueDepth( int sink ) const
+{
+    return this->sinks.at( sink ).queue.size();
+}
+
+/**
+ * Número de quadros descartados por um espectador não acompanhar o jogo.
+ */
+quint32 Broadcaster::getDropped( int sink ) const
+{
+    return this->sinks.at( sink ).dropped;
+}
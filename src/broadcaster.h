@@ -0,0 +1,53 @@
+#ifndef BROADCASTER_H
+#define BROADCASTER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+class Transport;
+
+/**
+ * @class Broadcaster broadcaster.h "broadcaster.h"
+ * Envia o estado do jogo para vários espectadores.
+ *
+ * Cada espectador (sink) é um Transport aberto sem espera (tempo limite -1),
+ * com uma fila de no máximo Broadcaster::MAX_QUEUE quadros. O quadro é gerado
+ * uma única vez e compartilhado por todas as filas, sem cópia.
+ *
+ * Nenhuma escrita bloqueia: o que o espectador não aceitar fica na fila para o
+ * próximo quadro. Se a fila estiver cheia, o quadro mais antigo é descartado,
+ * já que para o espectador só interessa o estado mais recente. Assim um
+ * espectador lento ou travado nunca atrasa a comunicação com o adversário.
+ */
+class Broadcaster
+{
+public:
+    static const int MAX_QUEUE = 8;
+
+    Broadcaster();
+    ~Broadcaster();
+
+    bool addSink( const QString & name );
+    int  sinkCount() const;
+
+    void broadcast( const QByteArray & frame );
+    void flush();
+
+    QString getSinkName( int sink ) const;
+    int     getQueueDepth( int sink ) const;
+    quint32 getDropped( int sink ) const;
+
+private:
+    struct Sink {
+        QString           name;
+        Transport       * transport;
+        QList<QByteArray> queue;
+        int               offset;   // bytes já escritos do primeiro quadro da fila
+        quint32           dropped;
+    };
+
+    QList<Sink> sinks;
+};
+
+#endif // BROADCASTER_H
@@ -0,0 +1,342 @@
+#include "fec.h"
+#include "protocol.h"
+
+/**
+ * Paridade (número de bits 1 ímpar ou par) de um byte.
+ */
+static inline int parity8( quint8 value )
+{
+    value ^= value >> 4;
+    value ^= value >> 2;
+    value ^= value >> 1;
+    return value & 1;
+}
+
+/**
+ * Número de bits diferentes entre dois bytes.
+ */
+static inline int distance8( quint8 a, quint8 b )
+{
+    int count = 0;
+    for ( quint8 diff = a ^ b; diff; diff &= diff - 1 ) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Tabelas pré-calculadas utilizadas na codificação e decodificação.
+ *
+ * São calculadas uma única vez, na inicialização do programa, para que o custo
+ * de cada bloco seja de apenas uma consulta à tabela por byte.
+ */
+struct FecTables
+{
+    quint8 byteCheck[Fec::BLOCK_SIZE][256]; // bits 0-6: síndrome do byte; bit 7: paridade do byte
+    qint8  positionToBit[128];              // posição no código de Hamming -> bit dos dados (-1 = não é dado)
+    quint8 nibbleEncode[16];                // Hamming (8,4) estendido
+    qint8  nibbleDecode[256];               // -1 = erro não corrigível
+
+    FecTables()
+    {
+        // os 64 bits de dados ocupam as posições que não são potência de 2
+        int bitPosition[Fec::BLOCK_SIZE * 8];
+        for ( int pos = 0; pos < 128; pos++ ) {
+            this->positionToBit[pos] = -1;
+        }
+        for ( int pos = 3, bit = 0; bit < Fec::BLOCK_SIZE * 8; pos++ ) {
+            if ( pos & ( pos - 1 ) ) {
+                bitPosition[bit] = pos;
+                this->positionToBit[pos] = bit;
+                bit++;
+            }
+        }
+
+        for ( int byte = 0; byte < Fec::BLOCK_SIZE; byte++ ) {
+            for ( int value = 0; value < 256; value++ ) {
+                quint8 syndrome = 0;
+                for ( int bit = 0; bit < 8; bit++ ) {
+                    if ( value & ( 1 << bit ) ) {
+                        syndrome ^= bitPosition[byte * 8 + bit];
+                    }
+                }
+                this->byteCheck[byte][value] = syndrome | ( parity8( value ) << 7 );
+            }
+        }
+
+        // nibbles: dados nas posições 3, 5, 6 e 7, paridade em 1, 2 e 4,
+        // paridade geral no bit 7
+        static const int nibblePosition[4] = { 3, 5, 6, 7 };
+        for ( int nibble = 0; nibble < 16; nibble++ ) {
+            quint8 word = 0, syndrome = 0;
+            for ( int bit = 0; bit < 4; bit++ ) {
+                if ( nibble & ( 1 << bit ) ) {
+                    word |= 1 << ( nibblePosition[bit] - 1 );
+                    syndrome ^= nibblePosition[bit];
+                }
+            }
+            for ( int bit = 0; bit < 3; bit++ ) {
+                if ( syndrome & ( 1 << bit ) ) {
+                    word |= 1 << ( ( 1 << bit ) - 1 );
+                }
+            }
+            this->nibbleEncode[nibble] = word | ( parity8( word ) << 7 );
+        }
+
+        for ( int value = 0; value < 256; value++ ) {
+            this->nibbleDecode[value] = -1;
+            for ( int nibble = 0; nibble < 16; nibble++ ) {
+                if ( distance8( value, this->nibbleEncode[nibble] ) <= 1 ) {
+                    this->nibbleDecode[value] = nibble;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+static const FecTables tables;
+
+/**
+ * Calcula o tamanho de uma mensagem após a codificação.
+ *
+ * @param len O tamanho original da mensagem.
+ * @return O número de bytes enviados, incluindo o cabeçalho e o CRC-8.
+ */
+int Fec::encodedSize( int len )
+{
+    int protectedLen = len + 1;
+    return 3 + protectedLen + ( protectedLen + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+}
+
+/**
+ * Codifica uma mensagem.
+ *
+ * @param data A mensagem original. Apenas os primeiros Fec::MAX_MESSAGE bytes
+ *             são considerados.
+ * @return A mensagem pronta para ser enviada pela porta serial.
+ */
+QByteArray Fec::encode( const QByteArray & data )
+{
+    int len = qMin( data.size(), (int) MAX_MESSAGE );
+
+    // o CRC-8 vai no último bloco, também protegido pelo código de Hamming
+    QByteArray payload( data.constData(), len );
+    payload.append( (char) crc8( data.constData(), len ) );
+
+    QByteArray out;
+    out.reserve( encodedSize( len ) );
+    out.append( (char) FRAME_SYNC );
+    out.append( (char) tables.nibbleEncode[len >> 4] );
+    out.append( (char) tables.nibbleEncode[len & 0x0f] );
+
+    for ( int pos = 0; pos < payload.size(); pos += BLOCK_SIZE ) {
+        int size = qMin( (int) BLOCK_SIZE, payload.size() - pos );
+        out.append( payload.constData() + pos, size );
+        out.append( (char) blockCheck( payload.constData() + pos, size ) );
+    }
+
+    return out;
+}
+
+/**
+ * Calcula o byte de verificação de um bloco.
+ *
+ * Os bits 0 a 6 são os bits de paridade do código de Hamming e o bit 7 é a
+ * paridade geral do bloco (dados + verificação), que permite diferenciar erros
+ * de 1 e de 2 bits.
+ *
+ * @param data Ponteiro para o bloco.
+ * @param len  Tamanho do bloco (até Fec::BLOCK_SIZE). Os bytes que faltam são
+ *             considerados como zero.
+ */
+quint8 Fec::blockCheck( const char * data, int len )
+{
+    quint8 check = 0;
+    for ( int i = 0; i < len; i++ ) {
+        check ^= tables.byteCheck[i][(quint8) data[i]];
+    }
+
+    quint8 syndrome = check & 0x7f;
+    return syndrome | ( ( ( check >> 7 ) ^ parity8( syndrome ) ) << 7 );
+}
+
+/**
+ * Verifica e, se necessário, corrige um bloco recebido.
+ *
+ * @param data  Ponteiro para o bloco. Um erro de 1 bit é corrigido no local.
+ * @param len   Tamanho do bloco.
+ * @param check O byte de verificação recebido.
+ * @return 0 se o bloco estava correto, 1 se um erro foi corrigido ou -1 se o
+ *         erro não pode ser corrigido.
+ */
+int Fec::correctBlock( char * data, int len, quint8 check )
+{
+    quint8 computed = 0;
+    for ( int i = 0; i < len; i++ ) {
+        computed ^= tables.byteCheck[i][(quint8) data[i]];
+    }
+
+    quint8 syndrome = ( computed ^ check ) & 0x7f;
+    int overall = ( computed >> 7 ) ^ parity8( check & 0x7f ) ^ ( check >> 7 );
+
+    if ( 0 == overall ) {
+        // nenhum erro, ou dois erros (não corrigível)
+        return ( 0 == syndrome ) ? 0 : -1;
+    }
+
+    // erro no bit de paridade geral ou em um dos bits de verificação
+    if ( 0 == ( syndrome & ( syndrome - 1 ) ) ) {
+        return 1;
+    }
+
+    int bit = tables.positionToBit[syndrome];
+    if ( bit < 0 || bit / 8 >= len ) {
+        return -1;
+    }
+
+    data[bit / 8] ^= 1 << ( bit % 8 );
+    return 1;
+}
+
+/**
+ * Cria um novo decodificador, com o buffer de recepção vazio.
+ */
+FecDecoder::FecDecoder()
+{
+    this->corrected     = 0;
+    this->uncorrectable = 0;
+}
+
+/**
+ * Adiciona os bytes recebidos e decodifica as mensagens completas.
+ *
+ * Se o início de uma mensagem não for reconhecido, um bloco tiver um erro não
+ * corrigível ou o CRC-8 não conferir, o decodificador descarta um byte e
+ * procura o próximo cabeçalho válido. As correções são feitas em uma cópia da
+ * mensagem, e os bytes só são retirados do buffer depois que o quadro inteiro
+ * é validado.
+ *
+ * Enquanto um quadro não chega inteiro, os bytes seguintes também são
+ * verificados: se já houver um quadro válido completo mais adiante, o primeiro
+ * cabeçalho era falso e a decodificação continua a partir do quadro válido.
+ *
+ * @param data Os bytes lidos da porta serial.
+ */
+void FecDecoder::feed( const QByteArray & data )
+{
+    this->buffer.append( data );
+
+    int pos = 0;
+    while ( this->buffer.size() - pos >= 3 ) {
+        QByteArray message;
+        int fixes = 0;
+        int size = this->decodeAt( pos, &message, &fixes );
+
+        if ( 0 == size ) {
+            int next = pos + 1;
+            while ( this->buffer.size() - next >= 3 && this->decodeAt( next, &message, &fixes ) <= 0 ) {
+                next++;
+            }
+            if ( this->buffer.size() - next < 3 ) {
+                break;
+            }
+            pos = next;
+            continue;
+        }
+
+        if ( size < 0 ) {
+            if ( -2 == size ) {
+                this->uncorrectable++;
+            }
+            pos++;
+            continue;
+        }
+
+        this->corrected += fixes;
+        this->messages.append( message );
+        pos += size;
+    }
+
+    this->buffer.remove( 0, pos );
+}
+
+/**
+ * Decodifica o quadro que começa na posição @a pos do buffer de recepção, que
+ * deve ter ao menos 3 bytes a partir dela.
+ *
+ * @param pos     A posição do possível cabeçalho.
+ * @param message Recebe a mensagem decodificada.
+ * @param fixes   Recebe o número de bits corrigidos.
+ * @return O tamanho do quadro, se ele for válido; 0 se ele ainda não chegou
+ *         inteiro; -1 se não há um cabeçalho em @a pos; -2 se um bloco tem um
+ *         erro não corrigível ou o CRC-8 não confere.
+ */
+int FecDecoder::decodeAt( int pos, QByteArray * message, int * fixes ) const
+{
+    const char * p = this->buffer.constData() + pos;
+
+    // o byte de sincronismo precisa chegar intacto: com um bit de tolerância,
+    // cabeçalhos falsos apareceriam com frequência no ruído
+    int hi = tables.nibbleDecode[(quint8) p[1]];
+    int lo = tables.nibbleDecode[(quint8) p[2]];
+    if ( (quint8) p[0] != FRAME_SYNC || hi < 0 || lo < 0 || 0 == ( hi | lo ) ) {
+        return -1;
+    }
+
+    int len = ( hi << 4 ) | lo;
+    int size = Fec::encodedSize( len );
+    if ( this->buffer.size() - pos < size ) {
+        return 0;
+    }
+
+    *fixes = ( (quint8) p[1] != tables.nibbleEncode[hi] )
+           + ( (quint8) p[2] != tables.nibbleEncode[lo] );
+
+    // os blocos são corrigidos na cópia: se o quadro for rejeitado, o
+    // buffer continua como chegou para a busca do próximo cabeçalho
+    message->clear();
+    message->reserve( len + 1 );
+
+    const char * block = p + 3;
+    for ( int done = 0; done <= len; done += Fec::BLOCK_SIZE ) {
+        int blockSize = qMin( (int) Fec::BLOCK_SIZE, len + 1 - done );
+        message->append( block, blockSize );
+        int result = Fec::correctBlock( message->data() + done, blockSize, block[blockSize] );
+        if ( result < 0 ) {
+            return -2;
+        }
+        *fixes += result;
+        block += blockSize + 1;
+    }
+
+    if ( crc8( message->constData(), len ) != (quint8) message->at( len ) ) {
+        return -2;
+    }
+
+    message->chop( 1 );
+    return size;
+}
+
+/**
+ * Retorna as mensagens decodificadas desde a última chamada, na ordem em que
+ * foram recebidas.
+ */
+QList<QByteArray> FecDecoder::takeMessages()
+{
+    QList<QByteArray> result = this->messages;
+    this->messages.clear();
+    return result;
+}
+
+/** Número de bits errados que foram corrigidos. */
+quint32 FecDecoder::getCorrected() const
+{
+    return this->corrected;
+}
+
+/** Número de quadros descartados por erros não corrigíveis ou CRC-8 inválido. */
+quint32 FecDecoder::getUncorrectable() const
+{
+    return this->uncorrectable;
+}
@@ -0,0 +1,66 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <QByteArray>
+#include <QList>
+
+/**
+ * @class Fec fec.h "fec.h"
+ * Correção de erros (FEC, Forward Error Correction) das mensagens enviadas.
+ *
+ * Cada mensagem é dividida em blocos de até 8 bytes, e cada bloco recebe um
+ * byte de verificação com o código de Hamming estendido (72,64). Esse código
+ * corrige qualquer erro de 1 bit por bloco e detecta erros de 2 bits, sem
+ * necessidade de retransmissão.
+ *
+ * Formato da mensagem codificada:
+ *
+ *      FRAME_SYNC | tamanho (2 bytes) | bloco 1 | verif. 1 | ... | bloco N | verif. N
+ *
+ * O tamanho é enviado em dois nibbles, cada um codificado com Hamming (8,4)
+ * estendido, então também é protegido contra erros de 1 bit. Os blocos levam a
+ * mensagem seguida do seu CRC-8, que confirma a mensagem depois das correções:
+ * um cabeçalho falso no meio do ruído não é aceito como mensagem.
+ */
+class Fec
+{
+public:
+    static const int BLOCK_SIZE  = 8;
+    static const int MAX_MESSAGE = 255;
+
+    static int        encodedSize( int len );
+    static QByteArray encode( const QByteArray & data );
+
+    static quint8 blockCheck( const char * data, int len );
+    static int    correctBlock( char * data, int len, quint8 check );
+};
+
+/**
+ * @class FecDecoder fec.h "fec.h"
+ * Decodifica o fluxo de bytes gerado por Fec::encode.
+ *
+ * Os bytes recebidos podem ser adicionados em qualquer quantidade; as mensagens
+ * completas ficam disponíveis em FecDecoder::takeMessages. Erros de 1 bit são
+ * corrigidos em cada bloco da mensagem.
+ */
+class FecDecoder
+{
+public:
+    FecDecoder();
+
+    void feed( const QByteArray & data );
+    QList<QByteArray> takeMessages();
+
+    quint32 getCorrected() const;
+    quint32 getUncorrectable() const;
+
+private:
+    int decodeAt( int pos, QByteArray * message, int * fixes ) const;
+
+    QByteArray        buffer;
+    QList<QByteArray> messages;
+    quint32           corrected;
+    quint32           uncorrectable;
+};
+
+#endif // FEC_H
@@ -10,11 +10,43 @@
 #include <cmath>
 
 #include "ball.h"
+#include "broadcaster.h"
+#include "fec.h"
 #include "game.h"
 #include "globals.h"
-#include "qextserialport.h"
+#include "inputredundancy.h"
+#include "multiplexer.h"
+#include "outputqueue.h"
 #include "player.h"
 #include "scoreboard.h"
+#include "transport.h"
+#ifdef Q_OS_UNIX
+# include "ptytransport.h"
+#endif
+
+/**
+ * Intervalo entre os quadros do jogo, em milissegundos (20 FPS).
+ */
+static const int TICK_INTERVAL = 1000 / 20;
+
+/**
+ * Bytes enviados a cada quadro pelos canais extras quando o meio de
+ * comunicação não tem uma taxa de transmissão conhecida (ver Transport::getByteRate).
+ */
+static const int UNLIMITED_CAPACITY = 64 * 1024;
+
+/**
+ * Bytes enviados a cada quadro pelos canais extras nas taxas tão baixas que
+ * a capacidade de um quadro não comporta nem o cabeçalho de um segmento: um
+ * segmento completo, mesmo que a fila de transmissão não esvazie até o
+ * próximo quadro.
+ */
+static const int MIN_CAPACITY = Multiplexer::MAX_SEGMENT + Multiplexer::OVERHEAD;
+
+/**
+ * Intervalo entre as tentativas de reabrir a conexão perdida, em milissegundos.
+ */
+static const int RECONNECT_INTERVAL = 500;
 
 /**
  * Cria um novo jogo.
@@ -37,16 +69,30 @@ Game::Game( QWidget * parent ) :
     this->moveUpKeyCode   = Qt::Key_nobreakspace;   // tecla desconhecida
     this->moveDownKeyCode = Qt::Key_nobreakspace;   // tecla desconhecida
     this->moveWithMouse   = false;                  // movimento com o mouse desabilitado
+    this->protocolOptions = 0;                      // nenhuma opção extra do protocolo
+    this->linkTimeout     = 1000;                   // conexão perdida após 1s sem receber nada
+    this->batchLatency    = 0;                      // quadros escritos a cada quadro do jogo
 
     // inicializa os controles do jogo
-    this->port                = NULL;   // conexão serial
+    this->transport           = NULL;   // conexão com o outro jogador
     this->timer               = NULL;   // timer para atualizar a tela
     this->gameTime            = NULL;   // tempo de jogo
+    this->inputEncoder        = NULL;   // codificação redundante dos comandos (cliente)
+    this->inputDecoder        = NULL;   // decodificação redundante dos comandos (servidor)
+    this->fecDecoder          = NULL;   // correção de erros das mensagens recebidas
+    this->multiplexer         = NULL;   // canais extras (envio)
+    this->demultiplexer       = NULL;   // canais extras (recepção)
+    this->broadcaster         = NULL;   // envio do jogo para os espectadores
+    this->outputQueue         = NULL;   // quadros aguardando para serem escritos juntos
+    this->linkCapacity        = 0;      // bytes transmitidos pela porta a cada quadro
+    this->linkLost            = false;  // conexão com o outro jogador perdida
+    this->pausedBeforeLoss    = false;  // estado do jogo antes de perder a conexão
     this->displayedText       = NULL;   // mensagens exibidas sobre o jogo
     this->displayedTextEffect = NULL;   // efeito de sombra na mensagem
     this->player1score        = 0;      // número de gols do jogador 1
     this->player2score        = 0;      // número de gols do jogador 2
     this->otherReady          = false;  // adversário não está pronto
+    this->activeOptions       = 0;      // opções do protocolo aceitas pelos dois jogadores
     this->paused              = true;   // jogo pausado (esperando adversário)
     this->localPlayerName     = "";     // nome do jogador local
     this->remotePlayerName    = "";     // nome do jogador remoto/adversário
@@ -106,14 +152,17 @@ Game::Game( QWidget * parent ) :
  */
 Game::~Game()
 {
-    if ( this->port != NULL ) {
-        this->port->close();
-        delete this->port;
-    }
-
+    delete this->transport;
     delete this->timer;
     delete this->gameTime;
     delete this->scoreBoard;
+    delete this->inputEncoder;
+    delete this->inputDecoder;
+    delete this->fecDecoder;
+    delete this->multiplexer;
+    delete this->demultiplexer;
+    delete this->broadcaster;
+    delete this->outputQueue;
 
     delete this->field;
     delete this->goalLeft;
@@ -161,6 +210,57 @@ void Game::play()
     this->timer = new QTimer( this );
     this->gameTime = new QTime();
 
+    // comandos do cliente enviados com redundância
+    if ( this->activeOptions & OPT_REDUNDANT_INPUT ) {
+        if ( SERVER == this->gameMode ) {
+            this->inputDecoder = new InputDecoder();
+        }
+        else {
+            this->inputEncoder = new InputEncoder();
+        }
+    }
+
+    // todos os quadros gerados em um quadro do jogo são escritos juntos
+    this->outputQueue = new OutputQueue( this->transport );
+    this->outputQueue->setLatencyCap( this->batchLatency );
+
+    // correção de erros nas mensagens trocadas
+    if ( this->activeOptions & OPT_ERROR_CORRECTION ) {
+        this->fecDecoder = new FecDecoder();
+    }
+
+    // canais extras: o jogo sempre tem prioridade, os outros canais dividem o
+    // que sobrar da capacidade do link em cada quadro
+    if ( this->activeOptions & OPT_MULTIPLEX ) {
+        this->multiplexer = new Multiplexer();
+        this->multiplexer->addChannel( CHANNEL_GAME,      3 );
+        this->multiplexer->addChannel( CHANNEL_CHAT,      2, 32 );
+        this->multiplexer->addChannel( CHANNEL_TELEMETRY, 1, 32 );
+        this->multiplexer->addChannel( CHANNEL_BULK,      0 );
+        this->demultiplexer = new Demultiplexer();
+
+        // bytes transmitidos entre dois quadros, com margem de 10% para que a
+        // fila de transmissão esvazie antes do próximo quadro
+        int byteRate = this->transport->getByteRate();
+        this->linkCapacity = ( byteRate > 0 ) ? byteRate * TICK_INTERVAL / 1000 * 9 / 10 : UNLIMITED_CAPACITY;
+        if ( NULL != this->fecDecoder ) {
+            // cabeçalho de 3 bytes e CRC-8 em cada mensagem
+            this->linkCapacity = this->linkCapacity * Fec::BLOCK_SIZE / ( Fec::BLOCK_SIZE + 1 ) - 4;
+        }
+        this->linkCapacity = qMax( this->linkCapacity, MIN_CAPACITY );
+    }
+
+    // espectadores (apenas o servidor tem o estado do jogo)
+    if ( SERVER == this->gameMode && !this->spectators.isEmpty() ) {
+        this->broadcaster = new Broadcaster();
+        for ( int i = 0; i < this->spectators.size(); i++ ) {
+            this->broadcaster->addSink( this->spectators.at( i ) );
+        }
+        for ( int i = 0; i < this->broadcaster->sinkCount(); i++ ) {
+            this->spectatorDrops.append( 0 );
+        }
+    }
+
     // conecta o sinal timeout do contador com o slot do servidor
     if ( SERVER == this->gameMode ) {
         connect( this->timer, SIGNAL(timeout()), this, SLOT(playOnServer()) );
@@ -176,8 +276,9 @@ void Game::play()
         qApp->exit( ERR_BAD_GAME_MODE );
     }
 
-    this->timer->start( 1000 / 20 );  // 20 FPS
+    this->timer->start( TICK_INTERVAL );
     this->gameTime->start();
+    this->lastReceived.start();
     this->paused = false;
 
     // captura o teclado para esperar pelas teclas de controle do jogador
@@ -202,7 +303,7 @@ void Game::play()
  */
 void Game::readyToPlay()
 {
-    if ( NULL == this->port || !this->port->isOpen() ) {
+    if ( NULL == this->transport || !this->transport->isOpen() ) {
         this->configureSerialPort();
     }
 
@@ -212,7 +313,16 @@ void Game::readyToPlay()
         this->play();
     }
     else {
-        this->showMessage( "Aguardando outro jogador...", -1 );
+        QString message = "Aguardando outro jogador...";
+#ifdef Q_OS_UNIX
+        // com um par de pseudo-terminais novo, o outro jogador precisa do
+        // nome do lado escravo
+        PtyTransport * pty = dynamic_cast<PtyTransport*>( this->transport );
+        if ( NULL != pty && !pty->getSlaveName().isEmpty() ) {
+            message = "Aguardando outro jogador em " + pty->getSlaveName() + "...";
+        }
+#endif
+        this->showMessage( message, -1 );
         this->timer = new QTimer( this );
         this->timer->start( 50 );
         connect( this->timer, SIGNAL(timeout()), this, SLOT(waitPlayer()) );
@@ -234,16 +344,25 @@ void Game::waitPlayer()
     Greetings info;
     info.ready = true;
     info.gameMode = this->gameMode;
+    info.options = this->protocolOptions;
     strcpy( info.name, this->localPlayerName.toAscii().data() );
-    this->port->write( (char*) &info, sizeof(Greetings) );
+    this->transport->write( QByteArray( (char*) &info, sizeof(Greetings) ) );
 
     // verifica se o outro jogador enviou informações
-    if ( this->port->bytesAvailable() > 0 ) {
+    if ( this->transport->bytesAvailable() > 0 ) {
+        QByteArray read = this->transport->read( sizeof(Greetings) );
+        if ( read.size() < (int) sizeof(Greetings) ) {
+            return;
+        }
+
         Greetings remoteInfo;
-        this->port->read( (char*) &remoteInfo, sizeof(Greetings) );
+        memcpy( &remoteInfo, read.constData(), sizeof(Greetings) );
 
         this->otherReady = remoteInfo.ready && ( remoteInfo.gameMode != this->gameMode );
 
+        // só utiliza as opções que os dois jogadores habilitaram
+        this->activeOptions = this->protocolOptions & remoteInfo.options;
+
         if ( this->otherReady ) {
             // não precisamos mais desse evento
             this->timer->stop();
@@ -389,6 +508,9 @@ Game::GameMode Game::getGameMode() const
 
 /**
  * Define o nome da porta serial.
+ *
+ * Também aceita os nomes dos outros meios de comunicação (ver Transport), para
+ * testar o jogo em uma única máquina.
  */
 void Game::setPortName( QString port )
 {
@@ -442,36 +564,23 @@ bool Game::isPlaying() const
 }
 
 /**
- * Método interno utilizado para configurar a porta serial.
+ * Método interno utilizado para configurar a conexão com o outro jogador.
  *
- * Abre a porta definida em Game::portName com as configurações padrão
- * utilizadas para o jogo.
+ * Abre o meio de comunicação definido em Game::portName: normalmente a porta
+ * serial, com as configurações padrão utilizadas para o jogo, ou um dos meios
+ * descritos em Transport (pseudo-terminal, socket local, etc.).
  *
- * @note As configurações padrão são:
- *  - Baud rate         = 57.600 bauds
- *  - Bits de dados     = 8
- *  - Paridade          = nenhuma
- *  - Bits de parada    = 1
- *  - Controle de fluxo = nenhum
- *  - Tempo limite      = 200ms
- *  - Buffer            = nenhum
+ * @note O tempo limite das leituras é de 200ms.
+ * @see SerialTransport
  */
 void Game::configureSerialPort()
 {
-    // se a porta está aberta ela precisa ser fechada
-    if ( this->port != NULL ) {
-        this->port->close();
-        delete this->port;
-    }
+    // se a conexão está aberta ela precisa ser fechada
+    delete this->transport;
 
-    this->port = new QextSerialPort( this->portName, QextSerialPort::Polling );
-    this->port->setBaudRate( BAUD57600 );
-    this->port->setDataBits( DATA_8 );
-    this->port->setParity( PAR_NONE );
-    this->port->setStopBits( STOP_1 );
-    this->port->setFlowControl( FLOW_OFF );
-    this->port->setTimeout( 200 );
-    if ( !this->port->open( QIODevice::ReadWrite | QIODevice::Unbuffered | QIODevice::Truncate ) ) {
+    this->transport = Transport::create( this->portName );
+    this->transport->setTimeout( 200 );
+    if ( !this->transport->open() ) {
         qApp->exit( ERR_SERIAL_ERROR );
     }
 }
@@ -572,18 +681,57 @@ bool Game::eventFilter( QObject * obj, QEvent * event )
  */
 void Game::playOnServer()
 {
-    // jogo só pode ser jogado com a conexão estabelecida
-    if ( this->port == NULL || !this->port->isOpen() ) {
+    // jogo só pode ser jogado com a conexão estabelecida; com o meio fechado
+    // (reconexão que falhou), continua tentando reabri-lo
+    if ( this->transport == NULL ) {
+        return;
+    }
+    if ( !this->transport->isOpen() ) {
+        this->checkLink( false );
         return;
     }
 
     // lê as informações enviadas pelo cliente
-    QByteArray read = this->port->read( sizeof(ClientInfo) );
-    ClientInfo * client;
-    client = (ClientInfo*) read.data();
-
-    this->player2->setY( client->playerPos );
-    this->ball->setSpeed( ( this->speed + client->velocity ) / 2 );
+    bool received = false;
+    if ( NULL != this->inputDecoder ) {
+        // aplica em ordem todos os comandos recebidos, inclusive os recuperados
+        // dos quadros perdidos. Se nenhum chegou, mantém o último.
+        this->inputDecoder->feed( this->receiveData( 0 ) );
+        QList<ClientInfo> inputs = this->inputDecoder->takeInputs();
+        for ( int i = 0; i < inputs.size(); i++ ) {
+            this->player2->setY( inputs.at( i ).playerPos );
+            this->ball->setSpeed( ( this->speed + inputs.at( i ).velocity ) / 2 );
+        }
+        received = !inputs.isEmpty();
+    }
+    else if ( NULL == this->fecDecoder && NULL == this->demultiplexer ) {
+        // sem FEC nem canais extras, os comandos são lidos no próprio buffer
+        // do meio, sem cópia. Só o primeiro aguarda o tempo limite; os
+        // seguintes são apenas os que já chegaram, e vale o mais recente
+        int timeout = this->transport->getTimeout();
+        const ClientInfo * client;
+        while ( NULL != ( client = (const ClientInfo*) this->transport->peek( sizeof(ClientInfo) ) ) ) {
+            this->player2->setY( client->playerPos );
+            this->ball->setSpeed( ( this->speed + client->velocity ) / 2 );
+            this->transport->consume( sizeof(ClientInfo) );
+            this->transport->setTimeout( 0 );
+            received = true;
+        }
+        this->transport->setTimeout( timeout );
+    }
+    else {
+        // usa o comando mais recente recebido
+        QByteArray read = this->receiveData( sizeof(ClientInfo) );
+        if ( read.size() >= (int) sizeof(ClientInfo) ) {
+            ClientInfo * client;
+            client = (ClientInfo*) ( read.data() + read.size() - sizeof(ClientInfo) );
+
+            this->player2->setY( client->playerPos );
+            this->ball->setSpeed( ( this->speed + client->velocity ) / 2 );
+            received = true;
+        }
+    }
+    this->checkLink( received );
 
     bool isGoal = false;
     if ( !this->paused ) {
@@ -596,7 +744,6 @@ void Game::playOnServer()
     }
 
     // envia os novos dados para o cliente
-    QByteArray data = "";
     GameControl info;
     info.ballX        = this->ball->x();
     info.ballY        = this->ball->y();
@@ -608,8 +755,52 @@ void Game::playOnServer()
     info.paused       = this->paused;
     info.isGoal       = isGoal;
 
-    data.setRawData( (char*) &info, sizeof(GameControl) );
-    this->port->write(data);
+    QByteArray data( (char*) &info, sizeof(GameControl) );
+
+    // posição da bola sem arredondamento e velocidade, para o cliente suavizar
+    // o movimento
+    if ( this->activeOptions & OPT_SUBPIXEL_BALL ) {
+        GameControl * sent = (GameControl*) data.data();
+        qreal x = floor( this->ball->x() );
+        qreal y = floor( this->ball->y() );
+        sent->ballX = x;
+        sent->ballY = y;
+
+        BallMotion motion;
+        QPointF velocity = this->ball->getVelocity();
+        motion.ballFracX = ( this->ball->x() - x ) * 16;
+        motion.ballFracY = ( this->ball->y() - y ) * 16;
+        motion.velocityX = qBound( -BALL_VELOCITY_LIMIT * 64, qRound( velocity.x() * 64 ), BALL_VELOCITY_LIMIT * 64 - 1 );
+        motion.velocityY = qBound( -BALL_VELOCITY_LIMIT * 64, qRound( velocity.y() * 64 ), BALL_VELOCITY_LIMIT * 64 - 1 );
+        data.append( (char*) &motion, sizeof(BallMotion) );
+    }
+
+    // informa ao cliente quantos comandos anteriores enviar, conforme a perda medida
+    if ( NULL != this->inputDecoder ) {
+        data.append( (char) this->inputDecoder->suggestedDepth() );
+    }
+
+    this->sendData( data );
+
+    // envia o mesmo estado para os espectadores, sempre depois do adversário
+    if ( NULL != this->broadcaster ) {
+        QByteArray frame;
+        frame.reserve( sizeof(GameControl) + 2 );
+        frame.append( (char) FRAME_SYNC );
+        frame.append( (char*) &info, sizeof(GameControl) );
+        frame.append( (char) crc8( frame.constData() + 1, sizeof(GameControl) ) );
+        this->broadcaster->broadcast( frame );
+
+        // avisa quando um espectador não acompanha o jogo e perde quadros
+        for ( int i = 0; i < this->broadcaster->sinkCount(); i++ ) {
+            quint32 dropped = this->broadcaster->getDropped( i );
+            if ( dropped != this->spectatorDrops.at( i ) ) {
+                this->spectatorDrops[i] = dropped;
+                emit spectatorLagging( this->broadcaster->getSinkName( i ),
+                                       this->broadcaster->getQueueDepth( i ), dropped );
+            }
+        }
+    }
 
     // atualiza o placar atual
     this->scoreBoard->setTime( info.gameSeconds );
@@ -626,8 +817,13 @@ void Game::playOnServer()
  */
 void Game::playOnClient()
 {
-    // jogo só pode ser jogado com a conexão estabelecida
-    if ( this->port == NULL || !this->port->isOpen() ) {
+    // jogo só pode ser jogado com a conexão estabelecida; com o meio fechado
+    // (reconexão que falhou), continua tentando reabri-lo
+    if ( this->transport == NULL ) {
+        return;
+    }
+    if ( !this->transport->isOpen() ) {
+        this->checkLink( false );
         return;
     }
 
@@ -637,13 +833,151 @@ void Game::playOnClient()
     client.playerPos = this->player2->y();
     client.velocity  = this->speed;
 
-    data.setRawData( (char*) &client, sizeof(ClientInfo) );
-    this->port->write( data );
+    if ( NULL != this->inputEncoder ) {
+        data = this->inputEncoder->encode( client );
+    }
+    else {
+        // cópia: o quadro pode ficar na fila de saída depois deste método
+        data = QByteArray( (const char*) &client, sizeof(ClientInfo) );
+    }
+    this->sendData( data );
+
+    // recebe do servidor (com subpixel, seguido de BallMotion; no modo
+    // redundante, seguido do K sugerido) e aplica todas as mensagens
+    // completas, na ordem em que chegaram
+    bool subPixel = this->activeOptions & OPT_SUBPIXEL_BALL;
+    int size = sizeof(GameControl) + ( subPixel ? sizeof(BallMotion) : 0 ) + ( NULL != this->inputEncoder ? 1 : 0 );
+    int count = 0;
+    if ( NULL == this->fecDecoder && NULL == this->demultiplexer ) {
+        // sem FEC nem canais extras, as mensagens são interpretadas no
+        // próprio buffer do meio, sem cópia. Só a primeira aguarda o tempo
+        // limite; as seguintes são apenas as que já chegaram
+        int timeout = this->transport->getTimeout();
+        const char * message;
+        while ( NULL != ( message = this->transport->peek( size ) ) ) {
+            this->applyServerMessage( message, size );
+            this->transport->consume( size );
+            this->transport->setTimeout( 0 );
+            count++;
+        }
+        this->transport->setTimeout( timeout );
+    }
+    else {
+        QByteArray read = this->receiveData( size );
+        for ( int pos = 0; pos + size <= read.size(); pos += size ) {
+            this->applyServerMessage( read.constData() + pos, size );
+            count++;
+        }
+    }
 
-    // recebe do servidor
-    QByteArray read = this->port->read( sizeof(GameControl) );
-    GameControl * info = (GameControl*) read.data();
+    // nenhum quadro chegou a tempo: continua o movimento da bola com a última
+    // velocidade recebida, até o servidor corrigir a posição
+    if ( subPixel && 0 == count && !this->paused ) {
+        this->ball->moveBy( this->ballVelocity.x(), this->ballVelocity.y() );
+    }
+
+    this->checkLink( count > 0 );
+}
+
+/**
+ * Aplica uma mensagem completa recebida do servidor: GameControl, seguido de
+ * BallMotion (com subpixel) e do K sugerido (no modo redundante).
+ *
+ * @param message A mensagem.
+ * @param size    O tamanho da mensagem.
+ */
+void Game::applyServerMessage( const char * message, int size )
+{
+    this->applyGameControl( (const GameControl*) message );
 
+    if ( this->activeOptions & OPT_SUBPIXEL_BALL ) {
+        this->applyBallMotion( (const GameControl*) message,
+                               (const BallMotion*) ( message + sizeof(GameControl) ) );
+    }
+    if ( NULL != this->inputEncoder ) {
+        this->inputEncoder->setDepth( message[size - 1] );
+    }
+}
+
+/**
+ * Verifica se a conexão com o outro jogador continua ativa.
+ *
+ * Os dois lados enviam um quadro a cada TICK_INTERVAL, mesmo com o jogo
+ * pausado, então cada quadro recebido também serve como sinal de vida
+ * (heartbeat). Se nenhum quadro chegar durante Game::linkTimeout, o jogo é
+ * pausado, a mensagem de conexão perdida é exibida e o meio de comunicação é
+ * reaberto periodicamente (ver Transport::reconnect).
+ *
+ * Cada GameControl contém o estado completo do jogo, então a partida continua
+ * assim que o primeiro quadro chega depois da volta da conexão: o servidor
+ * responde no mesmo quadro em que recebe o cliente.
+ *
+ * @param received Indica se algum quadro válido chegou neste quadro do jogo.
+ */
+void Game::checkLink( bool received )
+{
+    if ( received ) {
+        this->lastReceived.start();
+
+        if ( this->linkLost ) {
+            this->linkLost = false;
+            this->paused = this->pausedBeforeLoss;
+            this->removeMessage();
+            emit linkStateChanged( true );
+        }
+    }
+    else if ( !this->linkLost && this->lastReceived.elapsed() > this->linkTimeout ) {
+        this->linkLost = true;
+        this->pausedBeforeLoss = this->paused;
+        this->paused = true;
+        this->removeMessage();
+        this->showMessage( "Conexão perdida. Reconectando...", -1 );
+        this->lastReconnect.start();
+        emit linkStateChanged( false );
+    }
+    else if ( this->linkLost && this->lastReconnect.elapsed() > RECONNECT_INTERVAL ) {
+        this->reconnect();
+        this->lastReconnect.start();
+    }
+}
+
+/**
+ * Reabre o meio de comunicação e descarta os quadros que aguardavam escrita e
+ * as mensagens incompletas que ficaram nos decodificadores.
+ *
+ * As mensagens que aguardam envio nos canais extras são mantidas.
+ */
+void Game::reconnect()
+{
+    if ( !this->transport->reconnect() ) {
+        return;
+    }
+
+    // o estado que aguardava envio já está velho
+    this->outputQueue->clear();
+
+    if ( NULL != this->fecDecoder ) {
+        delete this->fecDecoder;
+        this->fecDecoder = new FecDecoder();
+    }
+    if ( NULL != this->demultiplexer ) {
+        delete this->demultiplexer;
+        this->demultiplexer = new Demultiplexer();
+    }
+    if ( NULL != this->inputDecoder ) {
+        delete this->inputDecoder;
+        this->inputDecoder = new InputDecoder();
+    }
+}
+
+/**
+ * Aplica ao jogo o estado recebido do servidor.
+ *
+ * @param info As informações enviadas pelo servidor.
+ * @see Game::playOnClient
+ */
+void Game::applyGameControl( const GameControl * info )
+{
     // bola
     this->ball->setX( info->ballX );
     this->ball->setY( info->ballY );
@@ -665,6 +999,140 @@ void Game::playOnClient()
     }
 }
 
+/**
+ * Aplica a posição em subpixel e a velocidade da bola recebidas do servidor.
+ *
+ * @param info   As informações enviadas pelo servidor (parte inteira da posição).
+ * @param motion O complemento com a fração da posição e a velocidade.
+ * @see BallMotion
+ */
+void Game::applyBallMotion( const GameControl * info, const BallMotion * motion )
+{
+    this->ball->setX( info->ballX + motion->ballFracX / 16.0 );
+    this->ball->setY( info->ballY + motion->ballFracY / 16.0 );
+    this->ballVelocity = QPointF( motion->velocityX / 64.0, motion->velocityY / 64.0 );
+}
+
+/**
+ * Envia dados do jogo para o outro jogador.
+ *
+ * Com os canais extras ativos, os dados entram no canal CHANNEL_GAME e são
+ * enviados junto com o que couber dos outros canais neste quadro (sempre
+ * depois dos dados do jogo).
+ *
+ * Todos os quadros gerados são escritos com uma única chamada ao sistema (ou
+ * junto com os próximos, conforme Game::setBatchLatency).
+ *
+ * @param data Os dados a serem enviados.
+ * @see Multiplexer
+ */
+void Game::sendData( const QByteArray & data )
+{
+    if ( NULL != this->multiplexer ) {
+        this->multiplexer->enqueue( CHANNEL_GAME, data );
+
+        QList<QByteArray> segments = this->multiplexer->takeOutput( this->linkCapacity );
+        for ( int i = 0; i < segments.size(); i++ ) {
+            this->writeFrame( segments.at( i ) );
+        }
+    }
+    else {
+        this->writeFrame( data );
+    }
+
+    this->outputQueue->flush();
+}
+
+/**
+ * Coloca um quadro na fila de escrita (ver Game::sendData).
+ *
+ * Se a correção de erros estiver ativa, o quadro é enviado como uma mensagem
+ * codificada por Fec::encode.
+ *
+ * @param data O quadro a ser enviado.
+ */
+void Game::writeFrame( const QByteArray & data )
+{
+    if ( NULL != this->fecDecoder ) {
+        this->outputQueue->enqueue( Fec::encode( data ) );
+    }
+    else {
+        this->outputQueue->enqueue( data );
+    }
+}
+
+/**
+ * Lê os dados do jogo enviados pelo outro jogador.
+ *
+ * Sem correção de erros e sem canais extras, lê no máximo @a size bytes,
+ * aguardando o tempo limite configurado na conexão (ou todos os bytes
+ * disponíveis, se @a size for 0). Caso contrário, lê todos os bytes
+ * disponíveis e retorna o conteúdo das mensagens completas, já corrigidas.
+ *
+ * As mensagens recebidas nos outros canais são entregues pelo sinal
+ * Game::channelDataReceived.
+ *
+ * @param size O número de bytes esperado.
+ * @return Os dados recebidos.
+ */
+QByteArray Game::receiveData( int size )
+{
+    QByteArray data;
+
+    if ( NULL != this->fecDecoder ) {
+        this->fecDecoder->feed( this->transport->readAll() );
+
+        QList<QByteArray> messages = this->fecDecoder->takeMessages();
+        for ( int i = 0; i < messages.size(); i++ ) {
+            data.append( messages.at( i ) );
+        }
+    }
+    else if ( NULL != this->demultiplexer ) {
+        data = this->transport->readAll();
+    }
+    else {
+        return ( size > 0 ) ? this->transport->read( size ) : this->transport->readAll();
+    }
+
+    if ( NULL != this->demultiplexer ) {
+        this->demultiplexer->feed( data );
+
+        for ( int channel = CHANNEL_GAME + 1; channel < Multiplexer::MAX_CHANNELS; channel++ ) {
+            QList<QByteArray> messages = this->demultiplexer->takeMessages( channel );
+            for ( int i = 0; i < messages.size(); i++ ) {
+                emit channelDataReceived( channel, messages.at( i ) );
+            }
+        }
+
+        data.clear();
+        QList<QByteArray> messages = this->demultiplexer->takeMessages( CHANNEL_GAME );
+        for ( int i = 0; i < messages.size(); i++ ) {
+            data.append( messages.at( i ) );
+        }
+    }
+
+    return data;
+}
+
+/**
+ * Envia uma mensagem por um dos canais extras (chat, telemetria, arquivos...).
+ *
+ * A mensagem é enviada nos próximos quadros, respeitando a prioridade e o
+ * limite de bytes do canal, sem atrasar as mensagens do jogo.
+ *
+ * @param channel O canal (ver Channel). O canal CHANNEL_GAME é reservado.
+ * @param data    A mensagem.
+ * @return false se os canais extras não estão ativos ou o canal é inválido.
+ */
+bool Game::sendOnChannel( int channel, const QByteArray & data )
+{
+    if ( NULL == this->multiplexer || CHANNEL_GAME == channel ) {
+        return false;
+    }
+
+    return this->multiplexer->enqueue( channel, data );
+}
+
 /**
  * Método utilizado para exibir uma mensagem sobre o jogo.
  *
@@ -814,6 +1282,217 @@ QString Game::getRemotePlayerName() const
     return this->remotePlayerName;
 }
 
+/**
+ * Habilita ou desabilita o envio redundante dos comandos do cliente.
+ *
+ * Quando habilitado nos dois jogadores, cada quadro enviado pelo cliente contém
+ * também os últimos comandos anteriores, permitindo ao servidor recuperar
+ * comandos perdidos ou corrompidos sem retransmissão.
+ *
+ * @see InputEncoder
+ */
+void Game::setRedundantInput( bool enabled )
+{
+    if ( enabled ) {
+        this->protocolOptions |= OPT_REDUNDANT_INPUT;
+    }
+    else {
+        this->protocolOptions &= ~OPT_REDUNDANT_INPUT;
+    }
+}
+
+bool Game::getRedundantInput() const
+{
+    return this->protocolOptions & OPT_REDUNDANT_INPUT;
+}
+
+/**
+ * Número de comandos do cliente que foram perdidos e recuperados pela
+ * redundância. Disponível apenas no servidor.
+ */
+quint32 Game::getRecoveredInputs() const
+{
+    return ( NULL != this->inputDecoder ) ? this->inputDecoder->getRecovered() : 0;
+}
+
+/**
+ * Número de comandos do cliente que foram perdidos e não puderam ser
+ * recuperados. Disponível apenas no servidor.
+ */
+quint32 Game::getLostInputs() const
+{
+    return ( NULL != this->inputDecoder ) ? this->inputDecoder->getLost() : 0;
+}
+
+/**
+ * Habilita ou desabilita a correção de erros (FEC) nas mensagens trocadas.
+ *
+ * Indicado para cabos seriais longos ou sem blindagem: erros de 1 bit em cada
+ * bloco de 8 bytes são corrigidos sem retransmissão.
+ *
+ * @see Fec
+ */
+void Game::setErrorCorrection( bool enabled )
+{
+    if ( enabled ) {
+        this->protocolOptions |= OPT_ERROR_CORRECTION;
+    }
+    else {
+        this->protocolOptions &= ~OPT_ERROR_CORRECTION;
+    }
+}
+
+bool Game::getErrorCorrection() const
+{
+    return this->protocolOptions & OPT_ERROR_CORRECTION;
+}
+
+/**
+ * Habilita ou desabilita os canais extras sobre a conexão serial.
+ *
+ * Com os canais ativos, outras mensagens (chat, telemetria, arquivos) podem
+ * ser enviadas com Game::sendOnChannel sem interferir no jogo.
+ *
+ * @see Multiplexer
+ */
+void Game::setMultiplexing( bool enabled )
+{
+    if ( enabled ) {
+        this->protocolOptions |= OPT_MULTIPLEX;
+    }
+    else {
+        this->protocolOptions &= ~OPT_MULTIPLEX;
+    }
+}
+
+bool Game::getMultiplexing() const
+{
+    return this->protocolOptions & OPT_MULTIPLEX;
+}
+
+/**
+ * Habilita ou desabilita o envio da posição da bola com precisão de subpixel.
+ *
+ * O servidor passa a enviar também a velocidade da bola, que o cliente usa
+ * para continuar o movimento quando um quadro atrasa.
+ *
+ * @see BallMotion
+ */
+void Game::setSubPixelBall( bool enabled )
+{
+    if ( enabled ) {
+        this->protocolOptions |= OPT_SUBPIXEL_BALL;
+    }
+    else {
+        this->protocolOptions &= ~OPT_SUBPIXEL_BALL;
+    }
+}
+
+bool Game::getSubPixelBall() const
+{
+    return this->protocolOptions & OPT_SUBPIXEL_BALL;
+}
+
+/**
+ * Número de bits errados corrigidos nas mensagens recebidas.
+ */
+quint32 Game::getCorrectedErrors() const
+{
+    return ( NULL != this->fecDecoder ) ? this->fecDecoder->getCorrected() : 0;
+}
+
+/**
+ * Define o tempo sem receber nenhum quadro após o qual a conexão é considerada
+ * perdida.
+ *
+ * @param msecs O tempo limite, em milissegundos.
+ * @see Game::checkLink
+ */
+void Game::setLinkTimeout( int msecs )
+{
+    this->linkTimeout = msecs;
+}
+
+int Game::getLinkTimeout() const
+{
+    return this->linkTimeout;
+}
+
+/**
+ * Define por quanto tempo os quadros podem esperar para serem escritos junto
+ * com os dos próximos quadros do jogo.
+ *
+ * Com 0 (padrão), os quadros de cada quadro do jogo são escritos com uma
+ * única chamada. Com taxas de quadros altas, um limite maior reduz o número de
+ * chamadas de escrita ao custo de até @a msecs de atraso.
+ *
+ * @param msecs O atraso máximo, em milissegundos.
+ * @see OutputQueue
+ */
+void Game::setBatchLatency( int msecs )
+{
+    this->batchLatency = msecs;
+}
+
+int Game::getBatchLatency() const
+{
+    return this->batchLatency;
+}
+
+/**
+ * Número de chamadas de escrita feitas durante o jogo (sem contar os
+ * espectadores).
+ */
+quint64 Game::getWriteCalls() const
+{
+    return ( NULL != this->outputQueue ) ? this->outputQueue->getWriteCalls() : 0;
+}
+
+/**
+ * Verifica se a conexão com o outro jogador está ativa.
+ *
+ * @return false enquanto a conexão estiver perdida (jogo aguardando a volta
+ *         do outro jogador).
+ */
+bool Game::isConnected() const
+{
+    return !this->linkLost;
+}
+
+/**
+ * Define os espectadores que recebem o jogo (apenas no modo servidor).
+ *
+ * A cada quadro o servidor envia para cada espectador o quadro
+ * FRAME_SYNC | GameControl | CRC-8, que pode ser exibido em um telão.
+ *
+ * @param spectators Nomes das portas seriais ou de outros meios de
+ *                   comunicação (ver Transport::create).
+ * @see Broadcaster
+ */
+void Game::setSpectators( const QStringList & spectators )
+{
+    this->spectators = spectators;
+}
+
+QStringList Game::getSpectators() const
+{
+    return this->spectators;
+}
+
+/**
+ * Obtém o transmissor para os espectadores, com o tamanho da fila e o número
+ * de quadros descartados de cada um.
+ *
+ * O sinal spectatorLagging é emitido a cada quadro em que um espectador
+ * perde quadros.
+ *
+ * @return O transmissor, ou NULL se o jogo não tem espectadores.
+ */
+const Broadcaster * Game::getBroadcaster() const
+{
+    return this->broadcaster;
+}
+
 void Game::pauseGame()
 {
     this->paused = true;
@@ -2,75 +2,26 @@
 #define GAME_H
 
 #include <QGraphicsView>
+#include <QStringList>
+#include <QTime>
+
+#include "protocol.h"
 
 class Ball;
-class QextSerialPort;
+class Broadcaster;
+class FecDecoder;
+class InputDecoder;
+class InputEncoder;
+class Multiplexer;
+class OutputQueue;
+class Demultiplexer;
 class QString;
 class QTimer;
 class Player;
 class ScoreBoard;
+class Transport;
 class QGraphicsDropShadowEffect;
 
-/**
- * Define a estrutura utilizada na comunicação serial.
- *
- * Esse campo de bits é utilizado para definir os dados enviados do servidor
- * para o cliente pela comunicação serial.
- *
- * @note Essa estrutura ocupa no total 8 bytes ou 64 bits.
- */
-typedef struct {
-    // informações de posicionamento e informações do jogo
-    signed   ballX        : 12; /**< Posição X da bola (de -15 até 1015 = 11 bits) */
-    unsigned ballY        : 9;  /**< Posição Y da bola (de 0 até 500 = 9 bits) */
-    unsigned playerLeft   : 9;  /**< Posição Y do jogador da esquerda (de 0 até 370 = 9 bits) */
-    unsigned scoreLeft    : 6;  /**< Placar do jogador da esquerda (de 0 até 63 = 6 bits) */
-    unsigned scoreRight   : 6;  /**< Placar do jogador da direita (de 0 até 63 = 6 bits) */
-    unsigned gameSeconds  : 11; /**< Tempo de jogo em segundos (11 bits = 34min07s de jogo) */
-
-    // informações de controle gerais
-    unsigned ballRotation : 9;  /**< Rotação da bola (de 0 a 360 = 9 bits) */
-    unsigned paused       : 1;  /**< Bit que indica se o jogo está pausado (1) ou não (0). */
-    unsigned isGoal       : 1;  /**< Bit que indica se ocorreu um gol (para exibir a mensagem no cliente). */
-} GameControl;
-
-/**
- * Estrutura com informações do cliente.
- *
- * Durante o jogo, o lado cliente precisa enviar algumas informações para o
- * servidor (movimento do jogador, etc.). Essa estrutura define o formato dos
- * dados utilizados para essa comunicação.
- *
- * Da mesma forma que GameControl, essa estrutura é um campo de bits, e ocupa
- * 15 bits ou 2 bytes.
- */
-typedef struct {
-    unsigned playerPos : 9; /**< Posição Y do jogador da esquerda (de 0 até 370 = 9 bits) */
-    unsigned velocity  : 6; /**< Velocidade da bola configurada no cliente (de 1 a 25 = 6 bits) */
-} ClientInfo;
-
-/**
- * Estrutura utilizada para controlar o início do jogo.
- *
- * Os dois jogadores ficam enviando e recebendo essa estrutura até que ambos
- * informem que estão pronto para o jogo (campo ready definido como true).
- *
- * Na prática, essa struct impede que um jogador possa jogar sozinho contra um
- * adversário paralisado em campo (sem receber as informações enviadas pelo
- * outro computador - servidor ou cliente).
- *
- * É enviado também o gameMode, necessário saber se a configuração do outro
- * jogador é compatível, para não iniciar o jogo com dois servidores ou dois
- * clientes.
- *
- * @note Essa estrutura ocupa 91 bits, ou 12 bytes.
- */
-typedef struct {
-    bool ready;     /**< Flag que indica se o jogador está pronto para começar o jogo */
-    bool gameMode;  /**< Flag que indica o modo de jogo configurado. (false = 0 = SERVER, true = 1 = CLIENT) */
-    char name[10];  /**< Nome do jogador (10 caracteres) */
-} Greetings;
-
 /**
  * @class Game game.h "game.h"
  * Representa uma instância do jogo.
@@ -103,6 +54,13 @@ public:
     void setMoveWithMouse( bool move );
     void setLocalPlayerName( QString name );
     void setRemotePlayerName( QString name );
+    void setRedundantInput( bool enabled );
+    void setErrorCorrection( bool enabled );
+    void setMultiplexing( bool enabled );
+    void setSubPixelBall( bool enabled );
+    void setLinkTimeout( int msecs );
+    void setBatchLatency( int msecs );
+    void setSpectators( const QStringList & spectators );
 
     // getters
     QString  getPortName() const;
@@ -112,8 +70,27 @@ public:
     bool     getMoveWithMouse() const;
     QString  getLocalPlayerName() const;
     QString  getRemotePlayerName() const;
+    bool     getRedundantInput() const;
+    quint32  getRecoveredInputs() const;
+    quint32  getLostInputs() const;
+    bool     getErrorCorrection() const;
+    quint32  getCorrectedErrors() const;
+    bool     getMultiplexing() const;
+    bool     getSubPixelBall() const;
+    int      getLinkTimeout() const;
+    int      getBatchLatency() const;
+    quint64  getWriteCalls() const;
+    QStringList getSpectators() const;
+    const Broadcaster * getBroadcaster() const;
 
     bool isPlaying() const;
+    bool isConnected() const;
+    bool sendOnChannel( int channel, const QByteArray & data );
+
+signals:
+    void channelDataReceived( int channel, QByteArray data );
+    void linkStateChanged( bool connected );
+    void spectatorLagging( QString name, int queueDepth, quint32 dropped );
 
 public slots:
     void play();
@@ -137,12 +114,28 @@ private:
     Qt::Key  moveUpKeyCode;
     Qt::Key  moveDownKeyCode;
     bool     moveWithMouse;
+    quint8   protocolOptions;
+    int      linkTimeout;
+    int      batchLatency;
+    QStringList spectators;
 
     // controle do jogo
-    QextSerialPort * port;
+    Transport      * transport;
     QTimer         * timer;
     QTime          * gameTime;
     ScoreBoard     * scoreBoard;
+    InputEncoder   * inputEncoder;
+    InputDecoder   * inputDecoder;
+    FecDecoder     * fecDecoder;
+    Multiplexer    * multiplexer;
+    Demultiplexer  * demultiplexer;
+    Broadcaster    * broadcaster;
+    OutputQueue    * outputQueue;
+    int              linkCapacity;
+    QPointF          ballVelocity;
+    QTime            lastReceived;
+    QTime            lastReconnect;
+    QList<quint32>   spectatorDrops;
 
     QGraphicsTextItem         * displayedText;
     QGraphicsDropShadowEffect * displayedTextEffect;
@@ -150,9 +143,12 @@ private:
     unsigned short int player1score;
     unsigned short int player2score;
 
-    bool otherReady;
-    bool paused;
-    int  speed;
+    bool   otherReady;
+    bool   paused;
+    bool   linkLost;
+    bool   pausedBeforeLoss;
+    int    speed;
+    quint8 activeOptions;
 
     QString localPlayerName;
     QString remotePlayerName;
@@ -170,6 +166,14 @@ private:
     bool eventFilter( QObject * obj, QEvent * event );
 
     void configureSerialPort();
+    void sendData( const QByteArray & data );
+    void writeFrame( const QByteArray & data );
+    QByteArray receiveData( int size );
+    void applyServerMessage( const char * message, int size );
+    void applyGameControl( const GameControl * info );
+    void applyBallMotion( const GameControl * info, const BallMotion * motion );
+    void checkLink( bool received );
+    void reconnect();
     void initializeConfig();
     bool verifyGoal();
     void playerCollision();
@@ -232,6 +232,70 @@ void GameOptions::setEnableMouse( bool enabled )
     this->ui->chbEnableMouse->setChecked( enabled );
 }
 
+bool GameOptions::getRedundantInput() const
+{
+    return this->ui->chbRedundantInput->isChecked();
+}
+
+void GameOptions::setRedundantInput( bool enabled )
+{
+    this->ui->chbRedundantInput->setChecked( enabled );
+}
+
+bool GameOptions::getErrorCorrection() const
+{
+    return this->ui->chbErrorCorrection->isChecked();
+}
+
+void GameOptions::setErrorCorrection( bool enabled )
+{
+    this->ui->chbErrorCorrection->setChecked( enabled );
+}
+
+bool GameOptions::getMultiplexing() const
+{
+    return this->ui->chbMultiplexing->isChecked();
+}
+
+void GameOptions::setMultiplexing( bool enabled )
+{
+    this->ui->chbMultiplexing->setChecked( enabled );
+}
+
+bool GameOptions::getSubPixelBall() const
+{
+    return this->ui->chbSubPixelBall->isChecked();
+}
+
+void GameOptions::setSubPixelBall( bool enabled )
+{
+    this->ui->chbSubPixelBall->setChecked( enabled );
+}
+
+QStringList GameOptions::getSpectators() const
+{
+    QStringList spectators = this->ui->editSpectators->text().split( ',', QString::SkipEmptyParts );
+    for ( int i = 0; i < spectators.size(); i++ ) {
+        spectators[i] = spectators.at( i ).trimmed();
+    }
+    return spectators;
+}
+
+void GameOptions::setSpectators( const QStringList & spectators )
+{
+    this->ui->editSpectators->setText( spectators.join( ", " ) );
+}
+
+int GameOptions::getLinkTimeout() const
+{
+    return this->ui->spinLinkTimeout->value();
+}
+
+void GameOptions::setLinkTimeout( int msecs )
+{
+    this->ui->spinLinkTimeout->setValue( msecs );
+}
+
 Game::GameMode GameOptions::getGameMode() const
 {
     if ( this->ui->rdbServerMode->isChecked() ) {
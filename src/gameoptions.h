@@ -34,6 +34,12 @@ public:
     Qt::Key getMoveDownKey() const;
     Game::GameMode getGameMode() const;
     bool getEnableMouse() const;
+    bool getRedundantInput() const;
+    bool getErrorCorrection() const;
+    bool getMultiplexing() const;
+    bool getSubPixelBall() const;
+    QStringList getSpectators() const;
+    int getLinkTimeout() const;
 
     // setters
     void setSerialPort( QString portName );
@@ -42,6 +48,12 @@ public:
     void setMoveDownKey( Qt::Key keyCode );
     void setGameMode( Game::GameMode mode );
     void setEnableMouse( bool enabled );
+    void setRedundantInput( bool enabled );
+    void setErrorCorrection( bool enabled );
+    void setMultiplexing( bool enabled );
+    void setSubPixelBall( bool enabled );
+    void setSpectators( const QStringList & spectators );
+    void setLinkTimeout( int msecs );
 
 private slots:
     void btnMoveUpToggled( bool pressed );
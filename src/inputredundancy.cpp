@@ -0,0 +1,320 @@
+#include <cmath>
+
+#include "inputredundancy.h"
+
+// tamanho máximo do conteúdo de um quadro (seq + K + comando + K escapes)
+static const int MAX_PAYLOAD = 1 + 1 + 2 + InputEncoder::MAX_DEPTH * 3;
+
+// byte de escape utilizado quando a diferença não cabe em 1 byte
+static const quint8 ESCAPE = 0x80;
+
+/**
+ * Empacota um comando do cliente em 2 bytes (little-endian).
+ *
+ * Não utiliza o layout em memória do campo de bits, que depende do compilador.
+ */
+static void packClientInfo( QByteArray & out, const ClientInfo & info )
+{
+    quint16 value = info.playerPos | ( info.velocity << 9 );
+    out.append( (char) ( value & 0xff ) );
+    out.append( (char) ( value >> 8 ) );
+}
+
+/**
+ * Desempacota um comando gerado por packClientInfo.
+ */
+static ClientInfo unpackClientInfo( const char * data )
+{
+    quint16 value = (quint8) data[0] | ( (quint8) data[1] << 8 );
+    ClientInfo info;
+    info.playerPos = value & 0x1ff;
+    info.velocity  = ( value >> 9 ) & 0x3f;
+    return info;
+}
+
+/**
+ * Cria um novo codificador.
+ *
+ * Por padrão é enviado 1 comando anterior junto com cada comando.
+ */
+InputEncoder::InputEncoder()
+{
+    this->sequence    = 0;
+    this->depth       = 1;
+    this->historySize = 0;
+}
+
+/**
+ * Define quantos comandos anteriores (K) devem ser enviados em cada quadro.
+ *
+ * @param depth O número de comandos, entre 0 e InputEncoder::MAX_DEPTH.
+ */
+void InputEncoder::setDepth( int depth )
+{
+    this->depth = qBound( 0, depth, (int) MAX_DEPTH );
+}
+
+int InputEncoder::getDepth() const
+{
+    return this->depth;
+}
+
+/**
+ * Gera o quadro com o comando atual e os últimos K comandos.
+ *
+ * @param info O comando atual do cliente.
+ * @return O quadro pronto para ser enviado pela porta serial.
+ */
+QByteArray InputEncoder::encode( const ClientInfo & info )
+{
+    int count = qMin( this->depth, this->historySize );
+
+    QByteArray frame;
+    frame.reserve( 3 + MAX_PAYLOAD );
+    frame.append( (char) FRAME_SYNC );
+    frame.append( (char) 0 );   // tamanho, preenchido no final
+    frame.append( (char) this->sequence );
+    frame.append( (char) count );
+    packClientInfo( frame, info );
+
+    // cada comando anterior é codificado em relação ao comando seguinte
+    ClientInfo newer = info;
+    for ( int i = 0; i < count; i++ ) {
+        const ClientInfo & older = this->history[i];
+        int delta = (int) older.playerPos - (int) newer.playerPos;
+
+        if ( older.velocity == newer.velocity && delta >= -127 && delta <= 127 ) {
+            frame.append( (char) (qint8) delta );
+        }
+        else {
+            frame.append( (char) ESCAPE );
+            packClientInfo( frame, older );
+        }
+        newer = older;
+    }
+
+    frame[1] = (char) ( frame.size() - 2 );
+    frame.append( (char) crc8( frame.constData() + 1, frame.size() - 1 ) );
+
+    // guarda o comando atual no início do histórico
+    for ( int i = MAX_DEPTH - 1; i > 0; i-- ) {
+        this->history[i] = this->history[i - 1];
+    }
+    this->history[0] = info;
+    this->historySize = qMin( this->historySize + 1, (int) MAX_DEPTH );
+    this->sequence++;
+
+    return frame;
+}
+
+/**
+ * Cria um novo decodificador, sem nenhum quadro recebido.
+ */
+InputDecoder::InputDecoder()
+{
+    this->hasSequence    = false;
+    this->lastSequence   = 0;
+    this->received       = 0;
+    this->recovered      = 0;
+    this->lost           = 0;
+    this->corrupted      = 0;
+    this->lossWindow     = 0;
+    this->lossWindowSize = 0;
+}
+
+/**
+ * Adiciona os bytes lidos da porta serial e decodifica os quadros completos.
+ *
+ * Os bytes de um quadro incompleto são mantidos até a próxima chamada.
+ *
+ * @param data Os bytes recebidos.
+ */
+void InputDecoder::feed( const QByteArray & data )
+{
+    this->buffer.append( data );
+
+    int pos = 0;
+    while ( pos < this->buffer.size() ) {
+        const char * p = this->buffer.constData() + pos;
+        int available = this->buffer.size() - pos;
+
+        if ( (quint8) p[0] != FRAME_SYNC ) {
+            pos++;
+            continue;
+        }
+        if ( available < 2 ) {
+            break;
+        }
+
+        int len = (quint8) p[1];
+        if ( len < 4 || len > MAX_PAYLOAD ) {
+            pos++;
+            continue;
+        }
+        if ( available < len + 3 ) {
+            break;
+        }
+
+        if ( crc8( p + 1, len + 1 ) == (quint8) p[len + 2] && this->parseFrame( p + 2, len ) ) {
+            pos += len + 3;
+        }
+        else {
+            this->corrupted++;
+            pos++;
+        }
+    }
+
+    this->buffer.remove( 0, pos );
+}
+
+/**
+ * Interpreta o conteúdo de um quadro válido.
+ *
+ * @param frame Ponteiro para o conteúdo do quadro (a partir do campo seq).
+ * @param len   Tamanho do conteúdo.
+ * @return false se o conteúdo for inconsistente.
+ */
+bool InputDecoder::parseFrame( const char * frame, int len )
+{
+    quint8 sequence = (quint8) frame[0];
+    int count = (quint8) frame[1];
+    if ( count > InputEncoder::MAX_DEPTH ) {
+        return false;
+    }
+
+    ClientInfo history[InputEncoder::MAX_DEPTH + 1];
+    history[0] = unpackClientInfo( frame + 2 );
+
+    int pos = 4;
+    for ( int i = 1; i <= count; i++ ) {
+        if ( pos >= len ) {
+            return false;
+        }
+        if ( (quint8) frame[pos] == ESCAPE ) {
+            if ( pos + 3 > len ) {
+                return false;
+            }
+            history[i] = unpackClientInfo( frame + pos + 1 );
+            pos += 3;
+        }
+        else {
+            history[i] = history[i - 1];
+            history[i].playerPos = (int) history[i - 1].playerPos + (qint8) frame[pos];
+            pos += 1;
+        }
+    }
+
+    int gap = 0;
+    if ( this->hasSequence ) {
+        quint8 diff = sequence - this->lastSequence;
+
+        // quadro repetido ou atrasado: ignora
+        if ( diff == 0 || diff > 128 ) {
+            return true;
+        }
+        gap = diff - 1;
+    }
+
+    int recoverable = qMin( gap, count );
+    for ( int i = recoverable; i > 0; i-- ) {
+        this->inputs.append( history[i] );
+    }
+    this->inputs.append( history[0] );
+
+    for ( int i = 0; i < gap; i++ ) {
+        this->markFrame( true );
+    }
+    this->markFrame( false );
+
+    this->received++;
+    this->recovered += recoverable;
+    this->lost += gap - recoverable;
+    this->hasSequence = true;
+    this->lastSequence = sequence;
+
+    return true;
+}
+
+/**
+ * Registra um quadro esperado na janela de medição da taxa de perda.
+ */
+void InputDecoder::markFrame( bool frameLost )
+{
+    this->lossWindow = ( this->lossWindow << 1 ) | ( frameLost ? 1 : 0 );
+    this->lossWindowSize = qMin( this->lossWindowSize + 1, 64 );
+}
+
+/**
+ * Retorna os comandos decodificados desde a última chamada, na ordem em que
+ * foram gerados pelo cliente (incluindo os recuperados).
+ */
+QList<ClientInfo> InputDecoder::takeInputs()
+{
+    QList<ClientInfo> result = this->inputs;
+    this->inputs.clear();
+    return result;
+}
+
+/** Número de quadros recebidos corretamente. */
+quint32 InputDecoder::getReceived() const
+{
+    return this->received;
+}
+
+/** Número de comandos perdidos que foram recuperados pela redundância. */
+quint32 InputDecoder::getRecovered() const
+{
+    return this->recovered;
+}
+
+/** Número de comandos perdidos que não puderam ser recuperados. */
+quint32 InputDecoder::getLost() const
+{
+    return this->lost;
+}
+
+/** Número de quadros descartados por erro de CRC ou conteúdo inválido. */
+quint32 InputDecoder::getCorrupted() const
+{
+    return this->corrupted;
+}
+
+/**
+ * Taxa de perda de quadros medida nos últimos 64 quadros esperados.
+ *
+ * @return Um valor entre 0 e 1.
+ */
+double InputDecoder::getLossRate() const
+{
+    if ( 0 == this->lossWindowSize ) {
+        return 0;
+    }
+
+    int count = 0;
+    for ( quint64 w = this->lossWindow; w; w &= w - 1 ) {
+        count++;
+    }
+
+    return (double) count / this->lossWindowSize;
+}
+
+/**
+ * Sugere o número de comandos anteriores (K) que o cliente deve enviar.
+ *
+ * Considerando perdas independentes com taxa p, um comando só é perdido
+ * definitivamente se K + 1 quadros seguidos forem perdidos. É escolhido o menor
+ * K que mantém essa probabilidade abaixo de 0,1%.
+ *
+ * @return Um valor entre 1 e InputEncoder::MAX_DEPTH.
+ */
+int InputDecoder::suggestedDepth() const
+{
+    double p = this->getLossRate();
+
+    int depth = 1;
+    while ( depth < InputEncoder::MAX_DEPTH && std::pow( p, depth + 1 ) >= 0.001 ) {
+        depth++;
+    }
+
+    return depth;
+}
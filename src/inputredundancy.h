@@ -0,0 +1,92 @@
+#ifndef INPUTREDUNDANCY_H
+#define INPUTREDUNDANCY_H
+
+#include <QByteArray>
+#include <QList>
+
+#include "protocol.h"
+
+/**
+ * @class InputEncoder inputredundancy.h "inputredundancy.h"
+ * Codifica os comandos do cliente com redundância.
+ *
+ * Cada quadro enviado contém, além do comando atual, os últimos K comandos
+ * enviados anteriormente, codificados como diferenças em relação ao comando
+ * seguinte. Assim o servidor consegue recuperar comandos perdidos sem precisar
+ * pedir a retransmissão.
+ *
+ * Formato do quadro:
+ *
+ *      FRAME_SYNC | tamanho | seq | K | comando atual (2 bytes) | K diferenças | CRC-8
+ *
+ * Cada diferença ocupa 1 byte (deslocamento do jogador entre -127 e 127). Se o
+ * deslocamento não couber ou a velocidade mudou, é enviado o byte de escape
+ * 0x80 seguido do comando completo (2 bytes).
+ */
+class InputEncoder
+{
+public:
+    static const int MAX_DEPTH = 7;
+
+    InputEncoder();
+
+    void setDepth( int depth );
+    int  getDepth() const;
+
+    QByteArray encode( const ClientInfo & info );
+
+private:
+    quint8     sequence;
+    int        depth;
+    int        historySize;
+    ClientInfo history[MAX_DEPTH];
+};
+
+/**
+ * @class InputDecoder inputredundancy.h "inputredundancy.h"
+ * Decodifica os quadros gerados por InputEncoder no lado do servidor.
+ *
+ * Quadros corrompidos são descartados (verificação por CRC-8). Quando um ou
+ * mais quadros são perdidos, os comandos que faltam são recuperados a partir
+ * da redundância do próximo quadro válido.
+ *
+ * Também mede a taxa de perda recente, que é usada para sugerir ao cliente
+ * quantos comandos anteriores devem ser enviados em cada quadro.
+ */
+class InputDecoder
+{
+public:
+    InputDecoder();
+
+    void feed( const QByteArray & data );
+    QList<ClientInfo> takeInputs();
+
+    quint32 getReceived() const;
+    quint32 getRecovered() const;
+    quint32 getLost() const;
+    quint32 getCorrupted() const;
+
+    double getLossRate() const;
+    int    suggestedDepth() const;
+
+private:
+    QByteArray        buffer;
+    QList<ClientInfo> inputs;
+
+    bool    hasSequence;
+    quint8  lastSequence;
+
+    quint32 received;
+    quint32 recovered;
+    quint32 lost;
+    quint32 corrupted;
+
+    // janela dos últimos 64 quadros esperados (bit 1 = quadro perdido)
+    quint64 lossWindow;
+    int     lossWindowSize;
+
+    bool parseFrame( const char * frame, int len );
+    void markFrame( bool frameLost );
+};
+
+#endif // INPUTREDUNDANCY_H
@@ -0,0 +1,179 @@
+#include <QTime>
+
+#include "localtransport.h"
+
+QMutex                                              LocalTransport::pendingMutex;
+QMap< QString, QWeakPointer<LocalTransport::Link> > LocalTransport::pending;
+
+/**
+ * Cria o meio. A ligação com o outro lado só é feita em LocalTransport::open.
+ *
+ * @param name O nome da ligação, igual nos dois lados.
+ */
+LocalTransport::LocalTransport( const QString & name )
+{
+    this->name = name;
+    this->side = 0;
+}
+
+/**
+ * Destrutor. Desfaz a ligação.
+ */
+LocalTransport::~LocalTransport()
+{
+    this->close();
+}
+
+/**
+ * Cria a ligação ou, se o outro lado já foi aberto, conecta-se a ela.
+ *
+ * @return Sempre true.
+ */
+bool LocalTransport::open()
+{
+    this->close();
+
+    QMutexLocker locker( &pendingMutex );
+
+    QSharedPointer<Link> other = pending.take( this->name ).toStrongRef();
+    if ( !other.isNull() ) {
+        this->link = other;
+        this->side = 1;
+    }
+    else {
+        this->link = QSharedPointer<Link>( new Link() );
+        for ( int i = 0; i < 2; i++ ) {
+            this->link->queues[i].offset = 0;
+            this->link->queues[i].bytes  = 0;
+        }
+        pending.insert( this->name, this->link.toWeakRef() );
+        this->side = 0;
+    }
+
+    return true;
+}
+
+void LocalTransport::close()
+{
+    this->clearPeeked();
+    this->link.clear();
+}
+
+bool LocalTransport::isOpen() const
+{
+    return !this->link.isNull();
+}
+
+/**
+ * A ligação na memória não se perde: reabrir criaria uma ligação nova, sem o
+ * outro lado. Apenas mantém a atual.
+ */
+bool LocalTransport::reconnect()
+{
+    return this->isOpen();
+}
+
+/**
+ * Coloca os dados na fila do outro lado, sem copiá-los (os bytes são
+ * compartilhados com @a data). Por isso @a data não pode ser uma referência a
+ * memória de outro objeto (QByteArray::fromRawData).
+ */
+qint64 LocalTransport::write( const QByteArray & data )
+{
+    if ( this->link.isNull() ) {
+        return -1;
+    }
+    if ( data.isEmpty() ) {
+        return 0;
+    }
+
+    QMutexLocker locker( &this->link->mutex );
+
+    Queue & queue = this->link->queues[1 - this->side];
+    queue.chunks.append( data );
+    queue.bytes += data.size();
+    this->link->ready.wakeAll();
+
+    return data.size();
+}
+
+/**
+ * Lê até @a maxSize bytes, aguardando no máximo o tempo limite configurado.
+ */
+QByteArray LocalTransport::read( qint64 maxSize )
+{
+    if ( this->link.isNull() ) {
+        return QByteArray();
+    }
+
+    QMutexLocker locker( &this->link->mutex );
+    Queue & queue = this->link->queues[this->side];
+
+    QTime elapsed;
+    elapsed.start();
+
+    while ( queue.bytes < maxSize ) {
+        int remaining = this->timeout - elapsed.elapsed();
+        if ( remaining <= 0 || !this->link->ready.wait( &this->link->mutex, remaining ) ) {
+            break;
+        }
+    }
+
+    return this->take( queue, maxSize );
+}
+
+QByteArray LocalTransport::readAll()
+{
+    if ( this->link.isNull() ) {
+        return QByteArray();
+    }
+
+    QMutexLocker locker( &this->link->mutex );
+    Queue & queue = this->link->queues[this->side];
+
+    return this->take( queue, queue.bytes );
+}
+
+qint64 LocalTransport::bytesAvailable()
+{
+    if ( this->link.isNull() ) {
+        return 0;
+    }
+
+    QMutexLocker locker( &this->link->mutex );
+    return this->link->queues[this->side].bytes;
+}
+
+/**
+ * Retira até @a maxSize bytes de uma fila. Deve ser chamado com o mutex da
+ * ligação travado.
+ *
+ * Um bloco escrito inteiro é retornado sem cópia; só é necessário copiar
+ * quando a leitura junta vários blocos ou pega apenas parte de um.
+ */
+QByteArray LocalTransport::take( Queue & queue, qint64 maxSize )
+{
+    QByteArray data;
+
+    while ( maxSize > 0 && !queue.chunks.isEmpty() ) {
+        const QByteArray & chunk = queue.chunks.first();
+        int size = qMin( (qint64) chunk.size() - queue.offset, maxSize );
+
+        if ( data.isEmpty() && 0 == queue.offset && size == chunk.size() ) {
+            data = chunk;
+        }
+        else {
+            data.append( chunk.constData() + queue.offset, size );
+        }
+
+        maxSize -= size;
+        queue.bytes -= size;
+        queue.offset += size;
+        if ( queue.offset == chunk.size() ) {
+            queue.chunks.removeFirst();
+            queue.offset = 0;
+        }
+    }
+
+    return data;
+}
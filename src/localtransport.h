@@ -0,0 +1,64 @@
+#ifndef LOCALTRANSPORT_H
+#define LOCALTRANSPORT_H
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#include "transport.h"
+
+/**
+ * @class LocalTransport localtransport.h "localtransport.h"
+ * Comunicação por uma fila na memória, entre dois objetos do mesmo processo.
+ *
+ * Os dois lados são ligados pelo nome: o primeiro LocalTransport aberto com um
+ * nome cria a ligação e o segundo se conecta a ela. Os dois lados podem estar
+ * em threads diferentes.
+ *
+ * Os dados não são copiados: cada escrita entra na fila do outro lado como um
+ * QByteArray compartilhado, e uma leitura do mesmo tamanho da escrita (o caso
+ * comum, um quadro por vez) retorna o próprio objeto escrito.
+ */
+class LocalTransport : public Transport
+{
+public:
+    explicit LocalTransport( const QString & name );
+    ~LocalTransport();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+    bool reconnect();
+
+    qint64     write( const QByteArray & data );
+    QByteArray read( qint64 maxSize );
+    QByteArray readAll();
+    qint64     bytesAvailable();
+
+private:
+    struct Queue {
+        QList<QByteArray> chunks;
+        int               offset;   // bytes já lidos do primeiro bloco
+        qint64            bytes;    // bytes disponíveis para leitura
+    };
+
+    struct Link {
+        QMutex         mutex;
+        QWaitCondition ready;
+        Queue          queues[2];
+    };
+
+    // ligações criadas que aguardam o segundo lado, por nome
+    static QMutex                              pendingMutex;
+    static QMap< QString, QWeakPointer<Link> > pending;
+
+    QString              name;
+    QSharedPointer<Link> link;
+    int                  side;  // fila de leitura deste lado (0 ou 1)
+
+    QByteArray take( Queue & queue, qint64 maxSize );
+};
+
+#endif // LOCALTRANSPORT_H
@@ -1,5 +1,6 @@
 #include <QMessageBox>
 #include <QMainWindow>
+#include <QStatusBar>
 #include <QDebug>
 
 #include "mainwindow.h"
@@ -105,6 +106,12 @@ void MainWindow::startNewGame()
     this->game->setMoveDownKeyCode( this->op->getMoveDownKey() );
     this->game->setMoveWithMouse( this->op->getEnableMouse() );
     this->game->setLocalPlayerName( this->op->getPlayerName() );
+    this->game->setRedundantInput( this->op->getRedundantInput() );
+    this->game->setErrorCorrection( this->op->getErrorCorrection() );
+    this->game->setMultiplexing( this->op->getMultiplexing() );
+    this->game->setSpectators( this->op->getSpectators() );
+    this->game->setSubPixelBall( this->op->getSubPixelBall() );
+    this->game->setLinkTimeout( this->op->getLinkTimeout() );
 
     // não precisamos mais da tela de opções
     delete this->op;
@@ -112,7 +119,22 @@ void MainWindow::startNewGame()
 
     connect( this->ui->actionSpeedPlus,  SIGNAL(triggered()), this->game, SLOT(accelerate()) );
     connect( this->ui->actionSpeedMinus, SIGNAL(triggered()), this->game, SLOT(deaccelerate()) );
+    connect( this->game, SIGNAL(spectatorLagging(QString,int,quint32)),
+             this, SLOT(spectatorLagging(QString,int,quint32)) );
 
     // Vamos jogar!
     this->game->readyToPlay();
 }
+
+/**
+ * Slot que exibe na barra de status um espectador que não acompanha o jogo.
+ *
+ * @param name       O meio de comunicação do espectador.
+ * @param queueDepth Quadros que aguardam envio para o espectador.
+ * @param dropped    Total de quadros descartados.
+ */
+void MainWindow::spectatorLagging( QString name, int queueDepth, quint32 dropped )
+{
+    this->statusBar()->showMessage( QString( "Espectador %1 atrasado: %2 quadros na fila, %3 descartados" )
+                                    .arg( name ).arg( queueDepth ).arg( dropped ), 3000 );
+}
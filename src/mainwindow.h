@@ -32,6 +32,7 @@ private slots:
     void about();
     void closeConfigDialog( int status );
     void startNewGame();
+    void spectatorLagging( QString name, int queueDepth, quint32 dropped );
 
 private:
     Ui::MainWindow * ui;
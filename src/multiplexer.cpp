@@ -0,0 +1,240 @@
+#include "multiplexer.h"
+#include "protocol.h"
+
+// flags do primeiro e do último segmento de uma mensagem
+static const quint8 FLAG_START = 0x02;
+static const quint8 FLAG_END   = 0x01;
+
+/**
+ * Cria um multiplexador sem nenhum canal.
+ */
+Multiplexer::Multiplexer()
+{
+    for ( int i = 0; i < MAX_CHANNELS; i++ ) {
+        this->channels[i].used     = false;
+        this->channels[i].priority = 0;
+        this->channels[i].budget   = 0;
+        this->channels[i].sequence = 0;
+        this->channels[i].offset   = 0;
+    }
+}
+
+/**
+ * Adiciona (ou reconfigura) um canal.
+ *
+ * @param channel  O número do canal (de 0 até Multiplexer::MAX_CHANNELS - 1).
+ * @param priority A prioridade do canal. Canais com maior prioridade sempre são
+ *                 enviados antes.
+ * @param budget   Número máximo de bytes que o canal pode enviar a cada quadro
+ *                 (0 = sem limite).
+ */
+void Multiplexer::addChannel( int channel, int priority, int budget )
+{
+    if ( channel < 0 || channel >= MAX_CHANNELS ) {
+        return;
+    }
+
+    this->channels[channel].used     = true;
+    this->channels[channel].priority = priority;
+    this->channels[channel].budget   = budget;
+
+    // mantém a lista de canais ordenada pela prioridade
+    this->order.removeAll( channel );
+    int pos = 0;
+    while ( pos < this->order.size() && this->channels[this->order.at( pos )].priority >= priority ) {
+        pos++;
+    }
+    this->order.insert( pos, channel );
+}
+
+/**
+ * Adiciona uma mensagem na fila de um canal.
+ *
+ * @return false se o canal não existe ou a mensagem está vazia.
+ */
+bool Multiplexer::enqueue( int channel, const QByteArray & data )
+{
+    if ( channel < 0 || channel >= MAX_CHANNELS || !this->channels[channel].used || data.isEmpty() ) {
+        return false;
+    }
+
+    this->channels[channel].queue.append( data );
+    return true;
+}
+
+/**
+ * Número de bytes que ainda aguardam envio em um canal.
+ */
+int Multiplexer::pendingBytes( int channel ) const
+{
+    if ( channel < 0 || channel >= MAX_CHANNELS ) {
+        return 0;
+    }
+
+    const Channel & ch = this->channels[channel];
+    int bytes = -ch.offset;
+    for ( int i = 0; i < ch.queue.size(); i++ ) {
+        bytes += ch.queue.at( i ).size();
+    }
+    return bytes;
+}
+
+/**
+ * Gera os segmentos a serem enviados neste quadro.
+ *
+ * Os canais são percorridos em ordem de prioridade, e cada um envia no máximo
+ * o seu orçamento. As mensagens que não couberem continuam na fila para o
+ * próximo quadro.
+ *
+ * @param capacity Número de bytes que o link consegue transmitir até o próximo
+ *                 quadro.
+ * @return Os segmentos, na ordem em que devem ser escritos na porta serial.
+ */
+QList<QByteArray> Multiplexer::takeOutput( int capacity )
+{
+    QList<QByteArray> segments;
+
+    for ( int i = 0; i < this->order.size() && capacity > OVERHEAD; i++ ) {
+        Channel & ch = this->channels[this->order.at( i )];
+        int budget = ( ch.budget > 0 ) ? ch.budget : capacity;
+
+        while ( !ch.queue.isEmpty() && capacity > OVERHEAD && budget > OVERHEAD ) {
+            const QByteArray & message = ch.queue.first();
+            int size = qMin( message.size() - ch.offset, (int) MAX_SEGMENT );
+            size = qMin( size, qMin( capacity, budget ) - OVERHEAD );
+
+            bool start = ( 0 == ch.offset );
+            bool end = ( ch.offset + size == message.size() );
+
+            QByteArray segment;
+            segment.reserve( size + OVERHEAD );
+            segment.append( (char) FRAME_SYNC );
+            segment.append( (char) ( ( this->order.at( i ) << 4 ) | ( start ? FLAG_START : 0 ) | ( end ? FLAG_END : 0 ) ) );
+            segment.append( (char) ch.sequence++ );
+            segment.append( (char) size );
+            segment.append( message.constData() + ch.offset, size );
+            segment.append( (char) crc8( segment.constData() + 1, segment.size() - 1 ) );
+            segments.append( segment );
+
+            capacity -= segment.size();
+            budget -= segment.size();
+
+            if ( end ) {
+                ch.queue.removeFirst();
+                ch.offset = 0;
+            }
+            else {
+                ch.offset += size;
+            }
+        }
+    }
+
+    return segments;
+}
+
+/**
+ * Cria um demultiplexador sem nenhuma mensagem recebida.
+ */
+Demultiplexer::Demultiplexer()
+{
+    for ( int i = 0; i < Multiplexer::MAX_CHANNELS; i++ ) {
+        this->expecting[i] = false;
+        this->sequence[i]  = 0;
+    }
+    this->dropped = 0;
+}
+
+/**
+ * Adiciona os bytes recebidos e separa os segmentos completos.
+ *
+ * @param data Os bytes lidos da porta serial.
+ */
+void Demultiplexer::feed( const QByteArray & data )
+{
+    this->buffer.append( data );
+
+    int pos = 0;
+    while ( this->buffer.size() - pos >= Multiplexer::OVERHEAD ) {
+        const char * p = this->buffer.constData() + pos;
+
+        int len = (quint8) p[3];
+        if ( (quint8) p[0] != FRAME_SYNC || len > Multiplexer::MAX_SEGMENT ) {
+            pos++;
+            continue;
+        }
+        if ( this->buffer.size() - pos < len + Multiplexer::OVERHEAD ) {
+            break;
+        }
+        if ( crc8( p + 1, len + 3 ) != (quint8) p[len + 4] ) {
+            this->dropped++;
+            pos++;
+            continue;
+        }
+
+        this->parseSegment( p + 1, len );
+        pos += len + Multiplexer::OVERHEAD;
+    }
+
+    this->buffer.remove( 0, pos );
+}
+
+/**
+ * Adiciona um segmento válido à mensagem do seu canal.
+ *
+ * @param segment Ponteiro para o segmento, a partir do byte de canal e flags.
+ * @param len     Tamanho dos dados do segmento.
+ */
+void Demultiplexer::parseSegment( const char * segment, int len )
+{
+    int channel = (quint8) segment[0] >> 4;
+    quint8 flags = segment[0] & 0x0f;
+    quint8 seq = segment[1];
+
+    bool inOrder = this->expecting[channel] && seq == this->sequence[channel];
+    this->expecting[channel] = true;
+    this->sequence[channel] = seq + 1;
+
+    if ( flags & FLAG_START ) {
+        // a mensagem anterior ficou incompleta
+        if ( !this->partial[channel].isEmpty() ) {
+            this->dropped++;
+        }
+        this->partial[channel] = QByteArray( segment + 3, len );
+    }
+    else if ( inOrder && !this->partial[channel].isEmpty() ) {
+        this->partial[channel].append( segment + 3, len );
+    }
+    else {
+        // o início da mensagem foi perdido: descarta até a próxima mensagem
+        this->partial[channel].clear();
+        this->dropped++;
+        return;
+    }
+
+    if ( flags & FLAG_END ) {
+        this->messages[channel].append( this->partial[channel] );
+        this->partial[channel].clear();
+    }
+}
+
+/**
+ * Retorna as mensagens completas recebidas em um canal desde a última chamada.
+ */
+QList<QByteArray> Demultiplexer::takeMessages( int channel )
+{
+    if ( channel < 0 || channel >= Multiplexer::MAX_CHANNELS ) {
+        return QList<QByteArray>();
+    }
+
+    QList<QByteArray> result = this->messages[channel];
+    this->messages[channel].clear();
+    return result;
+}
+
+/**
+ * Número de segmentos ou mensagens incompletas descartados.
+ */
+quint32 Demultiplexer::getDropped() const
+{
+    return this->dropped;
+}
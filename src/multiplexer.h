@@ -0,0 +1,83 @@
+#ifndef MULTIPLEXER_H
+#define MULTIPLEXER_H
+
+#include <QByteArray>
+#include <QList>
+
+/**
+ * @class Multiplexer multiplexer.h "multiplexer.h"
+ * Divide a conexão serial em vários canais com prioridades diferentes.
+ *
+ * Cada canal possui uma fila de mensagens, uma prioridade e um limite de bytes
+ * (orçamento) que pode enviar a cada quadro do jogo. As mensagens são quebradas
+ * em segmentos de até Multiplexer::MAX_SEGMENT bytes:
+ *
+ *      FRAME_SYNC | canal + flags | seq | tamanho | dados | CRC-8
+ *
+ * A cada quadro, Multiplexer::takeOutput gera os segmentos começando pelo canal
+ * de maior prioridade e sem ultrapassar a capacidade do link no intervalo de
+ * um quadro. Assim a fila de transmissão está vazia quando o próximo quadro do
+ * jogo é enviado, e o atraso adicionado às mensagens do jogo é no máximo o
+ * byte que ainda está sendo transmitido.
+ */
+class Multiplexer
+{
+public:
+    static const int MAX_CHANNELS = 16;
+    static const int MAX_SEGMENT  = 64;
+    static const int OVERHEAD     = 5;
+
+    Multiplexer();
+
+    void addChannel( int channel, int priority, int budget = 0 );
+    bool enqueue( int channel, const QByteArray & data );
+    int  pendingBytes( int channel ) const;
+
+    QList<QByteArray> takeOutput( int capacity );
+
+private:
+    struct Channel {
+        bool              used;
+        int               priority;
+        int               budget;   // bytes por quadro (0 = sem limite)
+        quint8            sequence;
+        int               offset;   // bytes já enviados da primeira mensagem da fila
+        QList<QByteArray> queue;
+    };
+
+    Channel channels[MAX_CHANNELS];
+    QList<int> order;   // canais ordenados por prioridade (maior primeiro)
+};
+
+/**
+ * @class Demultiplexer multiplexer.h "multiplexer.h"
+ * Separa os segmentos recebidos e remonta as mensagens de cada canal.
+ *
+ * Segmentos corrompidos são descartados (CRC-8). Se um segmento de uma
+ * mensagem for perdido (número de sequência fora de ordem), a mensagem
+ * incompleta é descartada.
+ */
+class Demultiplexer
+{
+public:
+    Demultiplexer();
+
+    void feed( const QByteArray & data );
+    QList<QByteArray> takeMessages( int channel );
+
+    quint32 getDropped() const;
+
+private:
+    QByteArray buffer;
+
+    bool              expecting[Multiplexer::MAX_CHANNELS];
+    quint8            sequence[Multiplexer::MAX_CHANNELS];
+    QByteArray        partial[Multiplexer::MAX_CHANNELS];
+    QList<QByteArray> messages[Multiplexer::MAX_CHANNELS];
+
+    quint32 dropped;
+
+    void parseSegment( const char * segment, int len );
+};
+
+#endif // MULTIPLEXER_H
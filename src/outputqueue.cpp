@@ -0,0 +1,205 @@
+#include "outputqueue.h"
+#include "transport.h"
+
+/**
+ * Cria a fila, sem limite de latência (cada OutputQueue::flush escreve).
+ *
+ * @param transport O meio em que os quadros são escritos.
+ */
+OutputQueue::OutputQueue( Transport * transport )
+{
+    this->transport     = transport;
+    this->offset        = 0;
+    this->bytes         = 0;
+    this->latencyCap    = 0;
+    this->maxBatch      = 4096;
+    this->maxAge        = MAX_AGE;
+    this->writeCalls    = 0;
+    this->framesWritten = 0;
+    this->framesDropped = 0;
+}
+
+/**
+ * Define por quanto tempo um quadro pode esperar na fila para ser enviado
+ * junto com os próximos.
+ *
+ * @param msecs O tempo máximo, em milissegundos (0 = sem espera).
+ */
+void OutputQueue::setLatencyCap( int msecs )
+{
+    this->latencyCap = msecs;
+}
+
+int OutputQueue::getLatencyCap() const
+{
+    return this->latencyCap;
+}
+
+/**
+ * Define o número de bytes na fila a partir do qual a escrita é feita mesmo
+ * que o limite de latência não tenha sido atingido.
+ */
+void OutputQueue::setMaxBatch( int bytes )
+{
+    this->maxBatch = bytes;
+}
+
+int OutputQueue::getMaxBatch() const
+{
+    return this->maxBatch;
+}
+
+/**
+ * Define por quanto tempo um quadro que o meio não aceita (link lento ou
+ * desconectado) continua na fila antes de ser descartado. O limite de
+ * latência prevalece se for maior.
+ *
+ * @param msecs O tempo máximo, em milissegundos.
+ */
+void OutputQueue::setMaxAge( int msecs )
+{
+    this->maxAge = msecs;
+}
+
+int OutputQueue::getMaxAge() const
+{
+    return this->maxAge;
+}
+
+/**
+ * Adiciona um quadro ao fim da fila. Nada é escrito até OutputQueue::flush.
+ *
+ * Se a fila passar de OutputQueue::MAX_QUEUED bytes, os quadros mais antigos
+ * são descartados.
+ */
+void OutputQueue::enqueue( const QByteArray & frame )
+{
+    if ( frame.isEmpty() ) {
+        return;
+    }
+
+    QTime now;
+    now.start();
+    this->frames.append( frame );
+    this->queued.append( now );
+    this->bytes += frame.size();
+
+    // o primeiro quadro, se já foi escrito em parte, precisa ser terminado
+    int first = ( this->offset > 0 ) ? 1 : 0;
+    while ( this->bytes > MAX_QUEUED && this->frames.size() > first + 1 ) {
+        this->dropFrame( first );
+    }
+}
+
+/**
+ * Escreve os quadros da fila com uma única chamada, se o quadro mais antigo
+ * já esperou o limite de latência ou se a fila atingiu o tamanho máximo.
+ *
+ * O que o meio não aceitar continua na fila, na mesma ordem.
+ *
+ * @param force Escreve mesmo que o limite de latência não tenha sido atingido.
+ * @return true se alguma escrita foi feita.
+ */
+bool OutputQueue::flush( bool force )
+{
+    this->dropStale();
+
+    if ( this->frames.isEmpty() ) {
+        return false;
+    }
+    if ( !force && this->queued.first().elapsed() < this->latencyCap && this->bytes < this->maxBatch ) {
+        return false;
+    }
+
+    QList<QByteArray> buffers = this->frames;
+    if ( this->offset > 0 ) {
+        buffers[0] = buffers.at( 0 ).mid( this->offset );
+    }
+
+    qint64 written = this->transport->writev( buffers );
+    this->writeCalls++;
+    if ( written <= 0 ) {
+        return true;
+    }
+
+    // remove os quadros escritos por completo
+    written += this->offset;
+    while ( !this->frames.isEmpty() && written >= this->frames.first().size() ) {
+        written -= this->frames.first().size();
+        this->bytes -= this->frames.first().size();
+        this->frames.removeFirst();
+        this->queued.removeFirst();
+        this->framesWritten++;
+    }
+    this->offset = written;
+
+    return true;
+}
+
+/**
+ * Descarta todos os quadros da fila, inclusive um escrito em parte. Usado ao
+ * reabrir o meio, quando o outro lado já não espera o restante dele.
+ */
+void OutputQueue::clear()
+{
+    this->framesDropped += this->frames.size();
+    this->frames.clear();
+    this->queued.clear();
+    this->offset = 0;
+    this->bytes  = 0;
+}
+
+/**
+ * Número de bytes que aguardam na fila.
+ */
+int OutputQueue::pendingBytes() const
+{
+    return this->bytes - this->offset;
+}
+
+/**
+ * Número de chamadas de escrita feitas desde a criação da fila.
+ */
+quint64 OutputQueue::getWriteCalls() const
+{
+    return this->writeCalls;
+}
+
+/**
+ * Número de quadros escritos por completo desde a criação da fila.
+ */
+quint64 OutputQueue::getFramesWritten() const
+{
+    return this->framesWritten;
+}
+
+/**
+ * Número de quadros descartados sem terem sido escritos por completo, por
+ * terem esperado demais ou por falta de espaço na fila.
+ */
+quint64 OutputQueue::getFramesDropped() const
+{
+    return this->framesDropped;
+}
+
+/**
+ * Descarta os quadros que esperam há mais tempo que o permitido. Um quadro
+ * escrito em parte é mantido, para não cortar a mensagem no meio.
+ */
+void OutputQueue::dropStale()
+{
+    int limit = qMax( this->maxAge, this->latencyCap );
+    int first = ( this->offset > 0 ) ? 1 : 0;
+
+    while ( this->frames.size() > first && this->queued.at( first ).elapsed() > limit ) {
+        this->dropFrame( first );
+    }
+}
+
+void OutputQueue::dropFrame( int index )
+{
+    this->bytes -= this->frames.at( index ).size();
+    this->frames.removeAt( index );
+    this->queued.removeAt( index );
+    this->framesDropped++;
+}
@@ -0,0 +1,73 @@
+#ifndef OUTPUTQUEUE_H
+#define OUTPUTQUEUE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QTime>
+
+class Transport;
+
+/**
+ * @class OutputQueue outputqueue.h "outputqueue.h"
+ * Junta os quadros a serem enviados para escrevê-los de uma só vez.
+ *
+ * Cada quadro escrito separadamente custa uma chamada ao sistema. Com os
+ * canais extras e a correção de erros, um único quadro do jogo gera vários
+ * quadros no link; com taxas de quadros maiores, o número de chamadas passa a
+ * limitar o desempenho.
+ *
+ * Os quadros ficam na fila até OutputQueue::flush, que os escreve com uma
+ * única chamada a Transport::writev. Com um limite de latência maior que zero,
+ * os quadros de vários quadros do jogo podem ser enviados juntos, desde que o
+ * mais antigo não espere mais que o limite (ou que a fila não ultrapasse
+ * OutputQueue::getMaxBatch bytes).
+ *
+ * Cada quadro leva o estado do jogo naquele instante, então um quadro que o
+ * meio não aceitou a tempo não serve mais: os que esperam mais que
+ * OutputQueue::getMaxAge (ou que o limite de latência, se for maior) são
+ * descartados, e a fila guarda no máximo OutputQueue::MAX_QUEUED bytes,
+ * descartando os mais antigos.
+ */
+class OutputQueue
+{
+public:
+    static const int MAX_AGE    = 100;      // espera máxima padrão, em ms
+    static const int MAX_QUEUED = 16384;    // bytes
+
+    explicit OutputQueue( Transport * transport );
+
+    void setLatencyCap( int msecs );
+    int  getLatencyCap() const;
+    void setMaxBatch( int bytes );
+    int  getMaxBatch() const;
+    void setMaxAge( int msecs );
+    int  getMaxAge() const;
+
+    void enqueue( const QByteArray & frame );
+    bool flush( bool force = false );
+    void clear();
+    int  pendingBytes() const;
+
+    quint64 getWriteCalls() const;
+    quint64 getFramesWritten() const;
+    quint64 getFramesDropped() const;
+
+private:
+    Transport       * transport;
+    QList<QByteArray> frames;
+    int               offset;       // bytes já escritos do primeiro quadro
+    int               bytes;        // bytes na fila (sem descontar offset)
+    QList<QTime>      queued;       // quando cada quadro entrou na fila
+    int               latencyCap;
+    int               maxBatch;
+    int               maxAge;
+
+    quint64 writeCalls;
+    quint64 framesWritten;
+    quint64 framesDropped;
+
+    void dropStale();
+    void dropFrame( int index );
+};
+
+#endif // OUTPUTQUEUE_H
@@ -0,0 +1,25 @@
+#include "protocol.h"
+
+/**
+ * Calcula o CRC-8 (polinômio 0x07) de um bloco de dados.
+ *
+ * Utilizado para verificar a integridade dos quadros de tamanho variável
+ * enviados pela comunicação serial.
+ *
+ * @param data Ponteiro para o início dos dados.
+ * @param len  Número de bytes a serem considerados.
+ * @return O valor do CRC calculado.
+ */
+quint8 crc8( const char * data, int len )
+{
+    quint8 crc = 0;
+
+    for ( int i = 0; i < len; i++ ) {
+        crc ^= (quint8) data[i];
+        for ( int bit = 0; bit < 8; bit++ ) {
+            crc = ( crc & 0x80 ) ? (quint8) ( ( crc << 1 ) ^ 0x07 ) : (quint8) ( crc << 1 );
+        }
+    }
+
+    return crc;
+}
@@ -0,0 +1,138 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <QtGlobal>
+
+/**
+ * @file protocol.h
+ * Estruturas e constantes do protocolo utilizado na comunicação serial.
+ */
+
+/**
+ * @def FRAME_SYNC
+ * Byte que marca o início de um quadro (frame) de tamanho variável.
+ *
+ * Utilizado para ressincronizar a leitura quando algum byte é perdido ou
+ * corrompido na transmissão.
+ */
+#define FRAME_SYNC 0xA5
+
+/**
+ * Opções do protocolo.
+ *
+ * Cada jogador informa as opções habilitadas localmente na estrutura
+ * Greetings, e apenas as opções habilitadas nos dois lados são utilizadas
+ * durante o jogo.
+ */
+enum ProtocolOption {
+    OPT_REDUNDANT_INPUT  = 0x01, /**< O cliente envia junto com cada comando os últimos K comandos anteriores. */
+    OPT_ERROR_CORRECTION = 0x02, /**< As mensagens são enviadas com código corretor de erros (ver Fec). */
+    OPT_MULTIPLEX        = 0x04, /**< A conexão é dividida em canais com prioridades (ver Multiplexer). */
+    OPT_SUBPIXEL_BALL    = 0x08  /**< O servidor envia BallMotion junto com cada GameControl. */
+};
+
+/**
+ * Canais disponíveis quando a opção OPT_MULTIPLEX está ativa.
+ */
+enum Channel {
+    CHANNEL_GAME      = 0, /**< Mensagens do jogo (GameControl, ClientInfo). Maior prioridade. */
+    CHANNEL_CHAT      = 1, /**< Mensagens de texto entre os jogadores. */
+    CHANNEL_TELEMETRY = 2, /**< Estatísticas da conexão e do jogo. */
+    CHANNEL_BULK      = 3  /**< Transferência de arquivos (replays). Menor prioridade. */
+};
+
+/**
+ * Define a estrutura utilizada na comunicação serial.
+ *
+ * Esse campo de bits é utilizado para definir os dados enviados do servidor
+ * para o cliente pela comunicação serial.
+ *
+ * @note Essa estrutura ocupa no total 8 bytes ou 64 bits.
+ */
+typedef struct {
+    // informações de posicionamento e informações do jogo
+    signed   ballX        : 12; /**< Posição X da bola (de -15 até 1015 = 11 bits) */
+    unsigned ballY        : 9;  /**< Posição Y da bola (de 0 até 500 = 9 bits) */
+    unsigned playerLeft   : 9;  /**< Posição Y do jogador da esquerda (de 0 até 370 = 9 bits) */
+    unsigned scoreLeft    : 6;  /**< Placar do jogador da esquerda (de 0 até 63 = 6 bits) */
+    unsigned scoreRight   : 6;  /**< Placar do jogador da direita (de 0 até 63 = 6 bits) */
+    unsigned gameSeconds  : 11; /**< Tempo de jogo em segundos (11 bits = 34min07s de jogo) */
+
+    // informações de controle gerais
+    unsigned ballRotation : 9;  /**< Rotação da bola (de 0 a 360 = 9 bits) */
+    unsigned paused       : 1;  /**< Bit que indica se o jogo está pausado (1) ou não (0). */
+    unsigned isGoal       : 1;  /**< Bit que indica se ocorreu um gol (para exibir a mensagem no cliente). */
+} GameControl;
+
+/**
+ * @def BALL_VELOCITY_LIMIT
+ * Maior deslocamento da bola por quadro, em pixels, que cabe em
+ * BallMotion::velocityX e BallMotion::velocityY (12 bits com sinal, em 1/64 de
+ * pixel). A velocidade do jogo vai só até 20 pixels.
+ */
+#define BALL_VELOCITY_LIMIT 32
+
+/**
+ * Complemento de GameControl com a posição da bola em subpixel e a velocidade.
+ *
+ * Enviado logo após GameControl quando a opção OPT_SUBPIXEL_BALL está ativa.
+ * Com essas informações a posição da bola não é arredondada para pixels
+ * inteiros, e o cliente pode continuar movendo a bola (extrapolação) quando um
+ * quadro do servidor atrasa ou é perdido.
+ *
+ * Com a opção ativa, GameControl::ballX e GameControl::ballY são a parte
+ * inteira (arredondada para baixo) da posição.
+ *
+ * @note Essa estrutura ocupa 32 bits ou 4 bytes.
+ */
+typedef struct {
+    unsigned ballFracX : 4;  /**< Fração da posição X da bola, em 1/16 de pixel */
+    unsigned ballFracY : 4;  /**< Fração da posição Y da bola, em 1/16 de pixel */
+    signed   velocityX : 12; /**< Deslocamento X da bola por quadro, em 1/64 de pixel (de -BALL_VELOCITY_LIMIT até BALL_VELOCITY_LIMIT pixels) */
+    signed   velocityY : 12; /**< Deslocamento Y da bola por quadro, em 1/64 de pixel (de -BALL_VELOCITY_LIMIT até BALL_VELOCITY_LIMIT pixels) */
+} BallMotion;
+
+/**
+ * Estrutura com informações do cliente.
+ *
+ * Durante o jogo, o lado cliente precisa enviar algumas informações para o
+ * servidor (movimento do jogador, etc.). Essa estrutura define o formato dos
+ * dados utilizados para essa comunicação.
+ *
+ * Da mesma forma que GameControl, essa estrutura é um campo de bits, e ocupa
+ * 15 bits ou 2 bytes.
+ */
+typedef struct {
+    unsigned playerPos : 9; /**< Posição Y do jogador da esquerda (de 0 até 370 = 9 bits) */
+    unsigned velocity  : 6; /**< Velocidade da bola configurada no cliente (de 1 a 25 = 6 bits) */
+} ClientInfo;
+
+/**
+ * Estrutura utilizada para controlar o início do jogo.
+ *
+ * Os dois jogadores ficam enviando e recebendo essa estrutura até que ambos
+ * informem que estão pronto para o jogo (campo ready definido como true).
+ *
+ * Na prática, essa struct impede que um jogador possa jogar sozinho contra um
+ * adversário paralisado em campo (sem receber as informações enviadas pelo
+ * outro computador - servidor ou cliente).
+ *
+ * É enviado também o gameMode, necessário saber se a configuração do outro
+ * jogador é compatível, para não iniciar o jogo com dois servidores ou dois
+ * clientes.
+ *
+ * O campo options contém as opções do protocolo (ProtocolOption) habilitadas
+ * pelo jogador.
+ *
+ * @note Essa estrutura ocupa 99 bits, ou 13 bytes.
+ */
+typedef struct {
+    bool ready;             /**< Flag que indica se o jogador está pronto para começar o jogo */
+    bool gameMode;          /**< Flag que indica o modo de jogo configurado. (false = 0 = SERVER, true = 1 = CLIENT) */
+    char name[10];          /**< Nome do jogador (10 caracteres) */
+    unsigned char options;  /**< Opções do protocolo habilitadas (ver ProtocolOption) */
+} Greetings;
+
+quint8 crc8( const char * data, int len );
+
+#endif // PROTOCOL_H
@@ -0,0 +1,194 @@
+#include <QTime>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "ptytransport.h"
+
+/**
+ * Cria o meio. O pseudo-terminal só é aberto em PtyTransport::open.
+ *
+ * @param device O dispositivo a ser aberto (normalmente o lado escravo criado
+ *               por outro PtyTransport), ou vazio para criar um novo par.
+ */
+PtyTransport::PtyTransport( const QString & device )
+{
+    this->device = device;
+    this->fd     = -1;
+}
+
+/**
+ * Destrutor. Fecha o pseudo-terminal.
+ */
+PtyTransport::~PtyTransport()
+{
+    this->close();
+}
+
+/**
+ * Abre o pseudo-terminal em modo raw e sem bloqueio.
+ *
+ * @return true se o pseudo-terminal foi aberto.
+ */
+bool PtyTransport::open()
+{
+    this->close();
+
+    if ( this->device.isEmpty() ) {
+        this->fd = posix_openpt( O_RDWR | O_NOCTTY );
+        if ( this->fd < 0 || grantpt( this->fd ) < 0 || unlockpt( this->fd ) < 0 ) {
+            this->close();
+            return false;
+        }
+        this->slaveName = ptsname( this->fd );
+    }
+    else {
+        this->fd = ::open( this->device.toLocal8Bit().constData(), O_RDWR | O_NOCTTY );
+        if ( this->fd < 0 ) {
+            return false;
+        }
+    }
+
+    // sem eco e sem processamento de caracteres especiais
+    struct termios tio;
+    if ( tcgetattr( this->fd, &tio ) == 0 ) {
+        cfmakeraw( &tio );
+        tcsetattr( this->fd, TCSANOW, &tio );
+    }
+
+    fcntl( this->fd, F_SETFL, fcntl( this->fd, F_GETFL ) | O_NONBLOCK );
+    return true;
+}
+
+void PtyTransport::close()
+{
+    this->clearPeeked();
+    if ( this->fd >= 0 ) {
+        ::close( this->fd );
+        this->fd = -1;
+    }
+}
+
+bool PtyTransport::isOpen() const
+{
+    return ( this->fd >= 0 );
+}
+
+/**
+ * Reabre o dispositivo. O lado mestre de um par criado por este meio não é
+ * reaberto, já que isso criaria um par novo, com outro nome.
+ */
+bool PtyTransport::reconnect()
+{
+    if ( this->device.isEmpty() ) {
+        return this->isOpen();
+    }
+    return Transport::reconnect();
+}
+
+/**
+ * Escreve sem bloquear.
+ *
+ * @return O número de bytes escritos (0 se o buffer do pseudo-terminal está
+ *         cheio), ou -1 em caso de erro.
+ */
+qint64 PtyTransport::write( const QByteArray & data )
+{
+    ssize_t n = ::write( this->fd, data.constData(), data.size() );
+    if ( n < 0 && ( errno == EAGAIN || errno == EINTR ) ) {
+        return 0;
+    }
+    return n;
+}
+
+/**
+ * Escreve os buffers com uma única chamada a writev(), sem copiá-los.
+ */
+qint64 PtyTransport::writev( const QList<QByteArray> & buffers )
+{
+    struct iovec iov[64];
+    int count = qMin( buffers.size(), 64 );
+
+    for ( int i = 0; i < count; i++ ) {
+        iov[i].iov_base = (void*) buffers.at( i ).constData();
+        iov[i].iov_len  = buffers.at( i ).size();
+    }
+
+    ssize_t n = ::writev( this->fd, iov, count );
+    if ( n < 0 && ( errno == EAGAIN || errno == EINTR ) ) {
+        return 0;
+    }
+    return n;
+}
+
+/**
+ * Lê até @a maxSize bytes, aguardando no máximo o tempo limite configurado.
+ */
+QByteArray PtyTransport::read( qint64 maxSize )
+{
+    QByteArray data( maxSize, 0 );
+    int received = 0;
+
+    QTime elapsed;
+    elapsed.start();
+
+    while ( received < maxSize ) {
+        ssize_t n = ::read( this->fd, data.data() + received, maxSize - received );
+        if ( n > 0 ) {
+            received += n;
+            continue;
+        }
+        // EIO: o lado escravo ainda não foi aberto (ou já foi fechado)
+        if ( n < 0 && errno != EAGAIN && errno != EINTR && errno != EIO ) {
+            break;
+        }
+
+        int remaining = this->timeout - elapsed.elapsed();
+        if ( remaining <= 0 ) {
+            break;
+        }
+
+        struct pollfd pfd;
+        pfd.fd      = this->fd;
+        pfd.events  = POLLIN;
+        pfd.revents = 0;
+        if ( poll( &pfd, 1, remaining ) <= 0 || !( pfd.revents & POLLIN ) ) {
+            break;
+        }
+    }
+
+    data.resize( received );
+    return data;
+}
+
+QByteArray PtyTransport::readAll()
+{
+    QByteArray data( this->bytesAvailable(), 0 );
+    ssize_t n = data.isEmpty() ? 0 : ::read( this->fd, data.data(), data.size() );
+    data.resize( qMax( (ssize_t) 0, n ) );
+    return data;
+}
+
+qint64 PtyTransport::bytesAvailable()
+{
+    int bytes = 0;
+    if ( this->fd < 0 || ioctl( this->fd, FIONREAD, &bytes ) < 0 ) {
+        return 0;
+    }
+    return bytes;
+}
+
+/**
+ * Nome do lado escravo do par criado por este meio, que deve ser utilizado
+ * pelo outro jogador.
+ */
+QString PtyTransport::getSlaveName() const
+{
+    return this->slaveName;
+}
@@ -0,0 +1,41 @@
+#ifndef PTYTRANSPORT_H
+#define PTYTRANSPORT_H
+
+#include "transport.h"
+
+/**
+ * @class PtyTransport ptytransport.h "ptytransport.h"
+ * Comunicação por um par de pseudo-terminais (somente Unix).
+ *
+ * Sem um nome de dispositivo, o meio cria um novo par e utiliza o lado mestre;
+ * o nome do lado escravo (PtyTransport::getSlaveName) deve ser informado ao
+ * outro jogador como porta serial (ou como dispositivo de outro PtyTransport).
+ * O pseudo-terminal se comporta como uma porta serial, mas sem limite de
+ * velocidade.
+ */
+class PtyTransport : public Transport
+{
+public:
+    explicit PtyTransport( const QString & device = QString() );
+    ~PtyTransport();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+    bool reconnect();
+
+    qint64     write( const QByteArray & data );
+    qint64     writev( const QList<QByteArray> & buffers );
+    QByteArray read( qint64 maxSize );
+    QByteArray readAll();
+    qint64     bytesAvailable();
+
+    QString getSlaveName() const;
+
+private:
+    QString device;
+    QString slaveName;
+    int     fd;
+};
+
+#endif // PTYTRANSPORT_H
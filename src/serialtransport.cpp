@@ -0,0 +1,180 @@
+#include "serialtransport.h"
+#include "qextserialenumerator.h"
+#include "qextserialport.h"
+
+/**
+ * Cria o meio para uma porta serial. A porta só é aberta em SerialTransport::open.
+ *
+ * @param portName O nome da porta (COM1, /dev/ttyS0, etc.).
+ * @param baudRate A taxa de transmissão, em bauds.
+ */
+SerialTransport::SerialTransport( const QString & portName, int baudRate )
+{
+    this->portName  = portName;
+    this->baudRate  = baudRate;
+    this->port      = NULL;
+    this->vendorId  = 0;
+    this->productId = 0;
+    this->splitHeld = false;
+}
+
+/**
+ * Destrutor. Fecha a porta serial.
+ */
+SerialTransport::~SerialTransport()
+{
+    this->close();
+}
+
+/**
+ * Abre a porta serial com as configurações padrão do jogo.
+ *
+ * Na primeira abertura guarda a identificação do adaptador. Nas seguintes, se
+ * a porta não existir mais, tenta as outras portas com a mesma identificação.
+ *
+ * @return true se a porta foi aberta.
+ */
+bool SerialTransport::open()
+{
+    bool known = ( 0 != this->vendorId || 0 != this->productId );
+    if ( this->openPort( this->portName ) ) {
+        if ( known ) {
+            return true;
+        }
+    }
+    else if ( !known ) {
+        return false;
+    }
+
+    QList<QextPortInfo> ports = QextSerialEnumerator::getPorts();
+    for ( int i = 0; i < ports.size(); i++ ) {
+        const QextPortInfo & info = ports.at( i );
+        bool same = ( info.physName == this->portName || info.portName == this->portName );
+
+        if ( !known && same ) {
+            this->vendorId  = info.vendorID;
+            this->productId = info.productID;
+            return true;
+        }
+        if ( known && !same && info.vendorID == this->vendorId && info.productID == this->productId
+             && this->openPort( info.physName ) ) {
+            this->portName = info.physName;
+            return true;
+        }
+    }
+
+    return !known;
+}
+
+/**
+ * Abre uma porta serial com as configurações padrão do jogo.
+ */
+bool SerialTransport::openPort( const QString & name )
+{
+    this->close();
+
+    this->port = new QextSerialPort( name, QextSerialPort::Polling );
+    this->port->setBaudRate( (BaudRateType) this->baudRate );
+    this->port->setDataBits( DATA_8 );
+    this->port->setParity( PAR_NONE );
+    this->port->setStopBits( STOP_1 );
+    this->port->setFlowControl( FLOW_OFF );
+    this->port->setTimeout( this->timeout );
+    // entrega cada byte assim que chega, sem o acúmulo de até 16ms dos adaptadores USB
+    this->port->setLowLatency( true );
+
+    return this->port->open( QIODevice::ReadWrite | QIODevice::Unbuffered | QIODevice::Truncate );
+}
+
+void SerialTransport::close()
+{
+    this->splitHeld = false;
+    this->clearPeeked();
+    if ( NULL != this->port ) {
+        this->port->close();
+        delete this->port;
+        this->port = NULL;
+    }
+}
+
+bool SerialTransport::isOpen() const
+{
+    return ( NULL != this->port && this->port->isOpen() );
+}
+
+qint64 SerialTransport::write( const QByteArray & data )
+{
+    return this->port->write( data );
+}
+
+/**
+ * Escreve os buffers com uma única chamada ao sistema, sem juntá-los antes
+ * (QextSerialPort::writev).
+ */
+qint64 SerialTransport::writev( const QList<QByteArray> & buffers )
+{
+    return this->port->writev( buffers );
+}
+
+/**
+ * Lê até @a maxSize bytes. A espera é feita pelo próprio driver da porta
+ * serial (VTIME), com o tempo limite configurado na abertura.
+ */
+QByteArray SerialTransport::read( qint64 maxSize )
+{
+    return this->port->read( maxSize );
+}
+
+QByteArray SerialTransport::readAll()
+{
+    return this->port->readAll();
+}
+
+qint64 SerialTransport::bytesAvailable()
+{
+    return this->port->bytesAvailable();
+}
+
+/**
+ * Retorna a mensagem diretamente do buffer de leitura da porta, sem cópia
+ * (QextSerialPort::readableSpan). Só quando a mensagem está dividida entre o
+ * fim e o início do buffer circular ela é copiada, para um buffer reutilizado.
+ */
+const char * SerialTransport::peek( int size )
+{
+    if ( this->splitHeld ) {
+        return this->split.constData();
+    }
+
+    const char * data;
+    if ( this->port->readableSpan( &data ) >= size ) {
+        return data;
+    }
+    if ( this->port->bytesAvailable() < size ) {
+        return NULL;
+    }
+
+    this->split.resize( size );
+    this->port->read( this->split.data(), size );
+    this->splitHeld = true;
+    return this->split.constData();
+}
+
+void SerialTransport::consume( int size )
+{
+    if ( this->splitHeld ) {
+        // já retirada da porta por SerialTransport::peek
+        this->splitHeld = false;
+        return;
+    }
+    this->port->consume( size );
+}
+
+/**
+ * Bytes transmitidos por segundo: 10 bits por byte (início, 8 bits de dados
+ * e parada), com a taxa efetivamente aplicada pelo driver.
+ */
+int SerialTransport::getByteRate() const
+{
+    return ( NULL != this->port ) ? this->port->actualBaudRate() / 10 : 0;
+}
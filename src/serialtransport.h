@@ -0,0 +1,59 @@
+#ifndef SERIALTRANSPORT_H
+#define SERIALTRANSPORT_H
+
+#include "transport.h"
+
+class QextSerialPort;
+
+/**
+ * @class SerialTransport serialtransport.h "serialtransport.h"
+ * Comunicação pela porta serial, utilizando a QextSerialPort.
+ *
+ * @note A porta é aberta com as configurações padrão do jogo:
+ *  - Baud rate         = 57.600 bauds (ou a taxa passada ao construtor; no
+ *                        Linux, qualquer taxa aceita pelo adaptador)
+ *  - Bits de dados     = 8
+ *  - Paridade          = nenhuma
+ *  - Bits de parada    = 1
+ *  - Controle de fluxo = nenhum
+ *  - Buffer            = nenhum
+ *  - Baixa latência    = sim, se o driver aceitar
+ *
+ * Se a porta não puder ser aberta novamente (um adaptador USB desconectado e
+ * conectado outra vez pode voltar com outro nome, como /dev/ttyUSB1), procura
+ * entre as portas disponíveis uma do mesmo fabricante e modelo da original.
+ */
+class SerialTransport : public Transport
+{
+public:
+    explicit SerialTransport( const QString & portName, int baudRate = 57600 );
+    ~SerialTransport();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    qint64     write( const QByteArray & data );
+    qint64     writev( const QList<QByteArray> & buffers );
+    QByteArray read( qint64 maxSize );
+    QByteArray readAll();
+    qint64     bytesAvailable();
+
+    const char * peek( int size );
+    void         consume( int size );
+
+    int getByteRate() const;
+
+private:
+    QString          portName;
+    int              baudRate;
+    QextSerialPort * port;
+    int              vendorId;  // identificação do adaptador USB (0 = desconhecida)
+    int              productId;
+    QByteArray       split;     // mensagem dividida entre o fim e o início do buffer da porta
+    bool             splitHeld; // Transport::peek retornou split
+
+    bool openPort( const QString & name );
+};
+
+#endif // SERIALTRANSPORT_H
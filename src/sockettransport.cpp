@@ -0,0 +1,236 @@
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTime>
+#include <QUdpSocket>
+
+#include "sockettransport.h"
+
+/**
+ * Cria o meio UDP. O socket só é criado em UdpTransport::open.
+ *
+ * @param localPort  Porta em que os datagramas são recebidos.
+ * @param remotePort Porta do outro jogador.
+ */
+UdpTransport::UdpTransport( quint16 localPort, quint16 remotePort )
+{
+    this->localPort  = localPort;
+    this->remotePort = remotePort;
+    this->socket     = NULL;
+}
+
+/**
+ * Destrutor. Fecha o socket.
+ */
+UdpTransport::~UdpTransport()
+{
+    this->close();
+}
+
+bool UdpTransport::open()
+{
+    this->close();
+
+    this->socket = new QUdpSocket();
+    return this->socket->bind( QHostAddress::LocalHost, this->localPort );
+}
+
+void UdpTransport::close()
+{
+    delete this->socket;
+    this->socket = NULL;
+    this->buffer.clear();
+    this->clearPeeked();
+}
+
+bool UdpTransport::isOpen() const
+{
+    return ( NULL != this->socket && QAbstractSocket::BoundState == this->socket->state() );
+}
+
+qint64 UdpTransport::write( const QByteArray & data )
+{
+    return this->socket->writeDatagram( data, QHostAddress::LocalHost, this->remotePort );
+}
+
+/**
+ * Lê até @a maxSize bytes, aguardando no máximo o tempo limite configurado.
+ */
+QByteArray UdpTransport::read( qint64 maxSize )
+{
+    QTime elapsed;
+    elapsed.start();
+
+    this->receiveDatagrams();
+    while ( this->buffer.size() < maxSize ) {
+        int remaining = this->timeout - elapsed.elapsed();
+        if ( remaining <= 0 || !this->socket->waitForReadyRead( remaining ) ) {
+            break;
+        }
+        this->receiveDatagrams();
+    }
+
+    return this->buffer.read( maxSize );
+}
+
+QByteArray UdpTransport::readAll()
+{
+    this->receiveDatagrams();
+    return this->buffer.read( this->buffer.size() );
+}
+
+qint64 UdpTransport::bytesAvailable()
+{
+    this->receiveDatagrams();
+    return this->buffer.size();
+}
+
+/**
+ * Move os datagramas pendentes do socket para o buffer de leitura, lendo cada
+ * um diretamente para o fim do buffer.
+ */
+void UdpTransport::receiveDatagrams()
+{
+    while ( this->socket->hasPendingDatagrams() ) {
+        int size = (int) qMax( (qint64) 0, this->socket->pendingDatagramSize() );
+        qint64 n = this->socket->readDatagram( this->buffer.reserve( size ), size );
+        if ( n > 0 ) {
+            this->buffer.commit( (int) n );
+        }
+    }
+}
+
+/**
+ * Cria o meio TCP. A conexão só é iniciada em TcpTransport::open.
+ *
+ * @param port   Porta TCP em localhost.
+ * @param listen true para aguardar a conexão, false para conectar.
+ */
+TcpTransport::TcpTransport( quint16 port, bool listen )
+{
+    this->port   = port;
+    this->listen = listen;
+    this->server = NULL;
+    this->socket = NULL;
+}
+
+/**
+ * Destrutor. Fecha a conexão.
+ */
+TcpTransport::~TcpTransport()
+{
+    this->close();
+}
+
+/**
+ * Começa a aguardar a conexão, ou conecta no outro jogador.
+ *
+ * @return false se não foi possível utilizar a porta.
+ */
+bool TcpTransport::open()
+{
+    this->close();
+
+    if ( this->listen ) {
+        this->server = new QTcpServer();
+        return this->server->listen( QHostAddress::LocalHost, this->port );
+    }
+
+    this->connection();
+    return true;
+}
+
+void TcpTransport::close()
+{
+    delete this->socket;
+    delete this->server;
+    this->socket = NULL;
+    this->server = NULL;
+    this->clearPeeked();
+}
+
+bool TcpTransport::isOpen() const
+{
+    return ( NULL != this->server || NULL != this->socket );
+}
+
+qint64 TcpTransport::write( const QByteArray & data )
+{
+    if ( !this->connection() ) {
+        return 0;
+    }
+
+    qint64 written = this->socket->write( data );
+    this->socket->flush();
+    return written;
+}
+
+/**
+ * Lê até @a maxSize bytes, aguardando no máximo o tempo limite configurado.
+ */
+QByteArray TcpTransport::read( qint64 maxSize )
+{
+    if ( !this->connection() ) {
+        return QByteArray();
+    }
+
+    QTime elapsed;
+    elapsed.start();
+
+    while ( this->socket->bytesAvailable() < maxSize ) {
+        int remaining = this->timeout - elapsed.elapsed();
+        if ( remaining <= 0 || !this->socket->waitForReadyRead( remaining ) ) {
+            break;
+        }
+    }
+
+    return this->socket->read( maxSize );
+}
+
+QByteArray TcpTransport::readAll()
+{
+    return this->connection() ? this->socket->readAll() : QByteArray();
+}
+
+qint64 TcpTransport::bytesAvailable()
+{
+    return this->connection() ? this->socket->bytesAvailable() : 0;
+}
+
+/**
+ * Verifica a conexão com o outro jogador.
+ *
+ * Aceita a conexão pendente (lado que aguarda) ou tenta conectar novamente se
+ * a conexão foi perdida (lado que conecta). Nenhum dos dois bloqueia.
+ *
+ * @return true se a conexão está estabelecida.
+ */
+bool TcpTransport::connection()
+{
+    if ( NULL != this->socket && QAbstractSocket::UnconnectedState == this->socket->state() ) {
+        delete this->socket;
+        this->socket = NULL;
+    }
+
+    if ( NULL == this->socket ) {
+        if ( NULL != this->server ) {
+            if ( !this->server->waitForNewConnection( 0 ) && !this->server->hasPendingConnections() ) {
+                return false;
+            }
+            this->socket = this->server->nextPendingConnection();
+            this->socket->setParent( NULL );
+            this->socket->setSocketOption( QAbstractSocket::LowDelayOption, 1 );
+        }
+        else {
+            this->socket = new QTcpSocket();
+            this->socket->connectToHost( QHostAddress::LocalHost, this->port );
+        }
+    }
+
+    // conexão em andamento: verifica sem aguardar
+    if ( QAbstractSocket::ConnectingState == this->socket->state() && this->socket->waitForConnected( 0 ) ) {
+        this->socket->setSocketOption( QAbstractSocket::LowDelayOption, 1 );
+    }
+
+    return ( QAbstractSocket::ConnectedState == this->socket->state() );
+}
@@ -0,0 +1,76 @@
+#ifndef SOCKETTRANSPORT_H
+#define SOCKETTRANSPORT_H
+
+#include "blockbuffer.h"
+#include "transport.h"
+
+class QAbstractSocket;
+class QTcpServer;
+class QTcpSocket;
+class QUdpSocket;
+
+/**
+ * @class UdpTransport sockettransport.h "sockettransport.h"
+ * Comunicação por datagramas UDP em localhost.
+ *
+ * Cada jogador recebe em uma porta e envia para a porta do outro (por exemplo
+ * <tt>udp:5000:5001</tt> e <tt>udp:5001:5000</tt>). Os datagramas recebidos são
+ * juntados em um único fluxo de bytes, como na porta serial.
+ */
+class UdpTransport : public Transport
+{
+public:
+    UdpTransport( quint16 localPort, quint16 remotePort );
+    ~UdpTransport();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    qint64     write( const QByteArray & data );
+    QByteArray read( qint64 maxSize );
+    QByteArray readAll();
+    qint64     bytesAvailable();
+
+private:
+    quint16      localPort;
+    quint16      remotePort;
+    QUdpSocket * socket;
+    BlockBuffer  buffer;    // datagramas recebidos e ainda não lidos
+
+    void receiveDatagrams();
+};
+
+/**
+ * @class TcpTransport sockettransport.h "sockettransport.h"
+ * Comunicação por uma conexão TCP em localhost.
+ *
+ * Um dos jogadores aguarda a conexão (<tt>tcp-listen:PORTA</tt>) e o outro
+ * conecta (<tt>tcp:PORTA</tt>). Enquanto a conexão não é estabelecida, os bytes
+ * escritos são descartados, como em uma porta serial sem o cabo conectado.
+ */
+class TcpTransport : public Transport
+{
+public:
+    TcpTransport( quint16 port, bool listen );
+    ~TcpTransport();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    qint64     write( const QByteArray & data );
+    QByteArray read( qint64 maxSize );
+    QByteArray readAll();
+    qint64     bytesAvailable();
+
+private:
+    quint16      port;
+    bool         listen;
+    QTcpServer * server;
+    QTcpSocket * socket;
+
+    bool connection();
+};
+
+#endif // SOCKETTRANSPORT_H
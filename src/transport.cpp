@@ -0,0 +1,180 @@
+#include <QStringList>
+
+#include "transport.h"
+#include "bondedtransport.h"
+#include "localtransport.h"
+#include "serialtransport.h"
+#include "sockettransport.h"
+#ifdef Q_OS_UNIX
+# include "ptytransport.h"
+#endif
+
+/**
+ * Inicializa o meio com o tempo limite padrão de leitura (200ms).
+ */
+Transport::Transport()
+{
+    this->timeout = 200;
+}
+
+/**
+ * Destrutor.
+ */
+Transport::~Transport()
+{
+}
+
+/**
+ * Cria o meio de comunicação correspondente a um nome.
+ *
+ * O meio é apenas criado; para utilizá-lo é preciso chamar Transport::open.
+ *
+ * @param name O nome do meio (ver a descrição da classe) ou o nome da porta
+ *             serial.
+ * @return O novo objeto, que deve ser liberado por quem chamou o método.
+ */
+Transport * Transport::create( const QString & name )
+{
+    if ( name.startsWith( "bond:" ) ) {
+        QList<Transport *> links;
+        QStringList names = name.mid( 5 ).split( ',' );
+        for ( int i = 0; i < names.size(); i++ ) {
+            links.append( Transport::create( names.at( i ) ) );
+        }
+        return new BondedTransport( links );
+    }
+
+    QStringList parts = name.split( ':' );
+
+#ifdef Q_OS_UNIX
+    if ( "pty" == name ) {
+        return new PtyTransport();
+    }
+#endif
+    if ( "udp" == parts.first() && 3 == parts.size() ) {
+        return new UdpTransport( parts.at( 1 ).toUShort(), parts.at( 2 ).toUShort() );
+    }
+    if ( "tcp" == parts.first() && 2 == parts.size() ) {
+        return new TcpTransport( parts.at( 1 ).toUShort(), false );
+    }
+    if ( "tcp-listen" == parts.first() && 2 == parts.size() ) {
+        return new TcpTransport( parts.at( 1 ).toUShort(), true );
+    }
+    if ( "local" == parts.first() && 2 == parts.size() ) {
+        return new LocalTransport( parts.at( 1 ) );
+    }
+
+    int at = name.lastIndexOf( '@' );
+    if ( at > 0 && name.mid( at + 1 ).toInt() > 0 ) {
+        return new SerialTransport( name.left( at ), name.mid( at + 1 ).toInt() );
+    }
+    return new SerialTransport( name );
+}
+
+/**
+ * Tenta restabelecer a comunicação depois que o outro lado parou de responder.
+ *
+ * A implementação padrão fecha e abre o meio novamente.
+ *
+ * @return true se o meio está aberto.
+ */
+bool Transport::reconnect()
+{
+    this->clearPeeked();
+    this->close();
+    return this->open();
+}
+
+/**
+ * Escreve vários buffers com uma única operação de escrita.
+ *
+ * A implementação padrão junta os buffers e chama Transport::write uma vez. Os
+ * meios que têm acesso direto ao descritor de arquivo usam writev(), sem
+ * copiar os dados.
+ *
+ * @return O número de bytes escritos (pode ser menor que o total), ou -1 em
+ *         caso de erro.
+ */
+qint64 Transport::writev( const QList<QByteArray> & buffers )
+{
+    if ( 1 == buffers.size() ) {
+        return this->write( buffers.first() );
+    }
+
+    QByteArray data;
+    for ( int i = 0; i < buffers.size(); i++ ) {
+        data.append( buffers.at( i ) );
+    }
+    return data.isEmpty() ? 0 : this->write( data );
+}
+
+/**
+ * Dá acesso a uma mensagem de @a size bytes sem retirá-la do meio, para que
+ * possa ser interpretada no próprio buffer. Se ainda não há bytes suficientes,
+ * aguarda como Transport::read; os bytes que chegarem são mantidos para a
+ * próxima chamada.
+ *
+ * A implementação padrão lê para um buffer próprio; os meios que têm um
+ * buffer de leitura acessível (SerialTransport) o expõem diretamente, sem
+ * cópia nem alocação. Não deve ser misturado com Transport::read.
+ *
+ * @return Os @a size bytes, contíguos, ou NULL se não chegaram a tempo. O
+ *         ponteiro é válido até Transport::consume.
+ */
+const char * Transport::peek( int size )
+{
+    if ( this->peeked.size() < size ) {
+        this->peeked.append( this->read( size - this->peeked.size() ) );
+    }
+    return ( this->peeked.size() >= size ) ? this->peeked.constData() : NULL;
+}
+
+/**
+ * Retira do meio os @a size bytes obtidos com Transport::peek.
+ */
+void Transport::consume( int size )
+{
+    this->peeked.remove( 0, size );
+}
+
+/**
+ * Descarta os bytes lidos por Transport::peek e ainda não consumidos. Deve ser
+ * chamado pelo close() de cada meio: depois de reaberto, o meio não continua
+ * a mensagem que estava incompleta.
+ */
+void Transport::clearPeeked()
+{
+    this->peeked.clear();
+}
+
+/**
+ * Número de bytes por segundo que o meio consegue transmitir.
+ *
+ * @return A taxa de transmissão, ou 0 se o meio não tem um limite conhecido.
+ */
+int Transport::getByteRate() const
+{
+    return 0;
+}
+
+/**
+ * Define o tempo máximo que Transport::read aguarda pelos bytes solicitados.
+ *
+ * Deve ser definido antes de Transport::open. Com -1, nenhuma operação espera:
+ * a escrita aceita apenas o que couber no buffer do sistema. Depois de aberto,
+ * os meios que aguardam a leitura por conta própria (todos exceto
+ * SerialTransport, em que a espera é do driver) aplicam o novo valor já na
+ * próxima leitura.
+ */
+void Transport::setTimeout( int msecs )
+{
+    this->timeout = msecs;
+}
+
+/**
+ * Obtém o tempo máximo de espera das leituras, em milissegundos.
+ */
+int Transport::getTimeout() const
+{
+    return this->timeout;
+}
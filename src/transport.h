@@ -0,0 +1,65 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/**
+ * @class Transport transport.h "transport.h"
+ * Meio utilizado para a comunicação entre os dois jogadores.
+ *
+ * O jogo e o protocolo não dependem do meio físico: tudo o que precisam é
+ * escrever e ler bytes. Assim o mesmo código pode ser executado sobre a porta
+ * serial ou, para testes e medições em uma única máquina, sobre um
+ * pseudo-terminal, um socket local ou uma fila na memória, com taxas muito
+ * maiores que as de uma porta serial real.
+ *
+ * O meio é escolhido pelo nome passado para Transport::create:
+ *
+ *  - <tt>pty</tt>                  cria um novo par de pseudo-terminais (PtyTransport)
+ *  - <tt>udp:LOCAL:REMOTA</tt>     UDP em localhost (UdpTransport)
+ *  - <tt>tcp:PORTA</tt>            conecta em localhost:PORTA (TcpTransport)
+ *  - <tt>tcp-listen:PORTA</tt>     aguarda a conexão em localhost:PORTA (TcpTransport)
+ *  - <tt>local:NOME</tt>           fila na memória, no mesmo processo (LocalTransport)
+ *  - <tt>bond:NOME,NOME</tt>       divide o fluxo entre vários meios (BondedTransport)
+ *  - <tt>PORTA\@TAXA</tt>          porta serial com outra taxa, em bauds (SerialTransport)
+ *  - qualquer outro nome           porta serial a 57.600 bauds (SerialTransport)
+ */
+class Transport
+{
+public:
+    Transport();
+    virtual ~Transport();
+
+    static Transport * create( const QString & name );
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+    virtual bool reconnect();
+
+    virtual qint64     write( const QByteArray & data ) = 0;
+    virtual qint64     writev( const QList<QByteArray> & buffers );
+    virtual QByteArray read( qint64 maxSize ) = 0;
+    virtual QByteArray readAll() = 0;
+    virtual qint64     bytesAvailable() = 0;
+
+    virtual const char * peek( int size );
+    virtual void         consume( int size );
+
+    virtual int getByteRate() const;
+
+    void setTimeout( int msecs );
+    int  getTimeout() const;
+
+protected:
+    int timeout;    // tempo máximo de espera de Transport::read, em milissegundos
+
+    void clearPeeked();
+
+private:
+    QByteArray peeked;  // bytes lidos por Transport::peek e ainda não consumidos
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,27 @@
+TARGET = linkemu
+TEMPLATE = app
+INCLUDEPATH += ../../src
+DEPENDPATH += ../../src
+HEADERS  += transport.h \
+            serialtransport.h \
+            sockettransport.h \
+            blockbuffer.h \
+            localtransport.h \
+            bondedtransport.h \
+            protocol.h \
+            ptytransport.h \
+            linkemulator.h
+SOURCES  += transport.cpp \
+            serialtransport.cpp \
+            sockettransport.cpp \
+            blockbuffer.cpp \
+            localtransport.cpp \
+            bondedtransport.cpp \
+            protocol.cpp \
+            ptytransport.cpp \
+            linkemulator.cpp \
+            main.cpp
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
+QT = core network
+CONFIG += console release
+CONFIG -= app_bundle
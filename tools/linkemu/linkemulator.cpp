@@ -0,0 +1,194 @@
+#include "linkemulator.h"
+#include "ptytransport.h"
+
+/**
+ * Número máximo de bytes "no cabo" em cada sentido. Quando o limite é
+ * atingido o emulador para de ler do pseudo-terminal, e quem escreve passa a
+ * esperar, como acontece com o buffer de transmissão de uma porta serial.
+ */
+static const int MAX_QUEUE = 4096;
+
+/**
+ * Cria o emulador, sem atraso, erros ou limite de velocidade.
+ *
+ * @param seed Semente dos números aleatórios.
+ */
+LinkEmulator::LinkEmulator( quint64 seed )
+{
+    this->random = seed ? seed : 1;
+
+    this->settings.delay  = 0;
+    this->settings.jitter = 0;
+    this->settings.ber    = 0;
+    this->settings.drop   = 0;
+    this->settings.baud   = 0;
+
+    for ( int side = 0; side < 2; side++ ) {
+        this->pty[side] = NULL;
+        this->directions[side].lastArrival = 0;
+        this->directions[side].forwarded   = 0;
+        this->directions[side].dropped     = 0;
+        this->directions[side].bitErrors   = 0;
+    }
+}
+
+/**
+ * Destrutor. Fecha os pseudo-terminais.
+ */
+LinkEmulator::~LinkEmulator()
+{
+    delete this->pty[0];
+    delete this->pty[1];
+}
+
+/**
+ * Cria os dois pares de pseudo-terminais.
+ *
+ * @return false se algum dos pares não pôde ser criado.
+ */
+bool LinkEmulator::open()
+{
+    for ( int side = 0; side < 2; side++ ) {
+        delete this->pty[side];
+        this->pty[side] = new PtyTransport();
+        this->pty[side]->setTimeout( -1 );
+        if ( !this->pty[side]->open() ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Nome do pseudo-terminal que deve ser aberto por quem está no lado @a side
+ * (0 = A, 1 = B) do link.
+ */
+QString LinkEmulator::getSlaveName( int side ) const
+{
+    return ( NULL != this->pty[side] ) ? this->pty[side]->getSlaveName() : QString();
+}
+
+/**
+ * Altera os parâmetros do link. Os bytes que já estão "no cabo" mantêm o
+ * atraso com que foram enviados.
+ */
+void LinkEmulator::setSettings( const LinkSettings & settings )
+{
+    this->settings = settings;
+}
+
+LinkSettings LinkEmulator::getSettings() const
+{
+    return this->settings;
+}
+
+/**
+ * Lê os bytes recebidos e entrega os que já chegaram ao outro lado.
+ *
+ * Deve ser chamado periodicamente (a cada 1ms, por exemplo).
+ *
+ * @param now O instante atual, em microssegundos.
+ */
+void LinkEmulator::process( qint64 now )
+{
+    for ( int side = 0; side < 2; side++ ) {
+        this->receive( side, now );
+        this->deliver( side, now );
+    }
+}
+
+/**
+ * Lê os bytes escritos em um lado e calcula quando cada um chega no outro,
+ * aplicando as perdas e os erros de bit.
+ */
+void LinkEmulator::receive( int side, qint64 now )
+{
+    Direction & dir = this->directions[side];
+
+    int space = MAX_QUEUE - dir.queue.size();
+    if ( space <= 0 ) {
+        return;
+    }
+
+    QByteArray data = this->pty[side]->read( space );
+    qint64 byteTime = ( this->settings.baud > 0 ) ? 10000000LL / this->settings.baud : 0;
+
+    for ( int i = 0; i < data.size(); i++ ) {
+        if ( this->settings.drop > 0 && this->uniform() < this->settings.drop ) {
+            dir.dropped++;
+            continue;
+        }
+
+        char byte = data.at( i );
+        if ( this->settings.ber > 0 ) {
+            for ( int bit = 0; bit < 8; bit++ ) {
+                if ( this->uniform() < this->settings.ber ) {
+                    byte ^= 1 << bit;
+                    dir.bitErrors++;
+                }
+            }
+        }
+
+        qint64 arrival = now + this->settings.delay * 1000LL;
+        if ( this->settings.jitter > 0 ) {
+            arrival += (qint64) ( ( this->uniform() * 2 - 1 ) * this->settings.jitter * 1000 );
+        }
+
+        // os bytes não mudam de ordem, e cada um ocupa o cabo por 10 bits
+        arrival = qMax( arrival, dir.lastArrival + byteTime );
+        dir.lastArrival = arrival;
+
+        dir.queue.append( qMakePair( arrival, byte ) );
+    }
+}
+
+/**
+ * Escreve no outro lado os bytes cujo instante de entrega já passou.
+ */
+void LinkEmulator::deliver( int side, qint64 now )
+{
+    Direction & dir = this->directions[side];
+
+    QByteArray data;
+    while ( data.size() < dir.queue.size() && dir.queue.at( data.size() ).first <= now ) {
+        data.append( dir.queue.at( data.size() ).second );
+    }
+    if ( data.isEmpty() ) {
+        return;
+    }
+
+    // se o outro lado não aceitar tudo, o restante fica para a próxima vez
+    qint64 written = qMax( (qint64) 0, this->pty[1 - side]->write( data ) );
+    dir.queue.erase( dir.queue.begin(), dir.queue.begin() + written );
+    dir.forwarded += written;
+}
+
+/** Número de bytes entregues do lado @a side para o outro lado. */
+quint64 LinkEmulator::getForwarded( int side ) const
+{
+    return this->directions[side].forwarded;
+}
+
+/** Número de bytes enviados pelo lado @a side que foram perdidos. */
+quint64 LinkEmulator::getDropped( int side ) const
+{
+    return this->directions[side].dropped;
+}
+
+/** Número de bits invertidos nos bytes enviados pelo lado @a side. */
+quint64 LinkEmulator::getBitErrors( int side ) const
+{
+    return this->directions[side].bitErrors;
+}
+
+/**
+ * Número aleatório entre 0 e 1 (xorshift64*). O gerador é implementado aqui
+ * para que a sequência seja a mesma em qualquer sistema.
+ */
+double LinkEmulator::uniform()
+{
+    this->random ^= this->random >> 12;
+    this->random ^= this->random << 25;
+    this->random ^= this->random >> 27;
+    return ( ( this->random * 2685821657736338717ULL ) >> 11 ) * ( 1.0 / 9007199254740992.0 );
+}
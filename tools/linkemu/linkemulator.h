@@ -0,0 +1,73 @@
+#ifndef LINKEMULATOR_H
+#define LINKEMULATOR_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+
+class PtyTransport;
+
+/**
+ * Parâmetros do link emulado.
+ */
+struct LinkSettings {
+    int    delay;    /**< Atraso fixo, em milissegundos. */
+    int    jitter;   /**< Variação máxima do atraso (+/-), em milissegundos. */
+    double ber;      /**< Probabilidade de cada bit ser invertido (bit error rate). */
+    double drop;     /**< Probabilidade de cada byte ser perdido. */
+    int    baud;     /**< Velocidade do link em bauds (10 bits por byte). 0 = sem limite. */
+};
+
+/**
+ * @class LinkEmulator linkemulator.h "linkemulator.h"
+ * Emula um cabo serial entre dois pseudo-terminais.
+ *
+ * Cria dois pares de pseudo-terminais (lados A e B) e repassa os bytes de um
+ * lado para o outro aplicando atraso, variação do atraso, erros de bit, perda
+ * de bytes e limite de velocidade. Os jogos (ou os benchmarks) abrem os lados
+ * escravos como se fossem portas seriais.
+ *
+ * Os bytes nunca mudam de ordem, como em um cabo real: a variação do atraso
+ * apenas atrasa (ou adianta) o fluxo todo. Os números aleatórios são gerados a
+ * partir de uma semente, então duas execuções com a mesma semente, o mesmo
+ * script e o mesmo tráfego produzem os mesmos erros.
+ */
+class LinkEmulator
+{
+public:
+    explicit LinkEmulator( quint64 seed );
+    ~LinkEmulator();
+
+    bool open();
+    QString getSlaveName( int side ) const;
+
+    void setSettings( const LinkSettings & settings );
+    LinkSettings getSettings() const;
+
+    void process( qint64 now );
+
+    quint64 getForwarded( int side ) const;
+    quint64 getDropped( int side ) const;
+    quint64 getBitErrors( int side ) const;
+
+private:
+    // um sentido da comunicação (bytes lidos do lado 'side' e entregues no outro)
+    struct Direction {
+        QList< QPair<qint64, char> > queue;     // instante de entrega (us) e byte
+        qint64                      lastArrival; // entrega do último byte, em us
+        quint64                     forwarded;
+        quint64                     dropped;
+        quint64                     bitErrors;
+    };
+
+    PtyTransport * pty[2];
+    Direction      directions[2];
+    LinkSettings   settings;
+    quint64        random;
+
+    void   receive( int side, qint64 now );
+    void   deliver( int side, qint64 now );
+    double uniform();
+};
+
+#endif // LINKEMULATOR_H
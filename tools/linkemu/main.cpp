@@ -0,0 +1,268 @@
+/**
+ * @file main.cpp
+ * Emulador de link serial (linkemu).
+ *
+ * Cria dois pseudo-terminais ligados por um "cabo" com atraso, variação do
+ * atraso, erros de bit, perda de bytes e limite de velocidade configuráveis.
+ * Cada jogo (ou benchmark) abre um dos lados como porta serial.
+ *
+ *      $ ./linkemu --delay 20 --jitter 5 --ber 1e-5 --baud 57600 \
+ *                  --link-a /tmp/ttyA --link-b /tmp/ttyB
+ *
+ * Opções:
+ *  - --delay MS       atraso fixo, em milissegundos
+ *  - --jitter MS      variação máxima do atraso (+/-)
+ *  - --ber P          probabilidade de cada bit ser invertido
+ *  - --drop P         probabilidade de cada byte ser perdido
+ *  - --baud N         velocidade do link (0 = sem limite)
+ *  - --seed N         semente dos números aleatórios (padrão 1)
+ *  - --script ARQ     altera os parâmetros ao longo do tempo (ver abaixo)
+ *  - --duration S     encerra após S segundos
+ *  - --stats S        exibe as estatísticas a cada S segundos
+ *  - --link-a CAMINHO cria um link simbólico para o lado A (idem --link-b)
+ *
+ * O script tem uma linha por evento, com o instante (em segundos desde o
+ * início), o parâmetro e o novo valor. Linhas vazias e começando com # são
+ * ignoradas, e o evento <tt>quit</tt> encerra o emulador:
+ *
+ *      # segundos  parâmetro  valor
+ *      0           baud       57600
+ *      10          ber        1e-4
+ *      20          drop       0.01
+ *      30          jitter     40
+ *      60          quit
+ *
+ * Com a mesma semente e o mesmo script, as execuções são reproduzíveis.
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegExp>
+#include <QStringList>
+#include <QTextStream>
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "linkemulator.h"
+
+/**
+ * Uma alteração dos parâmetros em um instante do script.
+ */
+struct ScriptEvent {
+    qint64  time;       // microssegundos desde o início
+    QString parameter;
+    QString value;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void stop( int )
+{
+    running = 0;
+}
+
+/**
+ * Altera um parâmetro do link.
+ *
+ * @return false se o parâmetro não existe.
+ */
+static bool applySetting( LinkSettings & settings, const QString & parameter, const QString & value )
+{
+    if ( "delay" == parameter ) {
+        settings.delay = value.toInt();
+    }
+    else if ( "jitter" == parameter ) {
+        settings.jitter = value.toInt();
+    }
+    else if ( "ber" == parameter ) {
+        settings.ber = value.toDouble();
+    }
+    else if ( "drop" == parameter ) {
+        settings.drop = value.toDouble();
+    }
+    else if ( "baud" == parameter ) {
+        settings.baud = value.toInt();
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Lê o script de eventos.
+ *
+ * @return false se o arquivo não existe ou tem alguma linha inválida.
+ */
+static bool loadScript( const QString & fileName, QList<ScriptEvent> & events )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly | QIODevice::Text ) ) {
+        fprintf( stderr, "linkemu: não foi possível abrir %s\n", qPrintable( fileName ) );
+        return false;
+    }
+
+    LinkSettings check = { 0, 0, 0, 0, 0 };
+    QTextStream in( &file );
+    for ( int line = 1; !in.atEnd(); line++ ) {
+        QString text = in.readLine().section( '#', 0, 0 ).trimmed();
+        if ( text.isEmpty() ) {
+            continue;
+        }
+
+        QStringList fields = text.split( QRegExp( "\\s+" ) );
+        bool ok = false;
+        ScriptEvent event;
+        event.time = (qint64) ( fields.at( 0 ).toDouble( &ok ) * 1000000 );
+        event.parameter = fields.value( 1 );
+        event.value = fields.value( 2 );
+
+        bool valid = ok && ( ( "quit" == event.parameter && 2 == fields.size() )
+                          || ( 3 == fields.size() && applySetting( check, event.parameter, event.value ) ) );
+        if ( !valid ) {
+            fprintf( stderr, "linkemu: %s:%d: evento inválido\n", qPrintable( fileName ), line );
+            return false;
+        }
+
+        // mantém os eventos ordenados pelo instante (estável para o mesmo instante)
+        int pos = events.size();
+        while ( pos > 0 && events.at( pos - 1 ).time > event.time ) {
+            pos--;
+        }
+        events.insert( pos, event );
+    }
+
+    return true;
+}
+
+static void printStats( const LinkEmulator & link, qint64 now )
+{
+    const char * names[2] = { "A->B", "B->A" };
+    for ( int side = 0; side < 2; side++ ) {
+        printf( "%8.3f %s encaminhados=%llu perdidos=%llu bits_errados=%llu\n",
+                now / 1e6, names[side],
+                (unsigned long long) link.getForwarded( side ),
+                (unsigned long long) link.getDropped( side ),
+                (unsigned long long) link.getBitErrors( side ) );
+    }
+    fflush( stdout );
+}
+
+static void usage()
+{
+    fprintf( stderr,
+             "uso: linkemu [--delay MS] [--jitter MS] [--ber P] [--drop P] [--baud N]\n"
+             "             [--seed N] [--script ARQ] [--duration S] [--stats S]\n"
+             "             [--link-a CAMINHO] [--link-b CAMINHO]\n" );
+}
+
+int main( int argc, char * argv[] )
+{
+    QCoreApplication app( argc, argv );
+    QStringList args = app.arguments();
+
+    LinkSettings settings = { 0, 0, 0, 0, 0 };
+    QList<ScriptEvent> events;
+    quint64 seed = 1;
+    double duration = 0, statsInterval = 0;
+    QString links[2];
+
+    for ( int i = 1; i < args.size(); i++ ) {
+        QString option = args.at( i );
+        if ( i + 1 >= args.size() || !option.startsWith( "--" ) ) {
+            usage();
+            return 1;
+        }
+        QString value = args.at( ++i );
+
+        if ( "--seed" == option ) {
+            seed = value.toULongLong();
+        }
+        else if ( "--script" == option ) {
+            if ( !loadScript( value, events ) ) {
+                return 1;
+            }
+        }
+        else if ( "--duration" == option ) {
+            duration = value.toDouble();
+        }
+        else if ( "--stats" == option ) {
+            statsInterval = value.toDouble();
+        }
+        else if ( "--link-a" == option ) {
+            links[0] = value;
+        }
+        else if ( "--link-b" == option ) {
+            links[1] = value;
+        }
+        else if ( !applySetting( settings, option.mid( 2 ), value ) ) {
+            usage();
+            return 1;
+        }
+    }
+
+    LinkEmulator link( seed );
+    link.setSettings( settings );
+    if ( !link.open() ) {
+        fprintf( stderr, "linkemu: não foi possível criar os pseudo-terminais\n" );
+        return 1;
+    }
+
+    for ( int side = 0; side < 2; side++ ) {
+        printf( "%c: %s\n", 'A' + side, qPrintable( link.getSlaveName( side ) ) );
+        if ( !links[side].isEmpty() ) {
+            QFile::remove( links[side] );
+            if ( !QFile::link( link.getSlaveName( side ), links[side] ) ) {
+                fprintf( stderr, "linkemu: não foi possível criar %s\n", qPrintable( links[side] ) );
+                return 1;
+            }
+        }
+    }
+    fflush( stdout );
+
+    signal( SIGINT, stop );
+    signal( SIGTERM, stop );
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 nextStats = (qint64) ( statsInterval * 1000000 );
+
+    while ( running ) {
+        qint64 now = clock.nsecsElapsed() / 1000;
+
+        while ( !events.isEmpty() && events.first().time <= now ) {
+            ScriptEvent event = events.takeFirst();
+            if ( "quit" == event.parameter ) {
+                running = 0;
+                break;
+            }
+            applySetting( settings, event.parameter, event.value );
+            link.setSettings( settings );
+        }
+        if ( duration > 0 && now >= duration * 1000000 ) {
+            running = 0;
+        }
+
+        link.process( now );
+
+        if ( statsInterval > 0 && now >= nextStats ) {
+            printStats( link, now );
+            nextStats += (qint64) ( statsInterval * 1000000 );
+        }
+
+        usleep( 1000 );
+    }
+
+    printStats( link, clock.nsecsElapsed() / 1000 );
+
+    for ( int side = 0; side < 2; side++ ) {
+        if ( !links[side].isEmpty() ) {
+            QFile::remove( links[side] );
+        }
+    }
+
+    return 0;
+}